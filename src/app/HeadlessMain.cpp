@@ -0,0 +1,199 @@
+﻿#include "engine/BackgroundSaver.h"
+#include "engine/Logger.h"
+#include "engine/Profiler.h"
+#include "engine/SaveLoad.h"
+#include "engine/Timer.h"
+#include "sim/GameWorld.h"
+#include "sim/CommandStream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace myth;
+
+// Runs the simulation without a window as fast as it will go, driven by a
+// scripted command stream. Used for soak tests and profiling.
+//
+//   MythbreakerHeadless [--ticks N] [--seed S] [--threads T] [--save FILE [--autosave TICKS]] [--chunk-cache DIR]
+//                       [--profile FILE] [--timings FILE]
+//
+// --save writes the final state to FILE (binary, or JSON if it ends in
+// .json) through a BackgroundSaver, loads it into a fresh world and checks
+// that the player ends up in the same place with the same regions. With
+// --autosave it also saves every TICKS ticks while running, in full the
+// first time and as journal deltas after, the final save being a delta
+// too. --chunk-cache keeps generated terrain in region files under DIR, so
+// a second run reads it back. --profile writes a Chrome trace of the first
+// PROFILE_TICKS ticks to FILE. --timings logs tick time percentiles and
+// writes them, with those of the step and of autosaves, as CSV to FILE.
+
+namespace {
+
+struct Options {
+    uint64_t ticks = 60 * 60 * 10; // ten minutes of game time
+    uint32_t seed = 1;
+    uint32_t threads = 0;
+    std::string saveFile;
+    uint64_t autosaveTicks = 0;
+    std::string chunkCache;
+    std::string profileFile;
+    std::string timingsFile;
+};
+
+constexpr uint32_t PROFILE_TICKS = 600;
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--ticks") == 0 && hasValue) options.ticks = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) options.threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--save") == 0 && hasValue) options.saveFile = argv[++i];
+        else if (std::strcmp(argv[i], "--autosave") == 0 && hasValue) options.autosaveTicks = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--chunk-cache") == 0 && hasValue) options.chunkCache = argv[++i];
+        else if (std::strcmp(argv[i], "--profile") == 0 && hasValue) options.profileFile = argv[++i];
+        else if (std::strcmp(argv[i], "--timings") == 0 && hasValue) options.timingsFile = argv[++i];
+        else return false;
+    }
+    return !(options.autosaveTicks && options.saveFile.empty());
+}
+
+// Same regions with the same values, in any order
+bool sameRegions(std::vector<RegionSave> a, std::vector<RegionSave> b) {
+    auto byCoord = [](const RegionSave& l, const RegionSave& r) { return l.x != r.x ? l.x < r.x : l.z < r.z; };
+    std::sort(a.begin(), a.end(), byCoord);
+    std::sort(b.begin(), b.end(), byCoord);
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const RegionSave& l, const RegionSave& r) {
+        return l.x == r.x && l.z == r.z && l.state == r.state && l.pressure == r.pressure;
+    });
+}
+
+// Same entities holding the same kinds of component
+bool sameEntities(ecs::World& a, ecs::World& b) {
+    std::vector<size_t> sizes;
+    a.eachStorage([&](const auto& components) { sizes.push_back(components.size()); });
+    size_t i = 0;
+    bool same = a.entities.count() == b.entities.count();
+    b.eachStorage([&](const auto& components) { same &= components.size() == sizes[i++]; });
+    return same;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        Logger::error("Usage: MythbreakerHeadless [--ticks N] [--seed S] [--threads T] [--save FILE [--autosave TICKS]] [--chunk-cache DIR] [--profile FILE] [--timings FILE]");
+        return 2;
+    }
+
+    constexpr float STEP = 1.0f / 60.0f;
+    JobSystem jobs(options.threads);
+    GameWorld game(&jobs);
+    game.chunks.cacheDirectory = options.chunkCache;
+    ScriptedCommandStream commands(options.seed);
+    game.populate();
+
+    BackgroundSaver saver(&jobs);
+    EventBus events;
+    bool savesOk = true;
+    int saveCounts[3] = {};
+    events.subscribe(EventType::SaveCompleted, [&](const Event& e) {
+        savesOk &= e.data.at("ok") == "1";
+        const std::string& kind = e.data.at("kind");
+        saveCounts[kind == "full" ? 0 : kind == "delta" ? 1 : 2]++;
+        MYTH_LOG_DEBUG("{} save: {} bytes in {} ms", kind, e.data.at("bytes"), e.data.at("ms"));
+    });
+    auto requestSave = [&]() {
+        if (saver.needsFullSave()) saver.save(game.save(), options.saveFile);
+        else saver.saveChanges(game.saveChanges(), options.saveFile);
+    };
+
+    MYTH_PROFILE_THREAD("Main");
+    if (!options.profileFile.empty()) Profiler::startCapture(options.profileFile, PROFILE_TICKS);
+    // A tick over its STEP of game time is a hitch: it could not keep up in real time
+    Timer timer;
+    timer.hitchMs = STEP * 1000.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < options.ticks; i++) {
+        timer.tick();
+        // The frame that ends the capture writes the trace out; leave that out of the tick times
+        const bool capturing = Profiler::capturing();
+        MYTH_PROFILE_FRAME();
+        if (capturing && !Profiler::capturing()) timer.restartFrame();
+        {
+            auto phase = timer.phase("GameWorld::step");
+            game.step(STEP, commands);
+        }
+        if (options.autosaveTicks && (i + 1) % options.autosaveTicks == 0) {
+            auto phase = timer.phase("Autosave");
+            requestSave();
+            saver.poll(events);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    timer.tick(); // closes the last tick, before a trace still capturing is written
+    if (Profiler::capturing()) Profiler::stopCapture();
+
+    glm::vec3 pos = game.playerPosition();
+    const auto& region = game.regions.getCurrentRegionData();
+    Logger::infof("{} ticks in {:.3f}s ({:.0f} ticks/s, {:.1f}x real time)", options.ticks, seconds,
+                  options.ticks / seconds, options.ticks * STEP / seconds);
+    Logger::infof("Player at ({:.1f}, {:.1f}, {:.1f}) | {}: {:.0f}% | {} regions, {} chunks",
+                  pos.x, pos.y, pos.z, regionStateName(region.state), region.realityPressure * 100.0f,
+                  game.regions.trackedRegionCount(), game.chunks.chunkCount());
+    if (!options.timingsFile.empty()) {
+        const Timer::Stats ticks = timer.runStats();
+        Logger::infof("Tick p50/p95/p99/max {:.3f}/{:.3f}/{:.3f}/{:.3f} ms, {} over {:.1f} ms", ticks.p50, ticks.p95,
+                      ticks.p99, ticks.max, ticks.hitches, timer.hitchMs);
+        if (!timer.writeCsv(options.timingsFile)) {
+            Logger::errorf("Could not write {}", options.timingsFile);
+            return 1;
+        }
+    }
+
+    if (!options.saveFile.empty()) {
+        auto snapshotStart = std::chrono::steady_clock::now();
+        requestSave();
+        Logger::infof("Save snapshot took {:.3f} ms",
+                      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - snapshotStart).count());
+        saver.wait();
+        saver.poll(events);
+        Logger::infof("Saves written: {} full, {} delta, {} compactions", saveCounts[0], saveCounts[1], saveCounts[2]);
+        if (!savesOk) {
+            Logger::errorf("Could not write {}", options.saveFile);
+            return 1;
+        }
+        GameWorld restored;
+        restored.populate();
+        SaveView view;
+        SaveData data;
+        if (view.open(options.saveFile)) {
+            restored.load(view);
+        } else if (SaveManager::load(data, options.saveFile)) {
+            restored.load(data);
+        } else {
+            Logger::errorf("Could not read {}", options.saveFile);
+            return 1;
+        }
+        // Binary saves are exact; the text format keeps six significant digits
+        const float tolerance = view.isOpen() ? 0.0f : 1e-4f * glm::max(1.0f, glm::length(pos));
+        if (glm::length(restored.playerPosition() - pos) > tolerance) {
+            Logger::error("Save round trip moved the player");
+            return 1;
+        }
+        if (restored.regions.trackedRegionCount() != game.regions.trackedRegionCount() ||
+            (view.isOpen() && !sameRegions(restored.save().regions, game.save().regions))) {
+            Logger::error("Save round trip lost regions");
+            return 1;
+        }
+        if (view.isOpen() && !sameEntities(restored.world, game.world)) {
+            Logger::error("Save round trip lost entities");
+            return 1;
+        }
+        Logger::infof("Save round trip through {} OK", options.saveFile);
+    }
+    return 0;
+}
@@ -1,80 +1,32 @@
 ﻿#include <random>
 #include "engine/Logger.h"
 #include "engine/Timer.h"
+#include "engine/Profiler.h"
 #include "engine/Input.h"
 #include "engine/RegionState.h"
 #include "engine/SaveLoad.h"
-#include "engine/ecs/World.h"
+#include "engine/BackgroundSaver.h"
+#include "engine/math/Noise.h"
 #include "engine/ecs/Systems.h"
+#include "engine/ecs/Simulation.h"
+#include "sim/GameWorld.h"
+#include "sim/CommandStream.h"
 #include "engine/vulkan/VulkanContext.h"
 #include "engine/vulkan/VulkanSwapchain.h"
 #include "engine/vulkan/VulkanPipeline.h"
 #include "engine/vulkan/VulkanBuffer.h"
 #include "engine/vulkan/VulkanDescriptors.h"
 #include "engine/vulkan/VulkanTexture.h"
+#include "engine/vulkan/TerrainBuffer.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
-#include <unordered_map>
 
 using namespace myth;
 using namespace myth::vk;
 using namespace myth::ecs;
 
-struct ChunkCoord { int x, z; bool operator==(const ChunkCoord& o) const { return x==o.x && z==o.z; } };
-struct ChunkCoordHash { size_t operator()(const ChunkCoord& c) const { return std::hash<int>()(c.x)^(std::hash<int>()(c.z)<<16); } };
-
-float chunkRandom(int x, int z, int seed = 0) {
-    int n = x + z * 57 + seed * 131; n = (n << 13) ^ n;
-    return 1.0f - ((n * (n * n * 15731 + 789221) + 1376312589) & 0x7fffffff) / 1073741824.0f;
-}
-
-struct Chunk {
-    ChunkCoord coord; std::vector<Vertex> vertices; std::vector<uint32_t> indices;
-    void generate(float chunkSize) {
-        glm::vec3 color(1.0f);
-        glm::vec3 normal(0.0f, 1.0f, 0.0f);
-        float halfSize = chunkSize / 2.0f, worldX = coord.x * chunkSize, worldZ = coord.z * chunkSize;
-        float h00 = chunkRandom(coord.x, coord.z, 10) * 0.15f;
-        float h10 = chunkRandom(coord.x + 1, coord.z, 10) * 0.15f;
-        float h01 = chunkRandom(coord.x, coord.z + 1, 10) * 0.15f;
-        float h11 = chunkRandom(coord.x + 1, coord.z + 1, 10) * 0.15f;
-        float uvScale = 2.0f;
-        vertices = {
-            {{worldX - halfSize, h00, worldZ - halfSize}, color, {0, 0}, normal},
-            {{worldX + halfSize, h10, worldZ - halfSize}, color, {uvScale, 0}, normal},
-            {{worldX + halfSize, h11, worldZ + halfSize}, color, {uvScale, uvScale}, normal},
-            {{worldX - halfSize, h01, worldZ + halfSize}, color, {0, uvScale}, normal}
-        };
-        indices = {0, 2, 1, 0, 3, 2};
-    }
-};
-
-class ChunkManager {
-public:
-    float chunkSize = 10.0f; int loadRadius = 5;
-    void update(const glm::vec3& playerPos) {
-        int px = static_cast<int>(floor(playerPos.x / chunkSize)), pz = static_cast<int>(floor(playerPos.z / chunkSize));
-        for (int x = px - loadRadius; x <= px + loadRadius; x++) {
-            for (int z = pz - loadRadius; z <= pz + loadRadius; z++) {
-                ChunkCoord coord{x, z};
-                if (m_chunks.find(coord) == m_chunks.end()) { Chunk chunk; chunk.coord = coord; chunk.generate(chunkSize); m_chunks[coord] = std::move(chunk); m_dirty = true; }
-            }
-        }
-        std::vector<ChunkCoord> toUnload;
-        for (auto& [coord, chunk] : m_chunks) { if (abs(coord.x - px) > loadRadius + 1 || abs(coord.z - pz) > loadRadius + 1) toUnload.push_back(coord); }
-        for (const auto& coord : toUnload) { m_chunks.erase(coord); m_dirty = true; }
-    }
-    void forceRebuild() { m_dirty = true; } bool isDirty() const { return m_dirty; } void clearDirty() { m_dirty = false; }
-    void buildMesh(std::vector<Vertex>& verts, std::vector<uint32_t>& inds) {
-        verts.clear(); inds.clear();
-        for (auto& [coord, chunk] : m_chunks) { uint32_t base = static_cast<uint32_t>(verts.size()); verts.insert(verts.end(), chunk.vertices.begin(), chunk.vertices.end()); for (uint32_t idx : chunk.indices) inds.push_back(base + idx); }
-    }
-private:
-    std::unordered_map<ChunkCoord, Chunk, ChunkCoordHash> m_chunks; bool m_dirty = false;
-};
-
 std::vector<Vertex> createCube(float size) {
     float s = size / 2.0f; glm::vec3 w(1.0f);
     return {
@@ -110,12 +62,13 @@ private:
     GLFWwindow* m_window = nullptr; VulkanContext m_context; VulkanSwapchain m_swapchain; DescriptorManager m_descriptors;
     VulkanPipeline m_skyPipeline;
     VulkanPipeline m_litPipeline;
-    VulkanBuffer m_terrainVB, m_terrainIB; uint32_t m_terrainIndexCount = 0; VulkanBuffer m_staticVB, m_staticIB; std::vector<MeshInfo> m_meshes;
+    TerrainBuffer m_terrain; std::vector<ChunkCoord> m_terrainBacklog; VulkanBuffer m_staticVB, m_staticIB; std::vector<MeshInfo> m_meshes;
     VulkanTexture m_groundTexture, m_stoneTexture, m_playerTexture; uint32_t m_groundMaterial = 0, m_stoneMaterial = 0, m_playerMaterial = 0;
     std::vector<VkCommandBuffer> m_commandBuffers; std::vector<VkSemaphore> m_imageAvailable, m_renderFinished; std::vector<VkFence> m_inFlight;
     uint32_t m_currentFrame = 0; bool m_framebufferResized = false;
-    World m_world; ChunkManager m_chunks; RegionStateMachine m_regions;
-    bool m_mouseCaptured = true; float m_scrollDelta = 0.0f; Timer m_timer; float m_logTimer = 0.0f, m_totalPlayTime = 0.0f;
+    JobSystem m_jobs; GameWorld m_game{&m_jobs}; LatchedCommandStream m_commands; BackgroundSaver m_saver{&m_jobs}; EventBus m_events;
+    SimulationThread m_sim; InterpolatedTransforms m_renderTransforms; static constexpr float SIM_STEP = 1.0f / 60.0f; static constexpr uint32_t TERRAIN_UPLOADS_PER_FRAME = 32, TERRAIN_RING_CHUNKS = 64;
+    bool m_mouseCaptured = true; float m_scrollDelta = 0.0f; Timer m_timer;
     RegionVisuals m_currentVisuals; RegionState m_lastLoggedState = RegionState::Stable;
     
     glm::vec3 m_sunDirection = glm::normalize(glm::vec3(0.5f, -0.8f, 0.3f));
@@ -141,19 +94,23 @@ private:
         m_skyPipeline.initSky(&m_context, &m_swapchain, &m_descriptors, "shaders/sky.vert.spv", "shaders/sky.frag.spv");
         m_litPipeline.init(&m_context, &m_swapchain, &m_descriptors, "shaders/lit.vert.spv", "shaders/lit.frag.spv");
         m_currentVisuals = RegionVisuals::forState(RegionState::Stable);
-        createTextures(); createMeshes(); createEntities(); createSyncObjects();
-        m_chunks.update(glm::vec3(0)); rebuildTerrain();
-        Logger::info("Engine initialized with lighting"); Logger::info("F5 = Save | F9 = Load");
+        createTextures(); createMeshes(); createTerrain(); createEntities(); createSyncObjects();
+        Logger::info("Engine initialized with lighting"); Logger::info("F5 = Save | F9 = Load | F11 = Profile");
+        // F5 writes a full save first, then only what changed into its journal
+        m_events.subscribe(EventType::SaveCompleted, [this](const Event& e) { bool ok = e.data.at("ok") == "1"; if (ok) Logger::infof("*** SAVED *** ({}: {} bytes, written in {} ms)", e.data.at("kind"), e.data.at("bytes"), e.data.at("ms")); else Logger::errorf("Save to {} failed!", e.data.at("file")); });
     }
 
     void createTextures() {
-        std::mt19937 rng(42);
+        // Ground and stone are tileable fBm (ridged for stone): periodic noise over exactly one texture
+        std::mt19937 rng(42); std::vector<float> field(256 * 256);
+        noise::fillGrid2({.basis = noise::Basis::Gradient, .octaves = 5, .frequency = 8.0f / 256.0f, .seed = 42, .period = 8}, 0.0f, 0.0f, 1.0f, 256, 256, field.data());
         std::vector<uint8_t> groundPixels(256 * 256 * 4);
-        for (int i = 0; i < 256 * 256; i++) { float n = (rng() % 100) / 100.0f; uint8_t b = static_cast<uint8_t>(60 + n * 40); groundPixels[i*4+0] = b; groundPixels[i*4+1] = static_cast<uint8_t>(b*0.7f); groundPixels[i*4+2] = static_cast<uint8_t>(b*0.4f); groundPixels[i*4+3] = 255; }
+        for (int i = 0; i < 256 * 256; i++) { float n = field[i] * 0.5f + 0.5f; uint8_t b = static_cast<uint8_t>(60 + n * 40); groundPixels[i*4+0] = b; groundPixels[i*4+1] = static_cast<uint8_t>(b*0.7f); groundPixels[i*4+2] = static_cast<uint8_t>(b*0.4f); groundPixels[i*4+3] = 255; }
         m_groundTexture.loadFromMemory(&m_context, groundPixels.data(), 256, 256); m_groundMaterial = m_descriptors.createMaterial(m_groundTexture);
         
+        noise::fillGrid2({.basis = noise::Basis::Gradient, .ridged = true, .octaves = 4, .frequency = 8.0f / 128.0f, .seed = 43, .period = 8}, 0.0f, 0.0f, 1.0f, 128, 128, field.data());
         std::vector<uint8_t> stonePixels(128 * 128 * 4);
-        for (int i = 0; i < 128 * 128; i++) { float n = (rng() % 100) / 100.0f; uint8_t b = static_cast<uint8_t>(100 + n * 80); stonePixels[i*4+0] = b; stonePixels[i*4+1] = static_cast<uint8_t>(b*0.95f); stonePixels[i*4+2] = static_cast<uint8_t>(b*0.9f); stonePixels[i*4+3] = 255; }
+        for (int i = 0; i < 128 * 128; i++) { float n = field[i]; uint8_t b = static_cast<uint8_t>(100 + n * 80); stonePixels[i*4+0] = b; stonePixels[i*4+1] = static_cast<uint8_t>(b*0.95f); stonePixels[i*4+2] = static_cast<uint8_t>(b*0.9f); stonePixels[i*4+3] = 255; }
         m_stoneTexture.loadFromMemory(&m_context, stonePixels.data(), 128, 128); m_stoneMaterial = m_descriptors.createMaterial(m_stoneTexture);
         
         std::vector<uint8_t> playerPixels(64 * 64 * 4);
@@ -172,22 +129,30 @@ private:
     }
 
     void createEntities() {
-        Entity player = m_world.createPlayer(glm::vec3(0, 0, 0)); auto& r = m_world.renderables.get(player);
-        r.indexStart = m_meshes[1].indexStart; r.indexCount = m_meshes[1].indexCount; r.vertexOffset = m_meshes[1].vertexOffset;
-        m_world.createCamera(player);
-        for (int x = -50; x <= 50; x += 25) { for (int z = -50; z <= 50; z += 25) { if (x == 0 && z == 0) continue;
-            float h = 1.0f + chunkRandom(x, z, 99) * 1.5f;
-            Entity e = m_world.createLandmark(glm::vec3(static_cast<float>(x), h/2, static_cast<float>(z)), glm::vec3(1.5f, h, 1.5f), chunkRandom(x, z, 100) * 360.0f);
-            auto& lr = m_world.renderables.get(e); lr.indexStart = m_meshes[0].indexStart; lr.indexCount = m_meshes[0].indexCount; lr.vertexOffset = m_meshes[0].vertexOffset;
-        } }
+        m_game.populate();
+        assignMeshes();
     }
 
-    void rebuildTerrain() {
-        std::vector<Vertex> v; std::vector<uint32_t> i; m_chunks.buildMesh(v, i); m_terrainIndexCount = static_cast<uint32_t>(i.size());
-        if (m_terrainIndexCount == 0) return; m_terrainVB.destroy(); m_terrainIB.destroy();
-        VulkanBuffer::createWithStaging(&m_context, m_terrainVB, v.data(), sizeof(Vertex)*v.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-        VulkanBuffer::createWithStaging(&m_context, m_terrainIB, i.data(), sizeof(uint32_t)*i.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-        m_chunks.clearDirty();
+    // A slot for every tile the streamer can keep resident, old and new
+    // sets together while a move settles; generation jobs write into the
+    // terrain's upload ring
+    void createTerrain() {
+        const VkDeviceSize chunkBytes = Chunk::MAX_VERTICES * sizeof(Vertex) + Chunk::MAX_INDICES * sizeof(uint32_t);
+        m_terrain.init(&m_context, static_cast<uint32_t>(m_game.chunks.tileBudget()), Chunk::MAX_VERTICES, Chunk::MAX_INDICES, TERRAIN_UPLOADS_PER_FRAME, TERRAIN_RING_CHUNKS * ((chunkBytes + 15) & ~VkDeviceSize(15)));
+        m_game.chunks.trackChanges = true; m_game.chunks.allocator = &m_terrain; m_game.chunks.cacheDirectory = "cache/terrain";
+    }
+
+    // Mirror streamed chunks into their terrain slots; whatever does not fit
+    // in this frame's uploads waits for the next
+    void syncTerrain() {
+        std::vector<ChunkCoord> loaded, unloaded; m_game.chunks.takeChanges(loaded, unloaded);
+        for (const ChunkCoord& c : unloaded) m_terrain.release(c);
+        loaded.insert(loaded.begin(), m_terrainBacklog.begin(), m_terrainBacklog.end()); m_terrainBacklog.clear();
+        for (const ChunkCoord& c : loaded) {
+            const Chunk* chunk = m_game.chunks.find(c); if (!chunk) continue;
+            if (!m_terrain.upload(c, chunk->geometry)) m_terrainBacklog.push_back(c);
+            else m_game.chunks.releaseGeometry(c); // the ring space is reused once the copy has run
+        }
     }
 
     void createSyncObjects() {
@@ -199,38 +164,73 @@ private:
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) { vkCreateSemaphore(m_context.device(), &si, nullptr, &m_imageAvailable[i]); vkCreateSemaphore(m_context.device(), &si, nullptr, &m_renderFinished[i]); vkCreateFence(m_context.device(), &fi, nullptr, &m_inFlight[i]); }
     }
 
-    void saveGame() { SaveData data; data.playTime = m_totalPlayTime; if (m_world.playerEntity != NULL_ENTITY) { const auto& t = m_world.transforms.get(m_world.playerEntity); data.playerPosition = t.position; data.playerYaw = t.rotation.y; } if (m_world.cameraEntity != NULL_ENTITY) { const auto* cam = m_world.cameraControllers.tryGet(m_world.cameraEntity); if (cam) { data.cameraYaw = cam->yaw; data.cameraPitch = cam->pitch; data.cameraDistance = cam->distance; } } auto rc = m_regions.currentRegion(); const auto& rd = m_regions.getCurrentRegionData(); data.regions.push_back({rc.x, rc.z, static_cast<int>(rd.state), rd.realityPressure}); if (SaveManager::save(data)) Logger::info("*** SAVED ***"); }
-    void loadGame() { SaveData data; if (!SaveManager::load(data)) { Logger::error("Load failed!"); return; } m_totalPlayTime = data.playTime; if (m_world.playerEntity != NULL_ENTITY) { auto& t = m_world.transforms.get(m_world.playerEntity); t.position = data.playerPosition; t.rotation.y = data.playerYaw; if (auto* c = m_world.playerControllers.tryGet(m_world.playerEntity)) c->targetYaw = data.playerYaw; if (auto* v = m_world.velocities.tryGet(m_world.playerEntity)) v->linear = glm::vec3(0); } if (m_world.cameraEntity != NULL_ENTITY) { if (auto* cam = m_world.cameraControllers.tryGet(m_world.cameraEntity)) { cam->yaw = data.cameraYaw; cam->pitch = data.cameraPitch; cam->distance = data.cameraDistance; } } for (const auto& rs : data.regions) { auto& region = m_regions.getOrCreateRegion({rs.x, rs.z}); region.state = static_cast<RegionState>(rs.state); region.realityPressure = rs.pressure; } m_currentVisuals = m_regions.getCurrentVisuals(); m_lastLoggedState = m_regions.getCurrentRegionData().state; if (m_world.playerEntity != NULL_ENTITY) { m_chunks.update(m_world.transforms.get(m_world.playerEntity).position); m_chunks.forceRebuild(); vkDeviceWaitIdle(m_context.device()); rebuildTerrain(); } Logger::info("*** LOADED ***"); }
+    // The frame only pays for copying the state out; BackgroundSaver encodes and writes it on a worker
+    static constexpr float SAVE_SNAPSHOT_BUDGET_MS = 2.0f;
+    void saveGame() { auto start = std::chrono::steady_clock::now(); SaveData snapshot; bool full; { auto lock = m_sim.lockWorld(); full = m_saver.needsFullSave(); snapshot = full ? m_game.save() : m_game.saveChanges(); } float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(); if (full) m_saver.save(std::move(snapshot)); else m_saver.saveChanges(std::move(snapshot)); if (ms > SAVE_SNAPSHOT_BUDGET_MS) Logger::warnf("Save snapshot took {:.2f} ms, over its {:.1f} ms budget", ms, SAVE_SNAPSHOT_BUDGET_MS); else MYTH_LOG_DEBUG("Save snapshot took {:.2f} ms", ms); }
+    // Index ranges depend on this client's mesh buffer, so they are filled in after a load too
+    void assignMeshes() { m_game.world.renderables.each([&](Entity, Renderable& r) { const MeshInfo& m = m_meshes[r.meshId]; r.indexStart = m.indexStart; r.indexCount = m.indexCount; r.vertexOffset = m.vertexOffset; }); }
+    void loadGame() {
+        m_saver.wait(); auto lock = m_sim.lockWorld();
+        // Binary saves load straight from the mapping; anything else, such as a quicksave from before them, through SaveManager
+        const char* file = SaveManager::saveExists() ? SaveManager::DEFAULT_SAVE : SaveManager::LEGACY_SAVE;
+        SaveView save; SaveData data;
+        if (save.open(file)) m_game.load(save); else if (SaveManager::load(data, file)) m_game.load(data); else { Logger::error("Load failed!"); return; }
+        assignMeshes(); m_currentVisuals = m_game.regions.getCurrentVisuals(); m_lastLoggedState = m_game.regions.getCurrentRegionData().state; Logger::info("*** LOADED ***");
+    }
+
+    PlayerCommand samplePlayerCommand() const {
+        auto& input = Input::instance(); PlayerCommand c;
+        c.forward = (input.isKeyDown(GLFW_KEY_W) ? 1.0f : 0.0f) - (input.isKeyDown(GLFW_KEY_S) ? 1.0f : 0.0f);
+        c.right = (input.isKeyDown(GLFW_KEY_D) ? 1.0f : 0.0f) - (input.isKeyDown(GLFW_KEY_A) ? 1.0f : 0.0f);
+        c.sprint = input.isKeyDown(GLFW_KEY_LEFT_SHIFT); c.jump = input.isKeyPressed(GLFW_KEY_SPACE);
+        return c;
+    }
 
+    // F11 captures this many frames into PROFILE_TRACE, for chrome://tracing or ui.perfetto.dev
+    static constexpr uint32_t PROFILE_FRAMES = 300; static constexpr const char* PROFILE_TRACE = "profiles/frames.json";
+    // Frame and phase time percentiles for the whole run, written on exit
+    static constexpr const char* FRAME_TIMES = "profiles/frame_times.csv";
     void mainLoop() {
+        MYTH_PROFILE_THREAD("Main");
+        m_sim.start(m_game.world, SIM_STEP, [this](float dt) { m_game.step(dt, m_commands); });
         while (!glfwWindowShouldClose(m_window)) {
-            glfwPollEvents(); m_timer.tick(); float dt = m_timer.clampedDeltaTime(); m_totalPlayTime += dt;
-            processInput(dt);
-            auto* cam = m_world.cameraControllers.tryGet(m_world.cameraEntity);
-            updatePlayerInput(m_world, dt, m_mouseCaptured, Input::instance().mouseDeltaX(), Input::instance().mouseDeltaY(), cam);
-            updateMovement(m_world, dt);
-            updateCamera(m_world, dt, m_mouseCaptured, Input::instance().mouseDeltaX(), Input::instance().mouseDeltaY(), m_scrollDelta);
-            m_scrollDelta = 0.0f; Input::instance().update();
-            if (m_world.playerEntity != NULL_ENTITY) {
-                const auto& pt = m_world.transforms.get(m_world.playerEntity); m_regions.update(pt.position, dt);
-                RegionVisuals target = m_regions.getCurrentVisuals(); float visualLerp = 1.0f - exp(-2.0f * dt);
+            MYTH_PROFILE_FRAME();
+            { MYTH_PROFILE_ZONE("Poll events"); glfwPollEvents(); } m_timer.tick(); float dt = m_timer.clampedDeltaTime();
+            processInput(dt); m_saver.poll(m_events);
+            { MYTH_PROFILE_ZONE("Interpolate transforms"); auto snapshots = m_sim.snapshots().latest(); m_renderTransforms.build(snapshots, m_sim.renderAlpha(snapshots)); }
+            const glm::vec3* playerPos = m_renderTransforms.position(m_game.world.playerEntity);
+            m_commands.submit(samplePlayerCommand());
+            {
+                MYTH_PROFILE_ZONE("Camera and visuals");
+                auto lock = m_sim.lockWorld();
+                updateCamera(m_game.world, dt, m_mouseCaptured, Input::instance().mouseDeltaX(), Input::instance().mouseDeltaY(), m_scrollDelta, playerPos, &m_game.spatial);
+                RegionVisuals target = m_game.regions.getCurrentVisuals(); float visualLerp = 1.0f - exp(-2.0f * dt);
                 m_currentVisuals.fogColor = glm::mix(m_currentVisuals.fogColor, target.fogColor, visualLerp);
                 m_currentVisuals.skyColor = glm::mix(m_currentVisuals.skyColor, target.skyColor, visualLerp);
-                m_chunks.update(pt.position); if (m_chunks.isDirty()) { vkDeviceWaitIdle(m_context.device()); rebuildTerrain(); }
             }
+            m_scrollDelta = 0.0f; Input::instance().update();
             drawFrame();
-            m_logTimer += dt; if (m_logTimer >= 3.0f) { if (m_world.playerEntity != NULL_ENTITY) { const auto& pt = m_world.transforms.get(m_world.playerEntity); const auto& rd = m_regions.getCurrentRegionData(); if (rd.state != m_lastLoggedState) { Logger::infof("*** REGION: {} -> {} ***", regionStateName(m_lastLoggedState), regionStateName(rd.state)); m_lastLoggedState = rd.state; } Logger::infof("FPS: {:.0f} | Pos: ({:.0f},{:.0f}) | {}: {:.0f}%", m_timer.fps(), pt.position.x, pt.position.z, regionStateName(rd.state), rd.realityPressure * 100.0f); } m_logTimer = 0.0f; }
+            if (logEnabled(LogLevel::Info) && MYTH_EVERY_MS(3000)) { auto lock = m_sim.lockWorld(); if (m_game.world.playerEntity != NULL_ENTITY) { const auto& pt = m_game.world.transforms.view().get(m_game.world.playerEntity); const auto& rd = m_game.regions.getCurrentRegionData(); if (rd.state != m_lastLoggedState) { Logger::infof("*** REGION: {} -> {} ***", regionStateName(m_lastLoggedState), regionStateName(rd.state)); m_lastLoggedState = rd.state; } const Timer::Stats frames = m_timer.frameStats(); Logger::infof("FPS: {:.0f} | Frame p50/p95/p99/max {:.1f}/{:.1f}/{:.1f}/{:.1f} ms, {} hitches | Pos: ({:.0f},{:.0f}) | {}: {:.0f}% | Sim tick {} ({} dropped)", m_timer.fps(), frames.p50, frames.p95, frames.p99, frames.max, frames.hitches, pt.position.x, pt.position.z, regionStateName(rd.state), rd.realityPressure * 100.0f, m_sim.tick(), m_sim.droppedSteps()); } }
         }
+        m_sim.stop(); m_game.chunks.waitForJobs();
+        if (Profiler::capturing()) Profiler::stopCapture();
+        if (m_timer.writeCsv(FRAME_TIMES)) Logger::infof("Frame times written to {}", FRAME_TIMES);
+        else Logger::errorf("Could not write {}", FRAME_TIMES);
         vkDeviceWaitIdle(m_context.device());
     }
 
-    void processInput(float dt) { auto& input = Input::instance(); if (input.isKeyPressed(GLFW_KEY_ESCAPE)) { glfwSetWindowShouldClose(m_window, true); return; } if (input.isKeyPressed(GLFW_KEY_TAB)) { m_mouseCaptured = !m_mouseCaptured; glfwSetInputMode(m_window, GLFW_CURSOR, m_mouseCaptured ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL); } if (input.isKeyPressed(GLFW_KEY_F5)) saveGame(); if (input.isKeyPressed(GLFW_KEY_F9)) loadGame(); }
+    void processInput(float dt) { auto& input = Input::instance(); if (input.isKeyPressed(GLFW_KEY_ESCAPE)) { glfwSetWindowShouldClose(m_window, true); return; } if (input.isKeyPressed(GLFW_KEY_TAB)) { m_mouseCaptured = !m_mouseCaptured; glfwSetInputMode(m_window, GLFW_CURSOR, m_mouseCaptured ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL); } if (input.isKeyPressed(GLFW_KEY_F5)) saveGame(); if (input.isKeyPressed(GLFW_KEY_F9)) loadGame(); if (input.isKeyPressed(GLFW_KEY_F11)) Profiler::startCapture(PROFILE_TRACE, PROFILE_FRAMES); }
 
     void drawFrame() {
-        vkWaitForFences(m_context.device(), 1, &m_inFlight[m_currentFrame], VK_TRUE, UINT64_MAX);
+        MYTH_PROFILE_ZONE("drawFrame");
+        { MYTH_PROFILE_ZONE("Wait for frame fence"); auto phase = m_timer.phase("Wait for frame fence"); vkWaitForFences(m_context.device(), 1, &m_inFlight[m_currentFrame], VK_TRUE, UINT64_MAX); }
         uint32_t imageIndex; if (!m_swapchain.acquireNextImage(imageIndex, m_imageAvailable[m_currentFrame])) { recreateSwapchain(); return; }
-        vkResetFences(m_context.device(), 1, &m_inFlight[m_currentFrame]);
-        updateCameraUBO(); recordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex);
+        vkResetFences(m_context.device(), 1, &m_inFlight[m_currentFrame]); m_terrain.beginFrame();
+        // Each phase times only its own work: waiting for the simulation to let go of the world is a phase of its own
+        { std::unique_lock<std::mutex> lock; { MYTH_PROFILE_ZONE("Wait for simulation"); auto phase = m_timer.phase("Wait for simulation"); lock = m_sim.lockWorld(); }
+          { MYTH_PROFILE_ZONE("Sync terrain and camera"); auto phase = m_timer.phase("Sync terrain and camera"); syncTerrain(); updateCameraUBO(); }
+          MYTH_PROFILE_ZONE("Record commands"); auto phase = m_timer.phase("Record commands"); recordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex); }
+        MYTH_PROFILE_ZONE("Submit and present"); auto phase = m_timer.phase("Submit and present");
         VkSemaphore waitSems[] = {m_imageAvailable[m_currentFrame]}; VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}; VkSemaphore signalSems[] = {m_renderFinished[m_currentFrame]};
         VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO}; si.waitSemaphoreCount = 1; si.pWaitSemaphores = waitSems; si.pWaitDstStageMask = waitStages; si.commandBufferCount = 1; si.pCommandBuffers = &m_commandBuffers[m_currentFrame]; si.signalSemaphoreCount = 1; si.pSignalSemaphores = signalSems;
         vkQueueSubmit(m_context.graphicsQueue(), 1, &si, m_inFlight[m_currentFrame]);
@@ -240,11 +240,11 @@ private:
 
     void updateCameraUBO() {
         auto ext = m_swapchain.extent(); CameraUBO ubo{};
-        ubo.view = getCameraViewMatrix(m_world);
+        ubo.view = getCameraViewMatrix(m_game.world, m_renderTransforms.position(m_game.world.playerEntity));
         ubo.proj = glm::perspective(glm::radians(60.0f), float(ext.width)/float(ext.height), 0.1f, 500.0f);
         ubo.proj[1][1] *= -1;
         ubo.viewProj = ubo.proj * ubo.view;
-        ubo.cameraPos = getCameraPosition(m_world);
+        ubo.cameraPos = getCameraPosition(m_game.world);
         ubo.time = m_timer.totalTime();
         ubo.sunDirection = m_sunDirection;
         ubo.sunIntensity = m_sunIntensity;
@@ -257,6 +257,7 @@ private:
 
     void recordCommandBuffer(VkCommandBuffer cmd, uint32_t imageIndex) {
         vkResetCommandBuffer(cmd, 0); VkCommandBufferBeginInfo bi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO}; vkBeginCommandBuffer(cmd, &bi);
+        m_terrain.recordUploads(cmd);
         auto ext = m_swapchain.extent(); std::array<VkClearValue, 2> clears{}; clears[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}}; clears[1].depthStencil = {1.0f, 0};
         VkRenderPassBeginInfo rpi{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO}; rpi.renderPass = m_swapchain.renderPass(); rpi.framebuffer = m_swapchain.framebuffer(imageIndex); rpi.renderArea = {{0,0}, ext}; rpi.clearValueCount = 2; rpi.pClearValues = clears.data();
         vkCmdBeginRenderPass(cmd, &rpi, VK_SUBPASS_CONTENTS_INLINE);
@@ -274,29 +275,28 @@ private:
         PushConstants push{};
         
         // Terrain
-        if (m_terrainIndexCount > 0) {
+        if (m_terrain.residentCount() > 0) {
             m_descriptors.bindMaterial(cmd, m_litPipeline.pipelineLayout(), m_currentFrame, m_groundMaterial);
-            VkBuffer tb[] = {m_terrainVB.buffer()}; VkDeviceSize to[] = {0}; vkCmdBindVertexBuffers(cmd, 0, 1, tb, to); vkCmdBindIndexBuffer(cmd, m_terrainIB.buffer(), 0, VK_INDEX_TYPE_UINT32);
             push.model = glm::mat4(1.0f); vkCmdPushConstants(cmd, m_litPipeline.pipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
-            vkCmdDrawIndexed(cmd, m_terrainIndexCount, 1, 0, 0, 0);
+            m_terrain.draw(cmd);
         }
         
         VkBuffer sb[] = {m_staticVB.buffer()}; VkDeviceSize so[] = {0}; vkCmdBindVertexBuffers(cmd, 0, 1, sb, so); vkCmdBindIndexBuffer(cmd, m_staticIB.buffer(), 0, VK_INDEX_TYPE_UINT32);
         
         // Landmarks
         m_descriptors.bindMaterial(cmd, m_litPipeline.pipelineLayout(), m_currentFrame, m_stoneMaterial);
-        m_world.landmarkTags.each([&](Entity e, const LandmarkTag&) { const auto* t = m_world.transforms.tryGet(e); const auto* r = m_world.renderables.tryGet(e); if (!t || !r || !r->visible) return; push.model = t->getMatrix(); vkCmdPushConstants(cmd, m_litPipeline.pipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push); vkCmdDrawIndexed(cmd, r->indexCount, 1, r->indexStart, r->vertexOffset, 0); });
+        m_game.world.landmarkTags.view().each([&](Entity e, const LandmarkTag&) { const auto* m = m_renderTransforms.tryGet(e); const auto* r = m_game.world.renderables.view().tryGet(e); if (!m || !r || !r->visible) return; push.model = m->toMat4(); vkCmdPushConstants(cmd, m_litPipeline.pipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push); vkCmdDrawIndexed(cmd, r->indexCount, 1, r->indexStart, r->vertexOffset, 0); });
         
         // Player
         m_descriptors.bindMaterial(cmd, m_litPipeline.pipelineLayout(), m_currentFrame, m_playerMaterial);
-        if (m_world.playerEntity != NULL_ENTITY) { const auto* t = m_world.transforms.tryGet(m_world.playerEntity); const auto* r = m_world.renderables.tryGet(m_world.playerEntity); if (t && r && r->visible) { push.model = t->getMatrix(); vkCmdPushConstants(cmd, m_litPipeline.pipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push); vkCmdDrawIndexed(cmd, r->indexCount, 1, r->indexStart, r->vertexOffset, 0); } }
+        if (m_game.world.playerEntity != NULL_ENTITY) { const auto* m = m_renderTransforms.tryGet(m_game.world.playerEntity); const auto* r = m_game.world.renderables.view().tryGet(m_game.world.playerEntity); if (m && r && r->visible) { push.model = m->toMat4(); vkCmdPushConstants(cmd, m_litPipeline.pipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push); vkCmdDrawIndexed(cmd, r->indexCount, 1, r->indexStart, r->vertexOffset, 0); } }
         
         vkCmdEndRenderPass(cmd); vkEndCommandBuffer(cmd);
     }
 
     void recreateSwapchain() { int w=0, h=0; glfwGetFramebufferSize(m_window, &w, &h); while (w==0||h==0) { glfwGetFramebufferSize(m_window,&w,&h); glfwWaitEvents(); } vkDeviceWaitIdle(m_context.device()); m_swapchain.recreate(); }
 
-    void cleanup() { m_groundTexture.destroy(); m_stoneTexture.destroy(); m_playerTexture.destroy(); for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) { vkDestroySemaphore(m_context.device(), m_imageAvailable[i], nullptr); vkDestroySemaphore(m_context.device(), m_renderFinished[i], nullptr); vkDestroyFence(m_context.device(), m_inFlight[i], nullptr); } m_terrainIB.destroy(); m_terrainVB.destroy(); m_staticIB.destroy(); m_staticVB.destroy(); m_litPipeline.destroy(); m_skyPipeline.destroy(); m_descriptors.destroy(); m_swapchain.destroy(); m_context.destroy(); glfwDestroyWindow(m_window); glfwTerminate(); }
+    void cleanup() { m_groundTexture.destroy(); m_stoneTexture.destroy(); m_playerTexture.destroy(); for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) { vkDestroySemaphore(m_context.device(), m_imageAvailable[i], nullptr); vkDestroySemaphore(m_context.device(), m_renderFinished[i], nullptr); vkDestroyFence(m_context.device(), m_inFlight[i], nullptr); } m_terrain.destroy(); m_staticIB.destroy(); m_staticVB.destroy(); m_litPipeline.destroy(); m_skyPipeline.destroy(); m_descriptors.destroy(); m_swapchain.destroy(); m_context.destroy(); glfwDestroyWindow(m_window); glfwTerminate(); }
 };
 
 int main() { try { Application app; app.run(); } catch (const std::exception& e) { Logger::fatal(e.what()); return 1; } return 0; }
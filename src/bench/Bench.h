@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace myth {
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+// Run `body` until at least `minSeconds` have elapsed (and at least once) and
+// return throughput in items per second, where each call processes `items`.
+template<typename Func>
+double itemsPerSecond(double items, Func&& body, double minSeconds = 0.5) {
+    body(); // warm caches and lazily sized buffers
+    size_t runs = 0;
+    auto start = Clock::now();
+    double elapsed = 0.0;
+    do {
+        body();
+        runs++;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    return items * static_cast<double>(runs) / elapsed;
+}
+
+inline void report(const char* name, double perSecond, const char* unit) {
+    const char* scale = "";
+    if (perSecond >= 1e9) { perSecond /= 1e9; scale = "G"; }
+    else if (perSecond >= 1e6) { perSecond /= 1e6; scale = "M"; }
+    else if (perSecond >= 1e3) { perSecond /= 1e3; scale = "K"; }
+    std::printf("  %-40s %10.2f %s%s/s\n", name, perSecond, scale, unit);
+}
+
+// Keep the optimizer from discarding a benchmark's results
+inline const void* volatile g_sink = nullptr;
+
+template<typename T>
+inline void doNotOptimize(const T& value) {
+    g_sink = &value;
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+// Each benchmark file defines one of these entry points
+void benchCommandBuffer();
+void benchWorldMatrices();
+void benchMotion();
+void benchGameWorld();
+void benchSpatial();
+void benchCollision();
+void benchNoise();
+void benchChunkCache();
+void benchSave();
+void benchSnapshot();
+void benchCompression();
+void benchLogger();
+void benchProfiler();
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,60 @@
+#include "Bench.h"
+#include "engine/world/ChunkCache.h"
+#include <filesystem>
+
+namespace myth {
+namespace bench {
+
+// A terrain tile coming back into view: read back from the cache's mapped
+// region files against generating it again
+void benchChunkCache() {
+    constexpr int SIDE = 16;
+    constexpr float CHUNK_SIZE = 10.0f;
+    const auto directory = std::filesystem::temp_directory_path() / "mythbreaker_bench_chunk_cache";
+    std::filesystem::remove_all(directory);
+
+    Chunk chunk;
+    report("Chunk::generate", itemsPerSecond(SIDE * SIDE, [&] {
+        for (int z = 0; z < SIDE; z++) {
+            for (int x = 0; x < SIDE; x++) {
+                chunk.coord = {x, z, 0};
+                chunk.generate(CHUNK_SIZE);
+                doNotOptimize(chunk.geometry);
+            }
+        }
+    }), "tile");
+
+    {
+        ChunkCache cache(directory, CHUNK_SIZE);
+        for (int z = 0; z < SIDE; z++) {
+            for (int x = 0; x < SIDE; x++) {
+                Chunk tile;
+                tile.coord = {x, z, 0};
+                tile.generate(CHUNK_SIZE);
+                cache.store(tile);
+            }
+        }
+
+        report("ChunkCache::read (queued in memory)", itemsPerSecond(SIDE * SIDE, [&] {
+            for (int z = 0; z < SIDE; z++) {
+                for (int x = 0; x < SIDE; x++) cache.read({x, z, 0}, chunk);
+            }
+            doNotOptimize(chunk.geometry);
+        }), "tile");
+
+        cache.flush();
+        cache.waitForWrites();
+        bool hit = true;
+        report("ChunkCache::read (mapped region)", itemsPerSecond(SIDE * SIDE, [&] {
+            for (int z = 0; z < SIDE; z++) {
+                for (int x = 0; x < SIDE; x++) hit &= cache.read({x, z, 0}, chunk);
+            }
+            doNotOptimize(chunk.geometry);
+        }), "tile");
+        if (!hit) std::printf("  cache misses: could not write %s\n", directory.string().c_str());
+    }
+    std::filesystem::remove_all(directory);
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,64 @@
+#include "Bench.h"
+#include "engine/ecs/CollisionSystem.h"
+#include "engine/ecs/MotionSystem.h"
+#include "engine/ecs/TransformSystem.h"
+#include <random>
+
+namespace myth {
+namespace bench {
+
+using namespace myth::ecs;
+
+// Static landmarks with every `dynamicEvery`th body a dynamic box drifting
+// through them, spread over a square of side `extent`. Only
+// CollisionSystem::update is timed; the motion and matrix passes that move
+// the bodies run between samples.
+static void collisionScene(const char* name, size_t count, float extent, size_t dynamicEvery) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> pos(-extent / 2, extent / 2), size(0.5f, 2.0f),
+                                          angle(0.0f, 360.0f), vel(-3.0f, 3.0f);
+    World world;
+    for (size_t i = 0; i < count; i++) {
+        float h = size(rng);
+        Entity e = world.createLandmark({pos(rng), h / 2, pos(rng)}, {size(rng), h, size(rng)}, angle(rng));
+        if (i % dynamicEvery != dynamicEvery - 1) continue;
+        world.colliders.get(e).isStatic = false;
+        world.velocities.add(e, Velocity{{vel(rng), 0.0f, vel(rng)}, {0.0f, vel(rng) * 10.0f, 0.0f}});
+    }
+
+    MotionSystem motion;
+    WorldMatrixSystem matrices;
+    CollisionSystem collision;
+    matrices.update(world);
+    collision.update(world);
+
+    constexpr int STEPS = 120;
+    double seconds = 0.0;
+    size_t pairs = 0, contacts = 0;
+    for (int i = 0; i < STEPS; i++) {
+        motion.update(world, 1.0f / 60.0f);
+        matrices.update(world);
+        auto start = Clock::now();
+        collision.update(world);
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        pairs += collision.pairCount();
+        contacts += collision.contacts().size();
+    }
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "CollisionSystem::update (%s)", name);
+    report(label, count * STEPS / seconds, "body");
+    std::printf("  %-40s %10.3f ms/step, %zu pairs, %zu contacts\n", "", seconds * 1000.0 / STEPS,
+                pairs / STEPS, contacts / STEPS);
+}
+
+void benchCollision() {
+    collisionScene("sparse, 20k", 20000, 2000.0f, 2);
+    collisionScene("dense, 20k", 20000, 300.0f, 2);
+    // A mostly settled world: one body in ten moving
+    collisionScene("sparse, 2k/20k", 20000, 2000.0f, 10);
+    collisionScene("dense, 2k/20k", 20000, 300.0f, 10);
+}
+
+} // namespace bench
+} // namespace myth
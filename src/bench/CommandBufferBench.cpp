@@ -0,0 +1,102 @@
+#include "Bench.h"
+#include "engine/ecs/CommandBuffer.h"
+#include <random>
+
+namespace myth {
+namespace bench {
+
+using namespace myth::ecs;
+
+// Spawning then despawning a batch of NPC-like entities (transform, matrix,
+// velocity, gravity, renderable) in a world that already holds BASE
+// entities: immediately, one entity at a time, against recording into
+// command buffers and playing them back at once
+void benchCommandBuffer() {
+    constexpr size_t BASE = 100000;
+    constexpr uint32_t BATCH = 20000;
+    std::mt19937 rng(26);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f), vel(-5.0f, 5.0f);
+
+    World world;
+    for (size_t i = 0; i < BASE; i++) {
+        Entity e = world.createEntity({pos(rng), 0.0f, pos(rng)});
+        world.bounds.add(e, LocalBounds{});
+        world.renderables.add(e, Renderable{});
+    }
+    std::vector<glm::vec3> spawns(BATCH), velocities(BATCH);
+    for (uint32_t i = 0; i < BATCH; i++) {
+        spawns[i] = {pos(rng), 5.0f, pos(rng)};
+        velocities[i] = {vel(rng), 0.0f, vel(rng)};
+    }
+
+    // The spawned entities are the only ones with a Velocity
+    auto spawned = [&] {
+        return std::vector<Entity>(world.velocities.entities(), world.velocities.entities() + world.velocities.size());
+    };
+
+    std::vector<Entity> batch(BATCH);
+    report("Immediate spawn + despawn", itemsPerSecond(BATCH, [&] {
+        for (uint32_t i = 0; i < BATCH; i++) {
+            Entity e = world.createEntity(spawns[i]);
+            world.velocities.add(e, Velocity{velocities[i], {}});
+            world.gravities.add(e, Gravity{});
+            world.renderables.add(e, Renderable{});
+            batch[i] = e;
+        }
+        for (Entity e : batch) world.destroyEntity(e);
+    }), "entity");
+
+    auto record = [&](EntityCommandBuffer& commands, uint32_t i) {
+        Entity e = commands.create();
+        Transform t;
+        t.position = spawns[i];
+        commands.add(e, t);
+        commands.add(e, WorldMatrix{});
+        commands.add(e, Velocity{velocities[i], {}});
+        commands.add(e, Gravity{});
+        commands.add(e, Renderable{});
+    };
+
+    EntityCommandBuffer commands;
+    report("EntityCommandBuffer spawn + despawn", itemsPerSecond(BATCH, [&] {
+        for (uint32_t i = 0; i < BATCH; i++) record(commands, i);
+        EntityCommandBuffer::playback(world, {&commands, 1});
+        for (Entity e : spawned()) commands.destroy(e);
+        EntityCommandBuffer::playback(world, {&commands, 1});
+    }), "entity");
+
+    // Recording is spread over the threads that make the changes; what the
+    // sync point pays is the playback
+    double playbackSeconds = 0.0;
+    size_t runs = 0;
+    for (auto start = Clock::now(); std::chrono::duration<double>(Clock::now() - start).count() < 0.5; runs++) {
+        for (uint32_t i = 0; i < BATCH; i++) record(commands, i);
+        auto spawnStart = Clock::now();
+        EntityCommandBuffer::playback(world, {&commands, 1});
+        playbackSeconds += std::chrono::duration<double>(Clock::now() - spawnStart).count();
+        for (Entity e : spawned()) commands.destroy(e);
+        auto despawnStart = Clock::now();
+        EntityCommandBuffer::playback(world, {&commands, 1});
+        playbackSeconds += std::chrono::duration<double>(Clock::now() - despawnStart).count();
+    }
+    report("EntityCommandBuffer playback alone", BATCH * static_cast<double>(runs) / playbackSeconds, "entity");
+
+    JobSystem jobs;
+    EntityCommandBuffers buffers(jobs);
+    report("EntityCommandBuffers spawn + despawn (jobs)", itemsPerSecond(BATCH, [&] {
+        jobs.parallelFor(BATCH, 1024, [&](uint32_t begin, uint32_t end) {
+            EntityCommandBuffer& local = buffers.local();
+            for (uint32_t i = begin; i < end; i++) record(local, i);
+        });
+        buffers.playback(world);
+        const std::vector<Entity> despawn = spawned();
+        jobs.parallelFor(static_cast<uint32_t>(despawn.size()), 1024, [&](uint32_t begin, uint32_t end) {
+            EntityCommandBuffer& local = buffers.local();
+            for (uint32_t i = begin; i < end; i++) local.destroy(despawn[i]);
+        });
+        buffers.playback(world);
+    }), "entity");
+}
+
+} // namespace bench
+} // namespace myth
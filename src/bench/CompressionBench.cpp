@@ -0,0 +1,81 @@
+#include "Bench.h"
+#include "core/JobSystem.h"
+#include "engine/Compression.h"
+#include "engine/ecs/Serialization.h"
+#include "engine/world/ChunkManager.h"
+#include "sim/GameWorld.h"
+#include <cstring>
+#include <random>
+
+namespace myth {
+namespace bench {
+
+using compression::Filter;
+
+// Ratio, then compression on one thread and on the JobSystem, then
+// decompression, all in MB/s of raw data
+static void measure(const char* name, const void* data, size_t size, Filter filter, uint32_t stride, JobSystem& jobs) {
+    std::vector<uint8_t> stream(compression::compressBound(size));
+    std::vector<uint8_t> decoded(size);
+    const size_t streamSize = compression::compress(data, size, stream.data(), filter, stride);
+    const bool ok = compression::decompress(stream.data(), streamSize, decoded.data(), decoded.size()) &&
+                    std::memcmp(decoded.data(), data, size) == 0;
+    std::printf("  %s: %.3f MB -> %.3f MB, %.2fx%s\n", name, size / 1e6, streamSize / 1e6,
+                static_cast<double>(size) / static_cast<double>(streamSize), ok ? "" : " (ROUND TRIP FAILED)");
+
+    const double bytes = static_cast<double>(size);
+    report("compress (1 thread)", itemsPerSecond(bytes, [&] {
+        doNotOptimize(compression::compress(data, size, stream.data(), filter, stride));
+    }), "B");
+    report("compress (jobs)", itemsPerSecond(bytes, [&] {
+        doNotOptimize(compression::compress(data, size, stream.data(), filter, stride, &jobs));
+    }), "B");
+    report("decompress", itemsPerSecond(bytes, [&] {
+        doNotOptimize(compression::decompress(stream.data(), streamSize, decoded.data(), decoded.size()));
+    }), "B");
+}
+
+void benchCompression() {
+    JobSystem jobs;
+
+    // The sections of a save written after a stretch of play, filtered the
+    // way SaveManager::encodeBinary() filters them, with regions topped up
+    // to the count SaveBench uses
+    GameWorld game;
+    ScriptedCommandStream commands(7);
+    game.populate();
+    for (int i = 0; i < 600; i++) game.step(1.0f / 60.0f, commands);
+    SaveData save = game.save();
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> coord(-5000, 5000), state(0, 3);
+    std::uniform_real_distribution<float> pressure(0.0f, 1.0f);
+    while (save.regions.size() < 200000) save.regions.push_back({coord(rng), coord(rng), state(rng), pressure(rng)});
+    measure("REGN section", save.regions.data(), save.regions.size() * sizeof(RegionSave), Filter::None, 4, jobs);
+    measure("WRLD section (played world)", save.world.data(), save.world.size(), Filter::Delta, 4, jobs);
+
+    // A world the size SnapshotBench uses
+    ecs::World world;
+    std::uniform_real_distribution<float> pos(-5000.0f, 5000.0f), angle(0.0f, 360.0f);
+    for (int i = 0; i < 250000; i++) world.createLandmark({pos(rng), 0.0f, pos(rng)}, {1.5f, 2.0f, 1.5f}, angle(rng));
+    std::string snapshot;
+    ecs::serializeWorld(world, snapshot);
+    measure("WRLD section (250k landmarks)", snapshot.data(), snapshot.size(), Filter::Delta, 4, jobs);
+
+    // Terrain tiles as ChunkCache stores them
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    for (int z = 0; z < 16; z++) {
+        for (int x = 0; x < 16; x++) {
+            Chunk chunk;
+            chunk.coord = {x, z, 0};
+            chunk.generate(32.0f);
+            vertices.insert(vertices.end(), chunk.geometry.vertices, chunk.geometry.vertices + chunk.geometry.vertexCount);
+            indices.insert(indices.end(), chunk.geometry.indices, chunk.geometry.indices + chunk.geometry.indexCount);
+        }
+    }
+    measure("chunk vertices (256 tiles)", vertices.data(), vertices.size() * sizeof(Vertex), Filter::Delta, sizeof(Vertex), jobs);
+    measure("chunk indices (256 tiles)", indices.data(), indices.size() * sizeof(uint32_t), Filter::Delta, 6 * sizeof(uint32_t), jobs);
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,25 @@
+#include "Bench.h"
+#include "sim/GameWorld.h"
+
+namespace myth {
+namespace bench {
+
+void benchGameWorld() {
+    constexpr float STEP = 1.0f / 60.0f;
+    GameWorld game;
+    ScriptedCommandStream commands(7);
+    game.populate();
+    report("GameWorld::step (1 thread)", itemsPerSecond(1, [&] {
+        game.step(STEP, commands);
+    }), "tick");
+
+    JobSystem jobs;
+    GameWorld threaded(&jobs);
+    threaded.populate();
+    report("GameWorld::step (jobs)", itemsPerSecond(1, [&] {
+        threaded.step(STEP, commands);
+    }), "tick");
+}
+
+} // namespace bench
+} // namespace myth
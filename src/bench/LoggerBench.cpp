@@ -0,0 +1,64 @@
+#include "Bench.h"
+#include "engine/Logger.h"
+
+namespace myth {
+namespace bench {
+
+// Time only the log calls: bursts that fit the ring, each drained and
+// written out before the next so the background thread stays out of it
+static double callsPerSecond(const char* text) {
+    constexpr int BURST = 500;
+    double seconds = 0.0;
+    size_t calls = 0;
+    while (seconds < 0.5) {
+        Logger::flush();
+        const auto start = Clock::now();
+        for (int i = 0; i < BURST; i++) Logger::infof("Entity {} moved to {:.2f} in {}", i, i * 0.5f, text);
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        calls += BURST;
+    }
+    return static_cast<double>(calls) / seconds;
+}
+
+void benchLogger() {
+    std::FILE* sink = std::tmpfile();
+    if (!sink) {
+        std::printf("  could not open a temporary file\n");
+        return;
+    }
+    Logger::setOutput(sink);
+
+    const double shortCall = callsPerSecond("a");
+    const double longCall = callsPerSecond("a region whose name takes up some room");
+
+    // Everything the background thread can format and write, with callers
+    // held back rather than dropping
+    Logger::setOverflow(LogOverflow::Block);
+    const double written = itemsPerSecond(10000, [] {
+        for (int i = 0; i < 10000; i++) Logger::infof("Entity {} moved to {:.2f} in {}", i, i * 0.5f, "a");
+        Logger::flush();
+    });
+    Logger::setOverflow(LogOverflow::Drop);
+
+    // What a log line left in a per-entity loop costs on the calls that
+    // write nothing
+    constexpr int LOOP = 1000000;
+    const double limited = itemsPerSecond(LOOP, [] {
+        for (int i = 0; i < LOOP; i++) MYTH_LOG_EVERY_MS(Info, 1000, "Entity {} moved to {:.2f}", i, i * 0.5f);
+    });
+    const double sampled = itemsPerSecond(LOOP, [] {
+        for (int i = 0; i < LOOP; i++) MYTH_LOG_EVERY_N(Info, 100000, "Entity {} moved to {:.2f}", i, i * 0.5f);
+    });
+    Logger::flush();
+    Logger::setOutput(stdout);
+    std::fclose(sink);
+
+    report("Logger::infof, int/float/short string", shortCall, "call");
+    report("Logger::infof, int/float/long string", longCall, "call");
+    report("formatted and written (blocking)", written, "record");
+    report("MYTH_LOG_EVERY_MS(1000)", limited, "call");
+    report("MYTH_LOG_EVERY_N(100000)", sampled, "call");
+}
+
+} // namespace bench
+} // namespace myth
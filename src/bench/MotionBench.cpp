@@ -0,0 +1,34 @@
+#include "Bench.h"
+#include "engine/ecs/MotionSystem.h"
+#include <random>
+
+namespace myth {
+namespace bench {
+
+using namespace myth::ecs;
+
+void benchMotion() {
+    constexpr size_t COUNT = 100000;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f), vel(-5.0f, 5.0f);
+
+    World world;
+    for (size_t i = 0; i < COUNT; i++) {
+        Entity e = world.createEntity({pos(rng), pos(rng) * 0.01f + 5.0f, pos(rng)});
+        world.velocities.add(e, Velocity{{vel(rng), vel(rng), vel(rng)}, {0.0f, vel(rng) * 10.0f, 0.0f}});
+        if (i % 2 == 0) world.gravities.add(e, Gravity{20.0f, 0.0f, false});
+    }
+
+    MotionSystem motion;
+    report("MotionSystem (1 thread)", itemsPerSecond(COUNT, [&] {
+        motion.update(world, 1.0f / 60.0f);
+    }), "entity");
+
+    JobSystem jobs;
+    report("MotionSystem (jobs)", itemsPerSecond(COUNT, [&] {
+        motion.update(world, 1.0f / 60.0f, &jobs);
+    }), "entity");
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,85 @@
+#include "Bench.h"
+#include "core/JobSystem.h"
+#include "engine/math/Noise.h"
+#include "engine/world/ChunkManager.h"
+#include <cmath>
+#include <random>
+
+namespace myth {
+namespace bench {
+
+// The scalar value noise terrain used before: chunkRandom at the four
+// corners of each cell, one sample at a time
+static float scalarValueFbm(float x, float z, int octaves) {
+    float sum = 0.0f, amplitude = 1.0f, total = 0.0f, frequency = 1.0f;
+    for (int octave = 0; octave < octaves; octave++) {
+        const float sx = x * frequency, sz = z * frequency;
+        const float fx = std::floor(sx), fz = std::floor(sz);
+        const int ix = static_cast<int>(fx), iz = static_cast<int>(fz);
+        float u = sx - fx, v = sz - fz;
+        u = u * u * (3.0f - 2.0f * u);
+        v = v * v * (3.0f - 2.0f * v);
+        const float bottom = glm::mix(chunkRandom(ix, iz, octave), chunkRandom(ix + 1, iz, octave), u);
+        const float top = glm::mix(chunkRandom(ix, iz + 1, octave), chunkRandom(ix + 1, iz + 1, octave), u);
+        sum += glm::mix(bottom, top, v) * amplitude;
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    return sum / total;
+}
+
+void benchNoise() {
+    constexpr size_t COUNT = 1 << 16;
+    constexpr int OCTAVES = 4;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> coord(-1000.0f, 1000.0f);
+    std::vector<float> x(COUNT), y(COUNT), z(COUNT), out(COUNT);
+    for (size_t i = 0; i < COUNT; i++) { x[i] = coord(rng); y[i] = coord(rng); z[i] = coord(rng); }
+
+    report("scalar value fBm (chunkRandom lattice)", itemsPerSecond(COUNT, [&] {
+        for (size_t i = 0; i < COUNT; i++) out[i] = scalarValueFbm(x[i], y[i], OCTAVES);
+        doNotOptimize(out);
+    }), "sample");
+
+    noise::Fractal value{.basis = noise::Basis::Value, .octaves = OCTAVES};
+    noise::Fractal gradient{.basis = noise::Basis::Gradient, .octaves = OCTAVES};
+    noise::Fractal ridged{.basis = noise::Basis::Gradient, .ridged = true, .octaves = OCTAVES};
+
+    report("sample2 gradient fBm (one at a time)", itemsPerSecond(COUNT, [&] {
+        for (size_t i = 0; i < COUNT; i++) out[i] = noise::sample2(gradient, x[i], y[i]);
+        doNotOptimize(out);
+    }), "sample");
+
+    report("fill2 value fBm", itemsPerSecond(COUNT, [&] {
+        noise::fill2(value, x.data(), y.data(), out.data(), COUNT);
+        doNotOptimize(out);
+    }), "sample");
+
+    report("fill2 gradient fBm", itemsPerSecond(COUNT, [&] {
+        noise::fill2(gradient, x.data(), y.data(), out.data(), COUNT);
+        doNotOptimize(out);
+    }), "sample");
+
+    report("fill3 gradient fBm", itemsPerSecond(COUNT, [&] {
+        noise::fill3(gradient, x.data(), y.data(), z.data(), out.data(), COUNT);
+        doNotOptimize(out);
+    }), "sample");
+
+    report("fillGrid2 ridged 256x256", itemsPerSecond(COUNT, [&] {
+        noise::fillGrid2(ridged, 0.0f, 0.0f, 0.05f, 256, 256, out.data());
+        doNotOptimize(out);
+    }), "sample");
+
+    // Rows split across the pool; the result is the same whatever the split
+    JobSystem jobs;
+    report("fillGrid2 ridged 256x256 (jobs)", itemsPerSecond(COUNT, [&] {
+        jobs.parallelFor(256, 16, [&](uint32_t begin, uint32_t end) {
+            noise::fillGrid2(ridged, 0.0f, begin * 0.05f, 0.05f, 256, static_cast<int>(end - begin), out.data() + begin * 256);
+        });
+        doNotOptimize(out);
+    }), "sample");
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,41 @@
+#include "Bench.h"
+#include "engine/Profiler.h"
+#include <filesystem>
+
+namespace myth {
+namespace bench {
+
+void benchProfiler() {
+#ifdef MYTH_PROFILE
+    constexpr int ZONES = 60000;
+    report("zone, no capture running", itemsPerSecond(ZONES, [] {
+        for (int i = 0; i < ZONES; i++) {
+            MYTH_PROFILE_ZONE("Idle zone");
+            doNotOptimize(i);
+        }
+    }), "zone");
+
+    // Only the zones are timed, in bursts that fit a thread's buffer, each
+    // in a capture of its own so none is dropped
+    const std::string trace = (std::filesystem::temp_directory_path() / "mythbreaker_bench_trace.json").string();
+    constexpr int BURSTS = 3;
+    double seconds = 0.0;
+    for (int burst = 0; burst < BURSTS; burst++) {
+        Profiler::startCapture(trace);
+        const auto start = Clock::now();
+        for (int i = 0; i < ZONES; i++) {
+            MYTH_PROFILE_ZONE("Captured zone");
+            doNotOptimize(i);
+        }
+        seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        Profiler::stopCapture();
+    }
+    std::filesystem::remove(trace);
+    report("zone, capturing", BURSTS * ZONES / seconds, "zone");
+#else
+    std::printf("  profiler not built in (MYTH_PROFILE is off)\n");
+#endif
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,88 @@
+#include "Bench.h"
+#include "engine/SaveLoad.h"
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+namespace myth {
+namespace bench {
+
+static float findFloat(const std::string& str, const std::string& key) {
+    size_t pos = str.find(key);
+    if (pos == std::string::npos) return 0.0f;
+    pos += key.length();
+    while (pos < str.length() && (str[pos] == ' ' || str[pos] == '\t')) pos++;
+    return std::stof(str.substr(pos));
+}
+
+// How the JSON loader read regions before: find/substr over the document
+// and std::stof on a copy of the rest of each region's text
+static void findSubstrRegions(const std::string& content, std::vector<RegionSave>& out) {
+    out.clear();
+    size_t regionsStart = content.find("\"regions\": [");
+    if (regionsStart == std::string::npos) return;
+    size_t regionsEnd = content.find("]", regionsStart);
+    std::string regionsStr = content.substr(regionsStart, regionsEnd - regionsStart);
+    size_t pos = 0;
+    while ((pos = regionsStr.find("{", pos)) != std::string::npos) {
+        size_t end = regionsStr.find("}", pos);
+        std::string regionStr = regionsStr.substr(pos, end - pos);
+        out.push_back({static_cast<int>(findFloat(regionStr, "\"x\":")), static_cast<int>(findFloat(regionStr, "\"z\":")),
+                       static_cast<int>(findFloat(regionStr, "\"state\":")), findFloat(regionStr, "\"pressure\":")});
+        pos = end + 1;
+    }
+}
+
+void benchSave() {
+    constexpr int REGIONS = 200000;
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> coord(-5000, 5000), state(0, 3);
+    std::uniform_real_distribution<float> pressure(0.0f, 1.0f);
+    SaveData data;
+    data.playTime = 1234.5f;
+    data.playerPosition = {120.25f, 3.5f, -87.75f};
+    for (int i = 0; i < REGIONS; i++) data.regions.push_back({coord(rng), coord(rng), state(rng), pressure(rng)});
+
+    const auto directory = std::filesystem::temp_directory_path();
+    const std::string json = (directory / "mythbreaker_bench_save.json").string();
+    const std::string binary = (directory / "mythbreaker_bench_save.sav").string();
+    if (!SaveManager::save(data, json) || !SaveManager::save(data, binary)) {
+        std::printf("  could not write saves in %s\n", directory.string().c_str());
+        return;
+    }
+    const double jsonBytes = static_cast<double>(std::filesystem::file_size(json));
+    const double binaryBytes = static_cast<double>(std::filesystem::file_size(binary));
+    std::printf("  %d regions: %.1f MB JSON, %.1f MB binary\n", REGIONS, jsonBytes / 1e6, binaryBytes / 1e6);
+
+    std::vector<RegionSave> regions;
+    report("JSON regions, find/substr/stof", itemsPerSecond(jsonBytes, [&] {
+        std::ifstream file(json);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        findSubstrRegions(buffer.str(), regions);
+        doNotOptimize(regions);
+    }), "B");
+
+    SaveData loaded;
+    report("JSON load (JsonReader)", itemsPerSecond(jsonBytes, [&] {
+        SaveManager::loadJson(loaded, json);
+        doNotOptimize(loaded);
+    }), "B");
+
+    report("binary load (SaveView copied out)", itemsPerSecond(binaryBytes, [&] {
+        SaveManager::load(loaded, binary);
+        doNotOptimize(loaded);
+    }), "B");
+
+    SaveView view;
+    report("binary open (SaveView in place)", itemsPerSecond(REGIONS, [&] {
+        view.open(binary);
+        doNotOptimize(view.regions().back());
+    }), "region");
+
+    std::filesystem::remove(json);
+    std::filesystem::remove(binary);
+}
+
+} // namespace bench
+} // namespace myth
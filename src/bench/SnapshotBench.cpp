@@ -0,0 +1,54 @@
+#include "Bench.h"
+#include "engine/ecs/Serialization.h"
+#include <random>
+
+namespace myth {
+namespace bench {
+
+using namespace myth::ecs;
+
+void benchSnapshot() {
+    constexpr size_t COUNT = 1000000;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> pos(-5000.0f, 5000.0f), angle(0.0f, 360.0f);
+
+    // Mostly landmarks, some moving bodies, and every 16th destroyed so the
+    // free list is not empty
+    World world;
+    world.entities.reserve(COUNT);
+    Entity player = world.createPlayer({0, 0, 0});
+    world.createCamera(player);
+    for (size_t i = 0; i < COUNT; i++) {
+        Entity e = world.createLandmark({pos(rng), 0.0f, pos(rng)}, {1.5f, 2.0f, 1.5f}, angle(rng));
+        if (i % 4 == 0) world.velocities.add(e, Velocity{{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}});
+        if (i % 16 == 15) world.destroyEntity(e);
+    }
+
+    std::string bytes;
+    serializeWorld(world, bytes);
+    const size_t entities = world.entities.count();
+    std::printf("  %zu entities: %.1f MB snapshot\n", entities, bytes.size() / 1e6);
+
+    report("serializeWorld", itemsPerSecond(static_cast<double>(entities), [&] {
+        bytes.clear();
+        serializeWorld(world, bytes);
+        doNotOptimize(bytes);
+    }), "entity");
+
+    const std::span<const uint8_t> snapshot(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    World loaded;
+    report("deserializeWorld (replace)", itemsPerSecond(static_cast<double>(entities), [&] {
+        deserializeWorld(loaded, snapshot);
+        doNotOptimize(loaded);
+    }), "entity");
+
+    std::vector<Entity> remap;
+    report("deserializeWorld (merge into empty)", itemsPerSecond(static_cast<double>(entities), [&] {
+        World merged;
+        deserializeWorld(merged, snapshot, SnapshotLoad::Merge, &remap);
+        doNotOptimize(merged);
+    }), "entity");
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,84 @@
+#include "Bench.h"
+#include "engine/ecs/SpatialIndex.h"
+#include "engine/ecs/TransformSystem.h"
+#include <random>
+
+namespace myth {
+namespace bench {
+
+using namespace myth::ecs;
+
+void benchSpatial() {
+    constexpr size_t COUNT = 100000;
+    constexpr float EXTENT = 1000.0f;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> pos(-EXTENT, EXTENT), size(0.5f, 4.0f), angle(0.0f, 360.0f);
+
+    World world;
+    for (size_t i = 0; i < COUNT; i++) {
+        float h = size(rng);
+        world.createLandmark({pos(rng), h / 2, pos(rng)}, {size(rng), h, size(rng)}, angle(rng));
+    }
+    WorldMatrixSystem matrices;
+    matrices.update(world);
+
+    SpatialIndex index;
+    report("SpatialIndex::rebuild", itemsPerSecond(COUNT, [&] { index.rebuild(world); }), "entity");
+
+    // Rays across the field at head height, in random horizontal directions
+    constexpr size_t RAYS = 4096;
+    std::vector<glm::vec3> origins(RAYS), dirs(RAYS);
+    for (size_t i = 0; i < RAYS; i++) {
+        origins[i] = {pos(rng), 1.0f, pos(rng)};
+        float a = glm::radians(angle(rng));
+        dirs[i] = {std::sin(a), -0.01f, std::cos(a)};
+    }
+    size_t hits = 0;
+    report("SpatialIndex::raycast (200 units)", itemsPerSecond(RAYS, [&] {
+        for (size_t i = 0; i < RAYS; i++) hits += index.raycast(origins[i], dirs[i], 200.0f) ? 1 : 0;
+    }), "ray");
+    report("SpatialIndex::raycast (10 units)", itemsPerSecond(RAYS, [&] {
+        for (size_t i = 0; i < RAYS; i++) hits += index.raycast(origins[i], dirs[i], 10.0f) ? 1 : 0;
+    }), "ray");
+    doNotOptimize(hits);
+
+    // The same kind of rays as one large batch, traced in Z-order
+    constexpr size_t BATCH = 65536;
+    std::vector<RayQuery> batch(BATCH);
+    std::vector<SpatialHit> batchHits(BATCH);
+    for (RayQuery& query : batch) {
+        float a = glm::radians(angle(rng));
+        query.origin = {pos(rng), 1.0f, pos(rng)};
+        query.direction = {std::sin(a), -0.01f, std::cos(a)};
+        query.maxDistance = 200.0f;
+    }
+    report("SpatialIndex::raycast batch (200 units)", itemsPerSecond(BATCH, [&] {
+        index.raycast(batch, batchHits);
+    }), "ray");
+    JobSystem jobs;
+    report("SpatialIndex::raycast batch (jobs)", itemsPerSecond(BATCH, [&] {
+        index.raycast(batch, batchHits, &jobs);
+    }), "ray");
+    doNotOptimize(batchHits);
+
+    size_t found = 0;
+    report("SpatialIndex::querySphere (r = 10)", itemsPerSecond(RAYS, [&] {
+        for (size_t i = 0; i < RAYS; i++) index.querySphere(origins[i], 10.0f, [&](Entity) { found++; });
+    }), "query");
+    doNotOptimize(found);
+
+    // 1% of entities move each update: refit instead of rebuild
+    std::vector<Entity> moving;
+    world.landmarkTags.view().each([&](Entity e, const LandmarkTag&) { if (moving.size() < COUNT / 100) moving.push_back(e); });
+    index.update(world);
+    float phase = 0.0f;
+    report("SpatialIndex::update (1% moved)", itemsPerSecond(COUNT, [&] {
+        phase += 0.1f;
+        for (Entity e : moving) world.transforms.get(e).position.y = std::sin(phase);
+        matrices.update(world);
+        index.update(world);
+    }), "entity");
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,50 @@
+#include "Bench.h"
+#include "engine/ecs/TransformSystem.h"
+#include <random>
+
+namespace myth {
+namespace bench {
+
+using namespace myth::ecs;
+
+void benchWorldMatrices() {
+    constexpr size_t COUNT = 100000;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f), angle(0.0f, 360.0f), scale(0.5f, 3.0f);
+
+    std::vector<Transform> transforms(COUNT);
+    for (auto& t : transforms) {
+        t.position = {pos(rng), pos(rng), pos(rng)};
+        t.rotation = {angle(rng), angle(rng), angle(rng)};
+        t.scale = {scale(rng), scale(rng), scale(rng)};
+    }
+
+    std::vector<glm::mat4> mats(COUNT);
+    report("Transform::getMatrix (scalar)", itemsPerSecond(COUNT, [&] {
+        for (size_t i = 0; i < COUNT; i++) mats[i] = transforms[i].getMatrix();
+        doNotOptimize(mats);
+    }), "mat");
+
+    std::vector<WorldMatrix> out(COUNT);
+    report("composeWorldMatrices (1 thread)", itemsPerSecond(COUNT, [&] {
+        composeWorldMatrices(transforms.data(), out.data(), COUNT);
+        doNotOptimize(out);
+    }), "mat");
+
+    World world;
+    for (const auto& t : transforms) world.createEntity(t.position, t.rotation, t.scale);
+    JobSystem jobs;
+    WorldMatrixSystem system;
+    report("WorldMatrixSystem, all dirty (jobs)", itemsPerSecond(COUNT, [&] {
+        system.invalidate();
+        system.update(world, &jobs);
+    }), "mat");
+
+    report("WorldMatrixSystem, 1% dirty (jobs)", itemsPerSecond(COUNT, [&] {
+        for (size_t i = 0; i < COUNT; i += 100) world.transforms.get(static_cast<Entity>(i)).rotation.y += 1.0f;
+        system.update(world, &jobs);
+    }), "entity");
+}
+
+} // namespace bench
+} // namespace myth
@@ -0,0 +1,39 @@
+#include "Bench.h"
+#include <cstring>
+
+using namespace myth::bench;
+
+static const Benchmark BENCHMARKS[] = {
+    {"commands", benchCommandBuffer},
+    {"world_matrices", benchWorldMatrices},
+    {"motion", benchMotion},
+    {"game_world", benchGameWorld},
+    {"spatial", benchSpatial},
+    {"collision", benchCollision},
+    {"noise", benchNoise},
+    {"chunk_cache", benchChunkCache},
+    {"save", benchSave},
+    {"snapshot", benchSnapshot},
+    {"compression", benchCompression},
+    {"logger", benchLogger},
+    {"profiler", benchProfiler},
+};
+
+int main(int argc, char** argv) {
+    // No arguments runs everything; otherwise only the named benchmarks
+    int ran = 0;
+    for (const auto& b : BENCHMARKS) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++) selected |= std::strcmp(argv[i], b.name) == 0;
+        if (!selected) continue;
+        std::printf("[%s]\n", b.name);
+        b.run();
+        ran++;
+    }
+    if (ran == 0) {
+        std::printf("Unknown benchmark. Available:\n");
+        for (const auto& b : BENCHMARKS) std::printf("  %s\n", b.name);
+        return 1;
+    }
+    return 0;
+}
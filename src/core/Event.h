@@ -29,6 +29,9 @@ enum class EventType : uint32_t
     CombatStarted,
     CombatEnded,
     ActorKilled,
+
+    // Persistence
+    SaveCompleted,     // data: "file", "kind", "ok" ("1"/"0"), "bytes", "ms"
 };
 
 // Generic event payload.
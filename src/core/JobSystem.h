@@ -1,13 +1,17 @@
 #pragma once
 
+#include "engine/Logger.h"
+#include "engine/Profiler.h"
+
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
 #include <functional>
+#include <atomic>
+#include <memory>
 #include <cstdint>
-#include <iostream>
 
 // Simple thread-pool based job system.
 // Header-only so it's easy to reuse across the engine.
@@ -22,11 +26,26 @@ public:
     // Block until all scheduled jobs have finished.
     void wait();
 
+    // Split [0, count) into ranges of at most `grain` items, run
+    // func(begin, end) for each and return once all of them have finished.
+    // The calling thread runs ranges too, so this may be called from a job.
+    // Small inputs run inline on the calling thread.
+    template<typename Func>
+    void parallelFor(uint32_t count, uint32_t grain, Func&& func);
+
     // Number of worker threads in the pool.
     uint32_t threadCount() const;
 
+    // Index of the calling thread: [0, threadCount()) on one of this pool's
+    // workers, threadCount() anywhere else. Use it to pick per-thread data.
+    uint32_t currentThreadIndex() const;
+
 private:
-    void workerLoop();
+    void workerLoop(uint32_t index);
+
+    // Which pool/worker slot the current thread belongs to.
+    static inline thread_local const JobSystem* t_owner = nullptr;
+    static inline thread_local uint32_t t_index = 0;
 
     std::vector<std::thread> m_workers;
     std::queue<std::function<void()>> m_jobs;
@@ -50,10 +69,10 @@ inline JobSystem::JobSystem(uint32_t threadCount)
 
     m_workers.reserve(threadCount);
     for (uint32_t i = 0; i < threadCount; ++i) {
-        m_workers.emplace_back([this]() { workerLoop(); });
+        m_workers.emplace_back([this, i]() { workerLoop(i); });
     }
 
-    std::cout << "JobSystem: started with " << threadCount << " worker threads\n";
+    myth::Logger::infof("JobSystem: started with {} worker threads", threadCount);
 }
 
 inline JobSystem::~JobSystem()
@@ -89,13 +108,76 @@ inline void JobSystem::wait()
     });
 }
 
+template<typename Func>
+inline void JobSystem::parallelFor(uint32_t count, uint32_t grain, Func&& func)
+{
+    if (grain == 0) {
+        grain = 1;
+    }
+    if (count <= grain || m_workers.size() <= 1) {
+        func(0u, count);
+        return;
+    }
+
+    // Ranges are claimed from a shared counter by the helper jobs and by the
+    // calling thread alike, so the call finishes even when every worker is
+    // busy, including when it is made from a job on this pool. Helpers that
+    // start after the last range was claimed find nothing left to do; the
+    // state is shared so they may outlive this call, but they only touch
+    // `func` after claiming a range.
+    struct State {
+        std::atomic<uint32_t> next{0};
+        uint32_t remaining = 0;
+        std::mutex mutex;
+        std::condition_variable doneCv;
+    };
+    const uint32_t ranges = (count + grain - 1) / grain;
+    auto state = std::make_shared<State>();
+    state->remaining = ranges;
+
+    auto* body = &func;
+    auto run = [state, body, count, grain, ranges]() {
+        uint32_t finished = 0;
+        for (uint32_t range; (range = state->next.fetch_add(1)) < ranges; ++finished) {
+            uint32_t begin = range * grain;
+            uint32_t end = count - begin > grain ? begin + grain : count;
+            (*body)(begin, end);
+        }
+        if (finished > 0) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->remaining -= finished;
+            if (state->remaining == 0) {
+                state->doneCv.notify_one();
+            }
+        }
+    };
+
+    const uint32_t helpers = ranges - 1 < threadCount() ? ranges - 1 : threadCount();
+    for (uint32_t i = 0; i < helpers; ++i) {
+        schedule(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->doneCv.wait(lock, [&state]() { return state->remaining == 0; });
+}
+
 inline uint32_t JobSystem::threadCount() const
 {
     return static_cast<uint32_t>(m_workers.size());
 }
 
-inline void JobSystem::workerLoop()
+inline uint32_t JobSystem::currentThreadIndex() const
 {
+    return t_owner == this ? t_index : threadCount();
+}
+
+inline void JobSystem::workerLoop(uint32_t index)
+{
+    t_owner = this;
+    t_index = index;
+    MYTH_PROFILE_THREAD(("Worker " + std::to_string(index)).c_str());
+
     while (true) {
         std::function<void()> job;
 
@@ -113,7 +195,10 @@ inline void JobSystem::workerLoop()
             m_jobs.pop();
         }
 
-        job();
+        {
+            MYTH_PROFILE_ZONE("Job");
+            job();
+        }
 
         {
             std::unique_lock<std::mutex> lock(m_mutex);
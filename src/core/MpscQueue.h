@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Unbounded multi-producer, single-consumer queue. push() is lock-free: one
+// compare-exchange on the head of a linked list. The consumer takes the
+// whole list with a single exchange and hands the items back oldest first.
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+    ~MpscQueue();
+
+    // Safe from any thread.
+    void push(T value);
+
+    // Consumer thread only. Calls func(T&&) for every item pushed so far,
+    // oldest first, and returns how many there were.
+    template<typename Func>
+    size_t consumeAll(Func&& func);
+
+    bool empty() const { return m_head.load(std::memory_order_acquire) == nullptr; }
+
+private:
+    struct Node {
+        T value;
+        Node* next;
+    };
+
+    std::atomic<Node*> m_head{nullptr};
+};
+
+// ========================= Implementation ===================================
+
+template<typename T>
+inline MpscQueue<T>::~MpscQueue()
+{
+    consumeAll([](T&&) {});
+}
+
+template<typename T>
+inline void MpscQueue<T>::push(T value)
+{
+    Node* node = new Node{std::move(value), m_head.load(std::memory_order_relaxed)};
+    while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+template<typename T>
+template<typename Func>
+inline size_t MpscQueue<T>::consumeAll(Func&& func)
+{
+    // The list comes newest first; reverse it to hand items out in order
+    Node* node = m_head.exchange(nullptr, std::memory_order_acquire);
+    Node* oldest = nullptr;
+    while (node) {
+        Node* next = node->next;
+        node->next = oldest;
+        oldest = node;
+        node = next;
+    }
+
+    size_t count = 0;
+    while (oldest) {
+        Node* next = oldest->next;
+        func(std::move(oldest->value));
+        delete oldest;
+        oldest = next;
+        ++count;
+    }
+    return count;
+}
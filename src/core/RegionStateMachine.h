@@ -1,12 +1,12 @@
 #pragma once
 
 #include "EventBus.h"
+#include "engine/Logger.h"
 
 #include <cstdint>
 #include <functional>
 #include <vector>
 #include <string>
-#include <iostream>
 
 // Basic region ID type.
 // For now we just treat it as a uint32_t.
@@ -87,9 +87,8 @@ private:
         e.data["to"]   = std::to_string(static_cast<int>(to));
 
         // This is a good place to log for debugging.
-        std::cout << "[RegionStateMachine] Region " << m_regionId
-                  << " transitioned from " << static_cast<int>(from)
-                  << " to " << static_cast<int>(to) << "\n";
+        MYTH_LOG_DEBUG("[RegionStateMachine] Region {} transitioned from {} to {}", m_regionId,
+                       static_cast<int>(from), static_cast<int>(to));
 
         m_eventBus.emit(e);
     }
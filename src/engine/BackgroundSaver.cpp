@@ -0,0 +1,92 @@
+﻿#include "BackgroundSaver.h"
+#include "Profiler.h"
+#include <chrono>
+#include <string>
+
+namespace myth {
+
+void BackgroundSaver::save(SaveData snapshot, std::string filename) {
+    submit({std::move(snapshot), std::move(filename), false});
+}
+
+void BackgroundSaver::saveChanges(SaveData delta, std::string filename) {
+    submit({std::move(delta), std::move(filename), true});
+}
+
+void BackgroundSaver::submit(Request request) {
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_busy.load()) {
+            if (request.delta && m_waiting && m_waiting->filename == request.filename) {
+                applyDelta(m_waiting->data, request.data.meta(), request.data.regions);
+                if (!request.data.world.empty()) m_waiting->data.world = std::move(request.data.world);
+            } else {
+                // A full save supersedes whatever waits. So does a save to another file:
+                // only the newest request is kept.
+                m_waiting = std::move(request);
+            }
+            return;
+        }
+        m_busy = true;
+    }
+    if (m_jobs) m_jobs->schedule([this, request = std::move(request)]() mutable { run(std::move(request)); });
+    else run(std::move(request));
+}
+
+void BackgroundSaver::run(Request request) {
+    MYTH_PROFILE_ZONE("BackgroundSaver::run");
+    for (;;) {
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = [&start]() {
+            const auto now = std::chrono::steady_clock::now();
+            const double ms = std::chrono::duration<double, std::milli>(now - start).count();
+            start = now;
+            return ms;
+        };
+        size_t bytes = 0;
+        const bool ok = request.delta ? SaveManager::saveDelta(request.data, request.filename, &bytes)
+                                      : SaveManager::save(request.data, request.filename, &bytes, m_jobs);
+        if (!ok) m_needsFullSave = true;
+        else if (!request.delta) m_needsFullSave = false;
+        m_results.push({request.filename, request.delta ? Kind::Delta : Kind::Full, ok, bytes, elapsed()});
+
+        if (ok && request.delta && SaveManager::journalSize(request.filename) > compactThreshold) {
+            const bool compacted = SaveManager::compact(request.filename, m_jobs);
+            std::error_code ignored;
+            const uint64_t size = compacted ? std::filesystem::file_size(request.filename, ignored) : 0;
+            m_results.push({request.filename, Kind::Compact, compacted, static_cast<size_t>(size), elapsed()});
+        }
+
+        // Take over a save requested meanwhile rather than scheduling another job
+        std::lock_guard lock(m_mutex);
+        if (!m_waiting) {
+            // Notified under the lock: wait() in the destructor may return as soon as it is released
+            m_busy = false;
+            m_idleCv.notify_all();
+            return;
+        }
+        request = std::move(*m_waiting);
+        m_waiting.reset();
+    }
+}
+
+size_t BackgroundSaver::poll(EventBus& events) {
+    return m_results.consumeAll([&](Result&& result) {
+        static constexpr const char* KIND_NAMES[] = {"full", "delta", "compact"};
+        Event e;
+        e.type = EventType::SaveCompleted;
+        e.data["file"] = result.filename;
+        e.data["kind"] = KIND_NAMES[static_cast<int>(result.kind)];
+        e.data["ok"] = result.ok ? "1" : "0";
+        e.data["bytes"] = std::to_string(result.bytes);
+        e.data["ms"] = std::to_string(result.milliseconds);
+        events.emit(e);
+    });
+}
+
+void BackgroundSaver::wait() {
+    std::unique_lock lock(m_mutex);
+    m_idleCv.wait(lock, [this]() { return !m_busy.load(); });
+}
+
+} // namespace myth
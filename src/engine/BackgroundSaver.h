@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include "SaveLoad.h"
+#include "core/EventBus.h"
+#include "core/JobSystem.h"
+#include "core/MpscQueue.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+
+namespace myth {
+
+// Writes saves on the JobSystem: the caller takes a snapshot (a SaveData,
+// copied while the world is locked) and hands it over, and encoding, the
+// disk flush and the atomic rename all happen on a worker. Compression is
+// shared with the other workers. One write runs at a time. A save requested
+// while one is running waits for it, folded into whatever is already
+// waiting: a full save replaces it, a delta is applied on top of it, so no
+// change is lost.
+//
+// After appending a delta, the worker compacts the journal into a new
+// base once it has grown past `compactThreshold` bytes.
+//
+// Finished writes are reported by poll(), on the caller's thread, as
+// EventType::SaveCompleted events whose "kind" is "full", "delta" or
+// "compact". Without a JobSystem, save() writes before returning.
+class BackgroundSaver {
+public:
+    explicit BackgroundSaver(JobSystem* jobs = nullptr) : m_jobs(jobs) {}
+    // Finishes the running and waiting saves
+    ~BackgroundSaver() { wait(); }
+    BackgroundSaver(const BackgroundSaver&) = delete;
+    BackgroundSaver& operator=(const BackgroundSaver&) = delete;
+
+    uint64_t compactThreshold = 4 << 20;
+
+    // Replace the save with `snapshot`
+    void save(SaveData snapshot, std::string filename = SaveManager::DEFAULT_SAVE);
+    // Append `delta` (GameWorld::saveChanges()) to the save's journal. Fails,
+    // reporting so, if there is no base save written by this build yet.
+    void saveChanges(SaveData delta, std::string filename = SaveManager::DEFAULT_SAVE);
+
+    // True until a full save has been written, and again after any write
+    // fails: saveChanges() has already cleared the regions a lost delta
+    // carried, so only a full save brings the file up to date. Check it
+    // before taking each snapshot.
+    bool needsFullSave() const { return m_needsFullSave.load(); }
+
+    // Emit a SaveCompleted event for every write finished since the last
+    // call; returns how many there were
+    size_t poll(EventBus& events);
+
+    // Block until nothing is running or waiting
+    void wait();
+    bool busy() const { return m_busy.load(); }
+
+private:
+    enum class Kind { Full, Delta, Compact };
+    struct Request {
+        SaveData data;
+        std::string filename;
+        bool delta;
+    };
+    struct Result {
+        std::string filename;
+        Kind kind;
+        bool ok;
+        size_t bytes;
+        double milliseconds;
+    };
+
+    void submit(Request request);
+    void run(Request request);
+
+    JobSystem* m_jobs;
+    std::mutex m_mutex;
+    std::optional<Request> m_waiting; // guarded by m_mutex
+    std::atomic<bool> m_busy{false};  // a write is running; set and cleared under m_mutex
+    std::condition_variable m_idleCv; // signalled when m_busy is cleared
+    std::atomic<bool> m_needsFullSave{true};
+    MpscQueue<Result> m_results;
+};
+
+} // namespace myth
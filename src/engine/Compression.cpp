@@ -0,0 +1,328 @@
+﻿#include "Compression.h"
+#include "core/JobSystem.h"
+#include "engine/math/SimdMath.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace myth {
+namespace compression {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 14;
+
+uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t hash(uint32_t v) { return (v * 2654435761u) >> (32 - HASH_BITS); }
+
+size_t blockBound(size_t size) { return size + size / 255 + 16; }
+
+uint8_t* writeLength(uint8_t* out, size_t length) {
+    for (; length >= 255; length -= 255) *out++ = 255;
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+// One sequence: literals, then a match unless `matchLength` is 0 (the end)
+uint8_t* writeSequence(uint8_t* out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+    const size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+    uint8_t* token = out++;
+    *token = static_cast<uint8_t>(std::min<size_t>(literalCount, 15) << 4 | std::min<size_t>(matchCode, 15));
+    if (literalCount >= 15) out = writeLength(out, literalCount - 15);
+    std::memcpy(out, literals, literalCount);
+    out += literalCount;
+    if (matchLength == 0) return out;
+    *out++ = static_cast<uint8_t>(offset);
+    *out++ = static_cast<uint8_t>(offset >> 8);
+    if (matchCode >= 15) out = writeLength(out, matchCode - 15);
+    return out;
+}
+
+// Greedy LZ77 with a single-entry hash table of 4-byte prefixes. Skips
+// ahead faster the longer it goes without a match, so incompressible data
+// costs little.
+size_t lzCompress(const uint8_t* src, size_t size, uint8_t* dst) {
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+    uint8_t* out = dst;
+    size_t anchor = 0;
+    size_t i = 0;
+    while (size >= MIN_MATCH && i <= size - MIN_MATCH) {
+        const uint32_t v = read32(src + i);
+        uint32_t& slot = table[hash(v)];
+        const size_t candidate = slot;
+        slot = static_cast<uint32_t>(i);
+        if (candidate >= i || i - candidate > MAX_OFFSET || read32(src + candidate) != v) {
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (i + length + 8 <= size) {
+            const uint64_t diff = read64(src + candidate + length) ^ read64(src + i + length);
+            if (diff) {
+                length += static_cast<size_t>(std::countr_zero(diff)) / 8;
+                break;
+            }
+            length += 8;
+        }
+        if (i + length + 8 > size) {
+            while (i + length < size && src[candidate + length] == src[i + length]) length++;
+        }
+
+        out = writeSequence(out, src + anchor, i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+        if (i >= 2 && i - 2 <= size - MIN_MATCH) table[hash(read32(src + i - 2))] = static_cast<uint32_t>(i - 2);
+    }
+    out = writeSequence(out, src + anchor, size - anchor, 0, 0);
+    return static_cast<size_t>(out - dst);
+}
+
+bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+    uint8_t b;
+    do {
+        if (in == end) return false;
+        b = *in++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+bool lzDecompress(const uint8_t* in, size_t size, uint8_t* dst, size_t outSize) {
+    const uint8_t* end = in + size;
+    uint8_t* out = dst;
+    uint8_t* const outEnd = dst + outSize;
+    while (in < end) {
+        const uint8_t token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(in, end, literals)) return false;
+        if (literals > static_cast<size_t>(end - in) || literals > static_cast<size_t>(outEnd - out)) return false;
+        // Short runs dominate; copying a fixed 16 bytes when both sides have
+        // room avoids a variable-length copy, and the excess is overwritten
+        if (literals <= 16 && end - in >= 16 && outEnd - out >= 16) std::memcpy(out, in, 16);
+        else std::memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+        if (in == end) break;
+
+        if (end - in < 2) return false;
+        const size_t offset = in[0] | size_t(in[1]) << 8;
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(in, end, length)) return false;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(out - dst) || length > static_cast<size_t>(outEnd - out)) return false;
+
+        // Overlapping matches repeat a pattern: copy what is there, which
+        // doubles the distance every step
+        const uint8_t* from = out - offset;
+        if (length <= 16 && offset >= 16 && outEnd - out >= 16) {
+            std::memcpy(out, from, 16);
+            out += length;
+            continue;
+        }
+        while (length > 0) {
+            const size_t n = std::min(length, static_cast<size_t>(out - from));
+            std::memcpy(out, from, n);
+            out += n;
+            length -= n;
+        }
+    }
+    return out == outEnd;
+}
+
+void deltaFilter(const uint8_t* src, size_t size, uint32_t stride, uint8_t* dst) {
+    const size_t words = size / 4, lanes = stride / 4;
+    for (size_t i = 0; i < words; i++) {
+        const uint32_t d = read32(src + i * 4) - (i >= lanes ? read32(src + (i - lanes) * 4) : 0);
+        for (int p = 0; p < 4; p++) dst[p * words + i] = static_cast<uint8_t>(d >> (8 * p));
+    }
+    std::memcpy(dst + words * 4, src + words * 4, size - words * 4);
+}
+
+void deltaUnfilter(const uint8_t* src, size_t size, uint32_t stride, uint8_t* dst) {
+    const size_t words = size / 4, lanes = stride / 4;
+    // Interleave the byte planes back into words first, sixteen at a time
+    // where SSE2 is there, then add up the differences in a scalar pass:
+    // reading back words just written by vector stores of another
+    // alignment would stall on store forwarding at every step
+    size_t i = 0;
+#if MYTH_SIMD_SSE2
+    for (; i + 16 <= words; i += 16) {
+        const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + words + i));
+        const __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * words + i));
+        const __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * words + i));
+        const __m128i lo01 = _mm_unpacklo_epi8(p0, p1), hi01 = _mm_unpackhi_epi8(p0, p1);
+        const __m128i lo23 = _mm_unpacklo_epi8(p2, p3), hi23 = _mm_unpackhi_epi8(p2, p3);
+        __m128i* out = reinterpret_cast<__m128i*>(dst + i * 4);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(lo01, lo23));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo01, lo23));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi01, hi23));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi01, hi23));
+    }
+#endif
+    for (; i < words; i++) {
+        uint32_t d = 0;
+        for (int p = 0; p < 4; p++) d |= uint32_t(src[p * words + i]) << (8 * p);
+        std::memcpy(dst + i * 4, &d, sizeof(d));
+    }
+    for (i = lanes; i < words; i++) {
+        const uint32_t w = read32(dst + i * 4) + read32(dst + (i - lanes) * 4);
+        std::memcpy(dst + i * 4, &w, sizeof(w));
+    }
+    std::memcpy(dst + words * 4, src + words * 4, size - words * 4);
+}
+
+// Compressed size with STORED_BIT set when kept as is
+uint32_t compressBlock(const uint8_t* src, size_t size, Filter filter, uint32_t stride, uint8_t* out) {
+    std::vector<uint8_t> filtered;
+    const uint8_t* input = src;
+    if (filter == Filter::Delta) {
+        filtered.resize(size);
+        deltaFilter(src, size, stride, filtered.data());
+        input = filtered.data();
+    }
+    const size_t packed = lzCompress(input, size, out);
+    if (packed < size) return static_cast<uint32_t>(packed);
+    std::memcpy(out, src, size);
+    return static_cast<uint32_t>(size) | STORED_BIT;
+}
+
+bool readHeader(const uint8_t* stream, size_t size, StreamHeader& header) {
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, stream, sizeof(header));
+    if (header.filter > static_cast<uint8_t>(Filter::Delta) || header.blockSize == 0 || header.blockSize > BLOCK_SIZE) return false;
+    if (header.filter == static_cast<uint8_t>(Filter::Delta) && (header.stride == 0 || header.stride % 4 != 0)) return false;
+    return header.blockCount == (header.rawSize + header.blockSize - 1) / header.blockSize &&
+           header.blockCount <= (size - sizeof(header)) / sizeof(uint32_t) &&
+           header.rawSize <= (size - sizeof(header)) * MAX_EXPANSION;
+}
+
+} // namespace
+
+size_t compressBound(size_t size) {
+    const size_t blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return sizeof(StreamHeader) + blocks * sizeof(uint32_t) + size + blocks * (BLOCK_SIZE / 255 + 16);
+}
+
+size_t compress(const void* data, size_t size, void* out, Filter filter, uint32_t stride, JobSystem* jobs) {
+    if (filter == Filter::Delta && (stride == 0 || stride % 4 != 0 || stride > BLOCK_SIZE)) filter = Filter::None;
+    if (filter == Filter::None) stride = 1;
+    StreamHeader header{};
+    header.rawSize = size;
+    header.blockSize = BLOCK_SIZE / stride * stride; // whole records per block, so each filters alone
+    header.blockCount = static_cast<uint32_t>((size + header.blockSize - 1) / header.blockSize);
+    header.stride = stride;
+    header.filter = static_cast<uint8_t>(filter);
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    uint8_t* dst = static_cast<uint8_t*>(out);
+    std::memcpy(dst, &header, sizeof(header));
+    uint8_t* sizes = dst + sizeof(header);
+    uint8_t* blocks = sizes + header.blockCount * sizeof(uint32_t);
+    auto rawSizeOf = [&](uint32_t b) { return std::min<size_t>(header.blockSize, size - size_t(b) * header.blockSize); };
+
+    if (!jobs || jobs->threadCount() <= 1 || header.blockCount <= 1) {
+        for (uint32_t b = 0; b < header.blockCount; b++) {
+            const uint32_t stored = compressBlock(src + size_t(b) * header.blockSize, rawSizeOf(b), filter, stride, blocks);
+            std::memcpy(sizes + b * sizeof(uint32_t), &stored, sizeof(stored));
+            blocks += stored & ~STORED_BIT;
+        }
+        return static_cast<size_t>(blocks - dst);
+    }
+
+    // Workers and this thread claim blocks until none are left, so this
+    // never waits on a queued job and can run on a worker itself. Workers
+    // that start late find nothing to claim and only touch `shared`.
+    struct Shared {
+        std::atomic<uint32_t> next{0};
+        std::atomic<uint32_t> done{0};
+    };
+    auto shared = std::make_shared<Shared>();
+    std::vector<std::vector<uint8_t>> packed(header.blockCount);
+    std::vector<uint32_t> stored(header.blockCount);
+    auto work = [&, count = header.blockCount](Shared& s) {
+        for (uint32_t b; (b = s.next.fetch_add(1)) < count;) {
+            packed[b].resize(blockBound(rawSizeOf(b)));
+            stored[b] = compressBlock(src + size_t(b) * header.blockSize, rawSizeOf(b), filter, stride, packed[b].data());
+            s.done.fetch_add(1, std::memory_order_release);
+        }
+    };
+    const uint32_t helpers = std::min(jobs->threadCount(), header.blockCount - 1);
+    for (uint32_t h = 0; h < helpers; h++) {
+        jobs->schedule([shared, work, count = header.blockCount]() {
+            if (shared->next.load() < count) work(*shared);
+        });
+    }
+    work(*shared);
+    while (shared->done.load(std::memory_order_acquire) < header.blockCount) std::this_thread::yield();
+
+    for (uint32_t b = 0; b < header.blockCount; b++) {
+        std::memcpy(sizes + b * sizeof(uint32_t), &stored[b], sizeof(uint32_t));
+        const size_t n = stored[b] & ~STORED_BIT;
+        std::memcpy(blocks, packed[b].data(), n);
+        blocks += n;
+    }
+    return static_cast<size_t>(blocks - dst);
+}
+
+bool decompressedSize(const void* stream, size_t size, uint64_t& rawSize) {
+    StreamHeader header;
+    if (!readHeader(static_cast<const uint8_t*>(stream), size, header)) return false;
+    rawSize = header.rawSize;
+    return true;
+}
+
+bool decompress(const void* stream, size_t size, void* out, size_t outSize) {
+    const uint8_t* in = static_cast<const uint8_t*>(stream);
+    StreamHeader header;
+    if (!readHeader(in, size, header) || header.rawSize != outSize) return false;
+    const uint8_t* sizes = in + sizeof(header);
+    const uint8_t* block = sizes + header.blockCount * sizeof(uint32_t);
+    const uint8_t* end = in + size;
+    uint8_t* dst = static_cast<uint8_t*>(out);
+    // Sized for the largest block of this stream, not BLOCK_SIZE: small
+    // streams such as cached tiles would spend longer clearing it than decoding
+    std::vector<uint8_t> filtered(header.filter == static_cast<uint8_t>(Filter::Delta) ? std::min<size_t>(header.blockSize, outSize) : 0);
+
+    for (uint32_t b = 0; b < header.blockCount; b++) {
+        uint32_t stored;
+        std::memcpy(&stored, sizes + b * sizeof(uint32_t), sizeof(stored));
+        const size_t n = stored & ~STORED_BIT;
+        const size_t raw = std::min<size_t>(header.blockSize, outSize - size_t(b) * header.blockSize);
+        uint8_t* target = dst + size_t(b) * header.blockSize;
+        if (n > static_cast<size_t>(end - block)) return false;
+        if (stored & STORED_BIT) {
+            if (n != raw) return false;
+            std::memcpy(target, block, n);
+        } else if (filtered.empty()) {
+            if (!lzDecompress(block, n, target, raw)) return false;
+        } else {
+            if (!lzDecompress(block, n, filtered.data(), raw)) return false;
+            deltaUnfilter(filtered.data(), raw, header.stride, target);
+        }
+        block += n;
+    }
+    return true;
+}
+
+} // namespace compression
+} // namespace myth
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class JobSystem;
+
+namespace myth {
+
+// In-tree LZ block compression for save sections and cached chunks. Data
+// is cut into BLOCK_SIZE blocks compressed independently, so compression
+// spreads over JobSystem workers, while decompression is a single fast
+// pass. A stream is self-describing:
+//
+//   StreamHeader, blockCount uint32 block sizes, then the blocks
+//
+// A block size with STORED_BIT set is a block kept as it was, because
+// compressing did not make it smaller. Blocks use an LZ77 byte format in
+// the style of LZ4: a token of literal and match lengths, the literals,
+// then a 16-bit match offset, with lengths of 15 or more continued in
+// bytes of 255.
+namespace compression {
+
+enum class Filter : uint8_t {
+    None,
+    // For arrays of records made of 4-byte fields, e.g. float columns:
+    // each field minus the same field one record (`stride` bytes) earlier,
+    // then the bytes split into four planes. Slowly varying values turn
+    // into long runs of zero high bytes, which is what LZ is good at.
+    Delta,
+};
+
+constexpr uint32_t BLOCK_SIZE = 256 << 10;
+constexpr uint32_t STORED_BIT = 1u << 31;
+// Most bytes one byte of a stream can decode to: a 255 continuing a match length
+constexpr uint64_t MAX_EXPANSION = 255;
+
+struct StreamHeader {
+    uint64_t rawSize;
+    uint32_t blockSize; // raw bytes in every block but the last
+    uint32_t blockCount;
+    uint32_t stride;    // record size the filter worked with
+    uint8_t filter;
+    uint8_t reserved[3];
+};
+static_assert(sizeof(StreamHeader) == 24);
+
+// Most bytes compress() can produce for `size` input bytes
+size_t compressBound(size_t size);
+
+// Compress `size` bytes into `out`, which has room for compressBound(size),
+// and return the stream's size. With `jobs` the blocks are shared between
+// the calling thread and the workers; safe to call from a worker. Filter
+// Delta needs `stride` to be a multiple of 4 up to BLOCK_SIZE, and falls
+// back to None otherwise.
+size_t compress(const void* data, size_t size, void* out, Filter filter = Filter::None, uint32_t stride = 4,
+                JobSystem* jobs = nullptr);
+
+// Decoded size of a stream; false if it is not a whole stream. A size no
+// `size` stream bytes could decode to is refused here, so callers may
+// allocate what this returns.
+bool decompressedSize(const void* stream, size_t size, uint64_t& rawSize);
+
+// Decode a whole stream into `out`, which holds exactly the decoded size.
+// False on any malformed or truncated input; never reads or writes out of
+// bounds.
+bool decompress(const void* stream, size_t size, void* out, size_t outSize);
+
+} // namespace compression
+} // namespace myth
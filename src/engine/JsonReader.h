@@ -0,0 +1,190 @@
+﻿#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+namespace myth {
+
+// Single-pass pull parser over JSON text. Never allocates or copies:
+// keys and strings come back as views of the source with escapes left as
+// written, and numbers go straight through std::from_chars. The caller
+// walks the document in order, e.g.
+//
+//   if (!json.beginObject()) return false;
+//   std::string_view key;
+//   while (json.nextKey(key)) {
+//       if (key == "count") json.read(count);
+//       else json.skipValue();
+//   }
+//   return json.ok();
+//
+// The first malformed token puts the reader in an error state in which
+// every call fails, so checking ok() once at the end is enough.
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view text) : m_text(text) {}
+
+    bool ok() const { return !m_failed; }
+    // Offset of the next unread character, for error messages
+    size_t position() const { return m_pos; }
+
+    // Enter the object or array the reader is on
+    bool beginObject() { return open('{'); }
+    bool beginArray() { return open('['); }
+
+    // The next member's key, leaving the reader on its value. False (and
+    // past the '}') once the object ends.
+    bool nextKey(std::string_view& key) {
+        if (!nextMember('}')) return false;
+        if (!scanString(key)) return false;
+        skipWhitespace();
+        return expect(':');
+    }
+
+    // True if another element follows, leaving the reader on it. False
+    // (and past the ']') once the array ends.
+    bool nextElement() { return nextMember(']'); }
+
+    bool read(float& value) { return readNumber(value); }
+    bool read(double& value) { return readNumber(value); }
+    bool read(int& value) { return readNumber(value); }
+    bool read(std::string_view& value) {
+        skipWhitespace();
+        return scanString(value);
+    }
+    bool read(bool& value) {
+        skipWhitespace();
+        if (literal("true")) value = true;
+        else if (literal("false")) value = false;
+        else return fail();
+        return true;
+    }
+
+    // Step over the value the reader is on, however deeply nested
+    bool skipValue() {
+        skipWhitespace();
+        if (m_failed || m_pos >= m_text.size()) return fail();
+        const char c = m_text[m_pos];
+        if (c == '"') {
+            std::string_view ignored;
+            return scanString(ignored);
+        }
+        if (c != '{' && c != '[') {
+            // Number or literal: runs to the next delimiter
+            const size_t start = m_pos;
+            while (m_pos < m_text.size() && !isDelimiter(m_text[m_pos])) m_pos++;
+            return m_pos > start || fail();
+        }
+
+        size_t depth = 0;
+        while (m_pos < m_text.size()) {
+            const char d = m_text[m_pos];
+            if (d == '"') {
+                std::string_view ignored;
+                if (!scanString(ignored)) return false;
+                continue;
+            }
+            m_pos++;
+            if (d == '{' || d == '[') depth++;
+            else if ((d == '}' || d == ']') && --depth == 0) return true;
+        }
+        return fail();
+    }
+
+private:
+    static bool isWhitespace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+    static bool isDelimiter(char c) { return c == ',' || c == '}' || c == ']' || isWhitespace(c); }
+
+    void skipWhitespace() {
+        while (m_pos < m_text.size() && isWhitespace(m_text[m_pos])) m_pos++;
+    }
+
+    bool fail() {
+        m_failed = true;
+        return false;
+    }
+
+    bool expect(char c) {
+        if (m_failed || m_pos >= m_text.size() || m_text[m_pos] != c) return fail();
+        m_pos++;
+        return true;
+    }
+
+    bool literal(std::string_view word) {
+        if (m_failed || m_text.substr(m_pos, word.size()) != word) return false;
+        m_pos += word.size();
+        return true;
+    }
+
+    bool open(char c) {
+        skipWhitespace();
+        if (!expect(c)) return false;
+        m_first = true;
+        return true;
+    }
+
+    // Shared by objects and arrays: consume the closing bracket or the
+    // comma before every member but the first
+    bool nextMember(char close) {
+        if (m_failed) return false;
+        skipWhitespace();
+        if (m_pos < m_text.size() && m_text[m_pos] == close) {
+            m_pos++;
+            m_first = false; // the container just closed was a member of the enclosing one
+            return false;
+        }
+        if (!m_first) {
+            if (!expect(',')) return false;
+            skipWhitespace();
+        }
+        m_first = false;
+        return m_pos < m_text.size() || fail();
+    }
+
+    bool scanString(std::string_view& out) {
+        if (!expect('"')) return false;
+        const size_t start = m_pos;
+        while (m_pos < m_text.size()) {
+            const char c = m_text[m_pos];
+            if (c == '"') {
+                out = m_text.substr(start, m_pos - start);
+                m_pos++;
+                return true;
+            }
+            m_pos += c == '\\' ? 2 : 1;
+        }
+        return fail();
+    }
+
+    template<typename T>
+    bool readNumber(T& value) {
+        skipWhitespace();
+        if (m_failed) return false;
+        const char* begin = m_text.data() + m_pos;
+        const char* end = m_text.data() + m_text.size();
+        auto [ptr, error] = std::from_chars(begin, end, value);
+        if constexpr (std::is_integral_v<T>) {
+            // Accept integers written as 3.0 or 1e3, as text editors and other writers do
+            if (error == std::errc() && ptr < end && !isDelimiter(*ptr)) {
+                double wide;
+                auto [widePtr, wideError] = std::from_chars(begin, end, wide);
+                ptr = widePtr;
+                error = wideError;
+                value = static_cast<T>(wide);
+            }
+        }
+        if (error != std::errc() || (ptr < end && !isDelimiter(*ptr))) return fail();
+        m_pos += static_cast<size_t>(ptr - begin);
+        return true;
+    }
+
+    std::string_view m_text;
+    size_t m_pos = 0;
+    bool m_first = false; // inside a container that has had no member yet
+    bool m_failed = false;
+};
+
+} // namespace myth
@@ -1,55 +1,239 @@
 ﻿#include "Logger.h"
-#include <iostream>
-#include <chrono>
-#include <iomanip>
-#include <sstream>
+#include <algorithm>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
 namespace myth {
+namespace logging {
 
-void Logger::log(LogLevel level, const std::string& message, const std::source_location& loc) {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-    
-    std::tm tm_buf;
-#ifdef _WIN32
-    localtime_s(&tm_buf, &time);
-#else
-    localtime_r(&time, &tm_buf);
-#endif
+namespace {
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug:   return "DEBUG";
+        case LogLevel::Info:    return "INFO";
+        case LogLevel::Warning: return "WARN";
+        case LogLevel::Error:   return "ERROR";
+        case LogLevel::Fatal:   return "FATAL";
+    }
+    return "UNKNOWN";
+}
 
-    std::ostringstream timestamp;
-    timestamp << std::put_time(&tm_buf, "%H:%M:%S") << "." << std::setfill('0') << std::setw(3) << ms.count();
-    
-    const char* levelStr = "UNKNOWN";
-    int color = 7;
-    
+[[maybe_unused]] int levelColor(LogLevel level) {
     switch (level) {
-        case LogLevel::Debug:   levelStr = "DEBUG"; color = 8; break;
-        case LogLevel::Info:    levelStr = "INFO";  color = 10; break;
-        case LogLevel::Warning: levelStr = "WARN";  color = 14; break;
-        case LogLevel::Error:   levelStr = "ERROR"; color = 12; break;
-        case LogLevel::Fatal:   levelStr = "FATAL"; color = 12; break;
+        case LogLevel::Debug:   return 8;
+        case LogLevel::Info:    return 10;
+        case LogLevel::Warning: return 14;
+        case LogLevel::Error:   return 12;
+        case LogLevel::Fatal:   return 12;
+    }
+    return 7;
+}
+
+// Owns the rings and the thread that empties them every few milliseconds.
+// Whoever drains (that thread, flush(), or a producer blocked on a full
+// ring) holds m_drainMutex, so each ring keeps a single consumer.
+class Backend {
+public:
+    static Backend& instance() {
+        static Backend backend;
+        return backend;
+    }
+
+    Ring& acquire() {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        for (auto& ring : m_rings) {
+            bool free = false;
+            if (ring->inUse.compare_exchange_strong(free, true, std::memory_order_acq_rel)) return *ring;
+        }
+        m_rings.push_back(std::make_unique<Ring>());
+        m_rings.back()->inUse.store(true, std::memory_order_relaxed);
+        return *m_rings.back();
+    }
+
+    void drain() {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        drainLocked();
+    }
+
+    void setOutput(std::FILE* file) {
+        std::lock_guard<std::mutex> lock(m_drainMutex);
+        drainLocked();
+        m_output = file;
+    }
+
+    std::atomic<LogOverflow> overflow{LogOverflow::Drop};
+
+private:
+    struct Pending {
+        const Record* record;
+        uint32_t ring;
+    };
+
+    Backend() : m_thread([this] { run(); }) {}
+
+    ~Backend() {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+        drain();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        while (!m_stop) {
+            m_wake.wait_for(lock, std::chrono::milliseconds(5));
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    void drainLocked() {
+        // Rings are only ever added, so the ones seen here stay valid
+        std::vector<Ring*> rings;
+        {
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            for (auto& ring : m_rings) rings.push_back(ring.get());
+        }
+
+        m_pending.clear();
+        m_tails.resize(rings.size());
+        uint64_t dropped = 0;
+        for (uint32_t i = 0; i < rings.size(); i++) {
+            m_tails[i] = rings[i]->read([&](const Record& record) { m_pending.push_back({&record, i}); });
+            dropped += rings[i]->dropped.exchange(0, std::memory_order_relaxed);
+        }
+        std::stable_sort(m_pending.begin(), m_pending.end(),
+                         [](const Pending& a, const Pending& b) { return a.record->time < b.record->time; });
+
+        m_batch.clear();
+        for (const Pending& p : m_pending) {
+            const Record& r = *p.record;
+            appendPrefix(r.time, r.level);
+            r.format(m_batch, std::string_view(r.fmt, r.fmtSize), reinterpret_cast<const uint8_t*>(&r + 1));
+            m_batch += '\n';
+            writeLine(r.level);
+        }
+        for (uint32_t i = 0; i < rings.size(); i++) rings[i]->release(m_tails[i]);
+        if (dropped > 0) {
+            const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            appendPrefix(now, LogLevel::Warning);
+            m_batch += "Logger: " + std::to_string(dropped) + " records dropped, their thread's ring was full\n";
+            writeLine(LogLevel::Warning);
+        }
+        writeBatch();
     }
-    
-    std::string filename = loc.file_name();
-    auto pos = filename.find_last_of("/\\");
-    if (pos != std::string::npos) filename = filename.substr(pos + 1);
 
+    // "[HH:MM:SS.mmm] [LEVEL] ", the local time worked out once a second
+    void appendPrefix(int64_t time, LogLevel level) {
+        const int64_t seconds = time / 1000000000;
+        if (seconds != m_cachedSecond) {
+            const std::time_t t = static_cast<std::time_t>(seconds);
+            std::tm tm_buf;
 #ifdef _WIN32
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    SetConsoleTextAttribute(hConsole, color);
+            localtime_s(&tm_buf, &t);
+#else
+            localtime_r(&t, &tm_buf);
 #endif
-
-    std::cout << "[" << timestamp.str() << "] [" << levelStr << "] " << message << std::endl;
+            std::strftime(m_cachedTime, sizeof(m_cachedTime), "%H:%M:%S", &tm_buf);
+            m_cachedSecond = seconds;
+        }
+        char prefix[48];
+        const int length = std::snprintf(prefix, sizeof(prefix), "[%s.%03d] [%s] ", m_cachedTime,
+                                         static_cast<int>(time / 1000000 % 1000), levelName(level));
+        m_batch.append(prefix, static_cast<size_t>(length));
+    }
 
 #ifdef _WIN32
-    SetConsoleTextAttribute(hConsole, 7);
+    // The console colour applies to what is written after it is set, so on
+    // Windows each line goes out on its own
+    void writeLine(LogLevel level) {
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        SetConsoleTextAttribute(hConsole, levelColor(level));
+        writeBatch();
+        SetConsoleTextAttribute(hConsole, 7);
+        m_batch.clear();
+    }
+#else
+    void writeLine(LogLevel) {}
 #endif
+
+    void writeBatch() {
+        if (m_batch.empty()) return;
+        std::fwrite(m_batch.data(), 1, m_batch.size(), m_output);
+        std::fflush(m_output);
+    }
+
+    std::mutex m_ringsMutex;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+
+    std::mutex m_drainMutex;
+    std::vector<Pending> m_pending;
+    std::vector<uint64_t> m_tails;
+    std::string m_batch;
+    std::FILE* m_output = stdout;
+    int64_t m_cachedSecond = -1;
+    char m_cachedTime[16] = {};
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+} // namespace
+
+RingLease::~RingLease() {
+    if (ring) ring->inUse.store(false, std::memory_order_release);
+}
+
+Ring& acquireRing(RingLease& lease) {
+    lease.ring = &Backend::instance().acquire();
+    return *lease.ring;
+}
+
+uint8_t* reserveSlow(Ring& ring, size_t size, LogLevel level) {
+    Backend& backend = Backend::instance();
+    if (level < LogLevel::Warning && backend.overflow.load(std::memory_order_relaxed) == LogOverflow::Drop) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    // Only this thread fills the ring, so it has room once drained
+    backend.drain();
+    return ring.tryReserve(size);
+}
+
+} // namespace logging
+
+void Logger::log(LogLevel level, std::string_view message) {
+    if (!logEnabled(level)) return;
+    constexpr size_t MAX_MESSAGE = logging::Ring::MAX_RECORD - sizeof(logging::Record) - sizeof(uint32_t) - 8;
+    write(level, "{}", message.substr(0, MAX_MESSAGE));
+}
+
+void Logger::flush() {
+    logging::Backend::instance().drain();
+}
+
+void Logger::setOverflow(LogOverflow policy) {
+    logging::Backend::instance().overflow.store(policy, std::memory_order_relaxed);
+}
+
+void Logger::setOutput(std::FILE* file) {
+    logging::Backend::instance().setOutput(file);
 }
 
 } // namespace myth
@@ -1,43 +1,327 @@
 ﻿#pragma once
 
-#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <format>
-#include <source_location>
+#include <iterator>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 
 namespace myth {
 
 enum class LogLevel { Debug, Info, Warning, Error, Fatal };
 
+// Lowest level compiled in, as a LogLevel number; calls below it made
+// through the MYTH_LOG macros vanish along with their arguments. Fatal is
+// always kept. Set by CMake's MYTH_LOG_LEVEL, else Info in NDEBUG builds
+// and Debug otherwise.
+#ifndef MYTH_LOG_LEVEL
+#ifdef NDEBUG
+#define MYTH_LOG_LEVEL 1
+#else
+#define MYTH_LOG_LEVEL 0
+#endif
+#endif
+
+constexpr bool logEnabled(LogLevel level) {
+    return level == LogLevel::Fatal || static_cast<int>(level) >= MYTH_LOG_LEVEL;
+}
+
+// What a log call does when its thread's ring is full
+enum class LogOverflow {
+    Drop,  // Debug and Info records are counted and lost; Warning and up block
+    Block, // every record waits, the calling thread draining the rings itself
+};
+
+// Log calls only copy their arguments into a ring owned by the calling
+// thread; a background thread turns the records into text and writes them
+// in batches, oldest first across threads. A record is a timestamp, the
+// level, the format string (a literal, so only its address is kept), the
+// function that formats it and its arguments: strings by value, anything
+// else trivially copyable as its bytes.
+namespace logging {
+
+using FormatFn = void (*)(std::string& out, std::string_view fmt, const uint8_t* args);
+
+struct Record {
+    int64_t time;    // system_clock nanoseconds
+    FormatFn format; // nullptr marks padding up to the end of the ring
+    const char* fmt;
+    uint32_t fmtSize;
+    uint32_t size;   // bytes taken, this header and the arguments
+    LogLevel level;
+};
+
+template<typename T>
+struct Arg {
+    static_assert(std::is_trivially_copyable_v<T>, "log arguments are strings or trivially copyable values");
+    using Stored = T;
+    static size_t size(const T&) { return sizeof(T); }
+    static uint8_t* pack(uint8_t* out, const T& value) {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    }
+    static T unpack(const uint8_t*& in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+};
+
+struct StringArg {
+    using Stored = std::string_view;
+    static std::string_view view(std::string_view s) { return s; }
+    static std::string_view view(const char* s) { return s ? std::string_view(s) : std::string_view("(null)"); }
+    template<typename S>
+    static size_t size(const S& s) { return sizeof(uint32_t) + view(s).size(); }
+    template<typename S>
+    static uint8_t* pack(uint8_t* out, const S& s) {
+        const std::string_view text = view(s);
+        const uint32_t length = static_cast<uint32_t>(text.size());
+        std::memcpy(out, &length, sizeof(length));
+        std::memcpy(out + sizeof(length), text.data(), length);
+        return out + sizeof(length) + length;
+    }
+    static std::string_view unpack(const uint8_t*& in) {
+        uint32_t length;
+        std::memcpy(&length, in, sizeof(length));
+        const std::string_view text(reinterpret_cast<const char*>(in + sizeof(length)), length);
+        in += sizeof(length) + length;
+        return text;
+    }
+};
+
+template<> struct Arg<std::string> : StringArg {};
+template<> struct Arg<std::string_view> : StringArg {};
+template<> struct Arg<const char*> : StringArg {};
+template<> struct Arg<char*> : StringArg {};
+
+template<typename... Ts>
+void formatRecord(std::string& out, std::string_view fmt, const uint8_t* args) {
+    // Braced initialization unpacks the arguments left to right
+    std::tuple<typename Arg<Ts>::Stored...> values{Arg<Ts>::unpack(args)...};
+    std::apply([&](auto&... v) { std::vformat_to(std::back_inserter(out), fmt, std::make_format_args(v...)); }, values);
+}
+
+// Single-producer, single-consumer byte ring. Records are contiguous and
+// a multiple of 8 bytes; one that would straddle the end starts over at
+// the beginning, with a padding mark (or too little room for one) left
+// behind. Head and tail count bytes ever written and released.
+class Ring {
+public:
+    static constexpr size_t CAPACITY = 64 << 10;
+    static constexpr size_t MAX_RECORD = CAPACITY / 8;
+
+    // Producer: room for `size` bytes, committed by commit(), or nullptr
+    // while the consumer has not caught up
+    uint8_t* tryReserve(size_t size);
+    void commit() { m_head.store(m_reserved, std::memory_order_release); }
+
+    // Consumer: func(record) for every committed record, oldest first.
+    // Returns the position after them, to release() once they are used.
+    template<typename Func>
+    uint64_t read(Func&& func) const;
+    void release(uint64_t tail) { m_tail.store(tail, std::memory_order_release); }
+
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> inUse{false}; // a thread is producing into it
+
+private:
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    uint64_t m_reserved = 0;   // producer's head once the pending record is committed
+    uint64_t m_cachedTail = 0; // producer's last look at m_tail
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+    alignas(64) uint8_t m_buffer[CAPACITY];
+};
+
+inline uint8_t* Ring::tryReserve(size_t size) {
+    const uint64_t head = m_head.load(std::memory_order_relaxed);
+    const size_t offset = head & (CAPACITY - 1);
+    const size_t skip = offset + size > CAPACITY ? CAPACITY - offset : 0;
+    if (head + skip + size - m_cachedTail > CAPACITY) {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        if (head + skip + size - m_cachedTail > CAPACITY) return nullptr;
+    }
+    if (skip >= sizeof(Record)) new (m_buffer + offset) Record{0, nullptr, nullptr, 0, 0, LogLevel::Debug};
+    m_reserved = head + skip + size;
+    return m_buffer + (skip ? 0 : offset);
+}
+
+template<typename Func>
+uint64_t Ring::read(Func&& func) const {
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    while (tail < head) {
+        const size_t offset = tail & (CAPACITY - 1);
+        const Record* record = reinterpret_cast<const Record*>(m_buffer + offset);
+        if (CAPACITY - offset < sizeof(Record) || record->format == nullptr) {
+            tail += CAPACITY - offset;
+            continue;
+        }
+        func(*record);
+        tail += record->size;
+    }
+    return tail;
+}
+
+// The calling thread's claim on a ring, given back when the thread exits
+// so the next new thread reuses it
+struct RingLease {
+    Ring* ring = nullptr;
+    ~RingLease();
+};
+
+inline thread_local RingLease t_lease;
+
+Ring& acquireRing(RingLease& lease);
+// A full ring: apply the overflow policy; nullptr if the record is dropped
+uint8_t* reserveSlow(Ring& ring, size_t size, LogLevel level);
+
+inline Ring& threadRing() { return t_lease.ring ? *t_lease.ring : acquireRing(t_lease); }
+
+// Per-site state behind MYTH_EVERY_MS, a constant-initialized static, so
+// a site costs no guard or allocation. Lets one call through per interval,
+// whichever thread makes it; calls in between only read the clock and a
+// shared word that seldom changes.
+class RateLimit {
+public:
+    bool allow(int64_t intervalMs) {
+        const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t next = m_next.load(std::memory_order_relaxed);
+        return now >= next && m_next.compare_exchange_strong(next, now + intervalMs, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> m_next{0};
+};
+
+// True for the first of every `n` calls counted in `count`; sites keep a
+// count per thread so loops on different workers share no cache line
+inline bool sample(uint32_t& count, uint32_t n) {
+    const bool pass = count == 0;
+    count = count + 1 >= n ? 0 : count + 1;
+    return pass;
+}
+
+} // namespace logging
+
+// The *f helpers and the plain ones check logEnabled() too, but arguments
+// passed to them are still worked out; the MYTH_LOG macros below skip that
+// as well, and are the ones to use in hot code.
 class Logger {
 public:
-    static void log(LogLevel level, const std::string& message, 
-                    const std::source_location& loc = std::source_location::current());
-    
+    // The message is copied as it is, cut short if it would not fit a record
+    static void log(LogLevel level, std::string_view message);
+
+    template<typename... Args>
+    static void logf(LogLevel level, std::format_string<Args...> fmt, Args&&... args) {
+        if (logEnabled(level)) write(level, fmt.get(), args...);
+    }
+
     template<typename... Args>
     static void debugf(std::format_string<Args...> fmt, Args&&... args) {
-        log(LogLevel::Debug, std::format(fmt, std::forward<Args>(args)...));
+        if constexpr (logEnabled(LogLevel::Debug)) write(LogLevel::Debug, fmt.get(), args...);
     }
-    
+
     template<typename... Args>
     static void infof(std::format_string<Args...> fmt, Args&&... args) {
-        log(LogLevel::Info, std::format(fmt, std::forward<Args>(args)...));
+        if constexpr (logEnabled(LogLevel::Info)) write(LogLevel::Info, fmt.get(), args...);
     }
-    
+
     template<typename... Args>
     static void warnf(std::format_string<Args...> fmt, Args&&... args) {
-        log(LogLevel::Warning, std::format(fmt, std::forward<Args>(args)...));
+        if constexpr (logEnabled(LogLevel::Warning)) write(LogLevel::Warning, fmt.get(), args...);
     }
-    
+
     template<typename... Args>
     static void errorf(std::format_string<Args...> fmt, Args&&... args) {
-        log(LogLevel::Error, std::format(fmt, std::forward<Args>(args)...));
+        if constexpr (logEnabled(LogLevel::Error)) write(LogLevel::Error, fmt.get(), args...);
     }
 
     static void debug(const std::string& msg) { log(LogLevel::Debug, msg); }
     static void info(const std::string& msg) { log(LogLevel::Info, msg); }
     static void warn(const std::string& msg) { log(LogLevel::Warning, msg); }
     static void error(const std::string& msg) { log(LogLevel::Error, msg); }
+    // Written out before this returns, along with everything logged earlier
     static void fatal(const std::string& msg) { log(LogLevel::Fatal, msg); }
+
+    // Write out everything logged so far, on the calling thread
+    static void flush();
+
+    static void setOverflow(LogOverflow policy);
+    // stdout by default; the caller keeps `file` open while it is in use
+    static void setOutput(std::FILE* file);
+
+private:
+    template<typename... Args>
+    static void write(LogLevel level, std::string_view fmt, const Args&... args);
 };
 
+template<typename... Args>
+void Logger::write(LogLevel level, std::string_view fmt, const Args&... args) {
+    using namespace logging;
+    const size_t size = (sizeof(Record) + (Arg<std::decay_t<Args>>::size(args) + ... + 0) + 7) & ~size_t(7);
+    if (size > Ring::MAX_RECORD) {
+        log(level, std::vformat(fmt, std::make_format_args(args...)));
+        return;
+    }
+
+    Ring& ring = threadRing();
+    uint8_t* out = ring.tryReserve(size);
+    if (!out && !(out = reserveSlow(ring, size, level))) return;
+    const int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    new (out) Record{time, &formatRecord<std::decay_t<Args>...>, fmt.data(), static_cast<uint32_t>(fmt.size()),
+                     static_cast<uint32_t>(size), level};
+    uint8_t* cursor = out + sizeof(Record);
+    ((cursor = Arg<std::decay_t<Args>>::pack(cursor, args)), ...);
+    ring.commit();
+    if (level == LogLevel::Fatal) flush();
+}
+
 } // namespace myth
+
+// MYTH_LOG(Info, "x = {}", x): nothing at all, not even `x`, unless Info
+// is compiled in. The level is a LogLevel enumerator name.
+#define MYTH_LOG(level, ...) MYTH_LOG_IF(level, true, __VA_ARGS__)
+#define MYTH_LOG_DEBUG(...) MYTH_LOG(Debug, __VA_ARGS__)
+#define MYTH_LOG_INFO(...) MYTH_LOG(Info, __VA_ARGS__)
+#define MYTH_LOG_WARN(...) MYTH_LOG(Warning, __VA_ARGS__)
+#define MYTH_LOG_ERROR(...) MYTH_LOG(Error, __VA_ARGS__)
+
+// As MYTH_LOG, only when `condition` holds; it is not evaluated when the
+// level is compiled out
+#define MYTH_LOG_IF(level, condition, ...)                                                         \
+    do {                                                                                           \
+        if constexpr (::myth::logEnabled(::myth::LogLevel::level)) {                               \
+            if (condition) ::myth::Logger::logf(::myth::LogLevel::level, __VA_ARGS__);             \
+        }                                                                                          \
+    } while (0)
+
+// True at most once every `ms` milliseconds at this spot in the source.
+// Every expansion has its own state.
+#define MYTH_EVERY_MS(ms)                                                                          \
+    ([]() -> bool {                                                                                \
+        static ::myth::logging::RateLimit site;                                                    \
+        return site.allow(ms);                                                                     \
+    }())
+
+// True on the first of every `n` passes through this spot on each thread.
+// Every expansion has its own count.
+#define MYTH_EVERY_N(n)                                                                            \
+    ([]() -> bool {                                                                                \
+        static thread_local uint32_t count = 0;                                                    \
+        return ::myth::logging::sample(count, n);                                                  \
+    }())
+
+// Rate-limited and sampled logging, cheap enough for per-entity loops
+#define MYTH_LOG_EVERY_MS(level, ms, ...) MYTH_LOG_IF(level, MYTH_EVERY_MS(ms), __VA_ARGS__)
+#define MYTH_LOG_EVERY_N(level, n, ...) MYTH_LOG_IF(level, MYTH_EVERY_N(n), __VA_ARGS__)
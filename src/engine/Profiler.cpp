@@ -0,0 +1,202 @@
+﻿#include "Profiler.h"
+#include "Logger.h"
+
+#ifdef MYTH_PROFILE
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace myth {
+
+#ifdef MYTH_PROFILE
+
+namespace profiler {
+
+namespace {
+
+// Buffers are never freed, so a trace can include threads that have
+// exited; a thread starting up takes over one whose zones are from an
+// earlier capture, which its writer has already dealt with
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+// Touched by the controlling thread only
+struct Capture {
+    std::string path;
+    uint32_t framesLeft = 0; // 0: until stopCapture()
+    int64_t start = 0;       // now() ticks
+    std::chrono::steady_clock::time_point startTime;
+    double microsPerTick = 0.0;
+    std::vector<int64_t> frames;
+};
+
+Capture g_state;
+
+void copyName(char (&to)[32], const char* from) {
+    const size_t length = std::min(std::strlen(from), sizeof(to) - 1);
+    std::memcpy(to, from, length);
+    to[length] = '\0';
+}
+
+// Names are literals from the source, but quote anything JSON would choke on
+void writeString(std::FILE* file, const char* s) {
+    std::fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') std::fputc('\\', file);
+        if (static_cast<unsigned char>(*s) >= 0x20) std::fputc(*s, file);
+    }
+    std::fputc('"', file);
+}
+
+bool writeTrace(const Capture& capture, uint32_t id) {
+    const std::filesystem::path path(capture.path);
+    std::error_code error;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), error);
+    std::FILE* file = std::fopen(capture.path.c_str(), "wb");
+    if (!file) return false;
+
+    auto micros = [&](int64_t t) { return static_cast<double>(t - capture.start) * capture.microsPerTick; };
+    size_t zones = 0, threads = 0;
+    uint64_t dropped = 0;
+    bool first = true;
+    auto separate = [&] {
+        std::fputs(first ? "\n" : ",\n", file);
+        first = false;
+    };
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        for (const auto& buffer : registry().buffers) {
+            if (buffer->capture != id) continue;
+            const uint32_t count = buffer->count.load(std::memory_order_acquire);
+            threads++;
+            dropped += buffer->dropped;
+            separate();
+            std::fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", buffer->threadId);
+            if (buffer->name[0]) writeString(file, buffer->name);
+            else std::fprintf(file, "\"Thread %u\"", buffer->threadId);
+            std::fputs("}}", file);
+            for (uint32_t i = 0; i < count; i++) {
+                const ZoneEvent& e = buffer->events[i];
+                if (e.start < capture.start) continue; // began before this capture did
+                separate();
+                std::fputs("{\"ph\":\"X\",\"name\":", file);
+                writeString(file, e.name);
+                std::fprintf(file, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->threadId, micros(e.start),
+                             static_cast<double>(e.end - e.start) * capture.microsPerTick);
+                zones++;
+            }
+        }
+    }
+    for (size_t i = 0; i < capture.frames.size(); i++) {
+        separate();
+        std::fprintf(file, "{\"ph\":\"i\",\"s\":\"g\",\"name\":\"Frame %zu\",\"pid\":1,\"tid\":0,\"ts\":%.3f}", i,
+                     micros(capture.frames[i]));
+    }
+    std::fputs("\n]}\n", file);
+    const bool ok = std::fflush(file) == 0 && !std::ferror(file);
+    std::fclose(file);
+
+    if (ok) Logger::infof("Profiler: wrote {} zones on {} threads over {} frames to {}", zones, threads, capture.frames.size(), capture.path);
+    if (dropped > 0) Logger::warnf("Profiler: {} zones dropped, a thread's buffer was full", dropped);
+    return ok;
+}
+
+} // namespace
+
+ThreadLease::~ThreadLease() {
+    if (buffer) buffer->inUse.store(false, std::memory_order_release);
+}
+
+ThreadBuffer& beginCapture(ThreadLease& lease, uint32_t capture) {
+    if (!lease.buffer) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& buffer : r.buffers) {
+            bool free = false;
+            if (buffer->capture != capture && buffer->inUse.compare_exchange_strong(free, true, std::memory_order_acq_rel)) {
+                lease.buffer = buffer.get();
+                break;
+            }
+        }
+        if (!lease.buffer) {
+            r.buffers.push_back(std::make_unique<ThreadBuffer>());
+            lease.buffer = r.buffers.back().get();
+            lease.buffer->threadId = static_cast<uint32_t>(r.buffers.size());
+            lease.buffer->inUse.store(true, std::memory_order_relaxed);
+        }
+        copyName(lease.buffer->name, lease.name);
+    }
+    ThreadBuffer& buffer = *lease.buffer;
+    buffer.count.store(0, std::memory_order_relaxed);
+    buffer.dropped = 0;
+    buffer.capture = capture;
+    return buffer;
+}
+
+} // namespace profiler
+
+void Profiler::startCapture(const std::string& path, uint32_t frames) {
+    using namespace profiler;
+    if (g_capturing.load()) stopCapture();
+    g_state = {path, frames, now(), std::chrono::steady_clock::now(), 0.0, {}};
+    g_capture.fetch_add(1);
+    g_capturing.store(true);
+    Logger::infof("Profiler: capturing {} to {}", frames ? std::to_string(frames) + " frames" : std::string("until stopped"), path);
+}
+
+bool Profiler::stopCapture() {
+    using namespace profiler;
+    if (!g_capturing.exchange(false)) return false;
+    const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_state.startTime).count();
+    const int64_t ticks = now() - g_state.start;
+    g_state.microsPerTick = ticks > 0 ? micros / static_cast<double>(ticks) : 0.0;
+    const bool ok = writeTrace(g_state, g_capture.load());
+    if (!ok) Logger::errorf("Profiler: could not write {}", g_state.path);
+    return ok;
+}
+
+bool Profiler::capturing() {
+    return profiler::g_capturing.load(std::memory_order_relaxed);
+}
+
+void Profiler::frame() {
+    using namespace profiler;
+    if (!g_capturing.load(std::memory_order_relaxed)) return;
+    g_state.frames.push_back(now());
+    if (g_state.framesLeft > 0 && --g_state.framesLeft == 0) stopCapture();
+}
+
+void Profiler::setThreadName(const char* name) {
+    using namespace profiler;
+    copyName(t_lease.name, name);
+    if (t_lease.buffer) copyName(t_lease.buffer->name, name);
+}
+
+#else
+
+void Profiler::startCapture(const std::string& path, uint32_t) {
+    Logger::warnf("Profiler: not built in (configure with MYTH_PROFILE=ON); {} not captured", path);
+}
+
+bool Profiler::stopCapture() { return false; }
+bool Profiler::capturing() { return false; }
+void Profiler::frame() {}
+void Profiler::setThreadName(const char*) {}
+
+#endif
+
+} // namespace myth
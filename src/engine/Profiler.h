@@ -0,0 +1,145 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#ifdef MYTH_PROFILE
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define MYTH_PROFILE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MYTH_PROFILE_TSC 1
+#endif
+#endif
+
+namespace myth {
+
+// CPU profiler. While a capture runs, every MYTH_PROFILE_ZONE records its
+// name, start and end into a buffer owned by the calling thread; when the
+// capture ends the buffers are written out as Chrome trace JSON, to open
+// in chrome://tracing or ui.perfetto.dev, with MYTH_PROFILE_FRAME markers
+// as instant events. Outside a capture a zone costs one relaxed load.
+//
+// The macros compile to nothing unless MYTH_PROFILE is defined (the CMake
+// option of that name); the capture calls then only log that profiling is
+// not built in. Captures are started, ended and framed from one thread,
+// normally the main loop's.
+class Profiler {
+public:
+    // Record zones from now on. With `frames`, the capture ends by itself
+    // after that many frame() markers and is written to `path`.
+    static void startCapture(const std::string& path, uint32_t frames = 0);
+    // End the capture and write it out; false if none was running or the
+    // file could not be written
+    static bool stopCapture();
+    static bool capturing();
+
+    static void frame();
+    // Shown for the calling thread in traces; copied, cut to 31 characters
+    static void setThreadName(const char* name);
+};
+
+#ifdef MYTH_PROFILE
+
+namespace profiler {
+
+struct ZoneEvent {
+    const char* name; // a literal, so only its address is kept
+    int64_t start;    // now() ticks
+    int64_t end;
+};
+
+// One thread's zones for one capture: only the owning thread appends, and
+// the capture's writer reads up to `count` once it has ended
+struct ThreadBuffer {
+    static constexpr uint32_t CAPACITY = 1 << 16;
+
+    ZoneEvent events[CAPACITY];
+    std::atomic<uint32_t> count{0};
+    uint32_t dropped = 0;
+    uint32_t capture = 0;           // g_capture when it was last reset
+    uint32_t threadId = 0;          // tid in the trace
+    char name[32] = {};
+    std::atomic<bool> inUse{false}; // a thread is recording into it
+};
+
+// Where the calling thread records; given back when the thread exits. The
+// name waits here until the thread first records something.
+struct ThreadLease {
+    ThreadBuffer* buffer = nullptr;
+    char name[32] = {};
+    ~ThreadLease();
+};
+
+inline std::atomic<bool> g_capturing{false};
+inline std::atomic<uint32_t> g_capture{0}; // bumped by every startCapture()
+inline thread_local ThreadLease t_lease;
+
+// Fetch or reset the calling thread's buffer for the current capture
+ThreadBuffer& beginCapture(ThreadLease& lease, uint32_t capture);
+
+// Zone timestamps: the time-stamp counter where there is one, as it costs
+// a fraction of a clock read, scaled to time against steady_clock over the
+// capture when it is written; steady_clock nanoseconds elsewhere
+inline int64_t now() {
+#ifdef MYTH_PROFILE_TSC
+    return static_cast<int64_t>(__rdtsc());
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline void record(const char* name, int64_t start, int64_t end) {
+    const uint32_t capture = g_capture.load(std::memory_order_relaxed);
+    ThreadBuffer* buffer = t_lease.buffer;
+    if (!buffer || buffer->capture != capture) buffer = &beginCapture(t_lease, capture);
+    const uint32_t n = buffer->count.load(std::memory_order_relaxed);
+    if (n == ThreadBuffer::CAPACITY) {
+        buffer->dropped++;
+        return;
+    }
+    buffer->events[n] = {name, start, end};
+    buffer->count.store(n + 1, std::memory_order_release);
+}
+
+class Zone {
+public:
+    explicit Zone(const char* name)
+        : m_name(name), m_start(g_capturing.load(std::memory_order_relaxed) ? now() : -1) {}
+    ~Zone() {
+        if (m_start >= 0) record(m_name, m_start, now());
+    }
+    Zone(const Zone&) = delete;
+    Zone& operator=(const Zone&) = delete;
+
+private:
+    const char* m_name;
+    int64_t m_start;
+};
+
+} // namespace profiler
+
+#endif
+
+} // namespace myth
+
+#ifdef MYTH_PROFILE
+
+#define MYTH_PROFILE_CONCAT_(a, b) a##b
+#define MYTH_PROFILE_CONCAT(a, b) MYTH_PROFILE_CONCAT_(a, b)
+// Time the rest of the enclosing scope; `name` must be a string literal
+#define MYTH_PROFILE_ZONE(name) ::myth::profiler::Zone MYTH_PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#define MYTH_PROFILE_FRAME() ::myth::Profiler::frame()
+#define MYTH_PROFILE_THREAD(name) ::myth::Profiler::setThreadName(name)
+
+#else
+
+#define MYTH_PROFILE_ZONE(name) ((void)0)
+#define MYTH_PROFILE_FRAME() ((void)0)
+#define MYTH_PROFILE_THREAD(name) ((void)0)
+
+#endif
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace myth {
 
@@ -89,6 +90,8 @@ public:
         // Update all tracked regions
         for (auto& [coord, data] : m_regions) {
             bool playerPresent = (coord == playerRegion);
+            const float oldPressure = data.realityPressure;
+            const RegionState oldState = data.state;
             
             if (playerPresent) {
                 // Build pressure when player is present
@@ -106,11 +109,13 @@ public:
             
             // Update state based on pressure
             updateRegionState(data, dt);
+            if (data.realityPressure != oldPressure || data.state != oldState) m_dirty.insert(coord);
         }
         
         // Ensure player's region exists
         if (m_regions.find(playerRegion) == m_regions.end()) {
             m_regions[playerRegion] = RegionData{};
+            m_dirty.insert(playerRegion);
         }
         
         // Track current region for external access
@@ -130,7 +135,9 @@ public:
         return m_defaultRegion;
     }
     
+    // Counts as a change: the caller is expected to modify the region
     RegionData& getOrCreateRegion(const RegionCoord& coord) {
+        m_dirty.insert(coord);
         return m_regions[coord];
     }
     
@@ -160,6 +167,12 @@ public:
     }
     
     size_t trackedRegionCount() const { return m_regions.size(); }
+    const std::unordered_map<RegionCoord, RegionData, RegionCoordHash>& trackedRegions() const { return m_regions; }
+
+    // Regions created or whose saved state (pressure, state) changed since
+    // the last clearDirty(), for incremental saves
+    const std::unordered_set<RegionCoord, RegionCoordHash>& dirtyRegions() const { return m_dirty; }
+    void clearDirty() { m_dirty.clear(); }
     
     RegionCoord currentRegion() const { return m_currentRegion; }
 
@@ -212,6 +225,7 @@ private:
     }
     
     std::unordered_map<RegionCoord, RegionData, RegionCoordHash> m_regions;
+    std::unordered_set<RegionCoord, RegionCoordHash> m_dirty;
     RegionCoord m_currentRegion{0, 0};
     RegionData m_defaultRegion;
 };
@@ -0,0 +1,140 @@
+﻿#include "SaveLoad.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace myth {
+
+namespace {
+
+bool flushToDisk(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// The rename itself lives in the directory; sync that too so it survives a crash
+void flushDirectory([[maybe_unused]] const std::filesystem::path& directory) {
+#ifndef _WIN32
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    ::close(fd);
+#endif
+}
+
+std::FILE* openFile(const std::filesystem::path& path, bool append) {
+#ifdef _WIN32
+    return _wfopen(path.c_str(), append ? L"ab" : L"wb");
+#else
+    return std::fopen(path.c_str(), append ? "ab" : "wb");
+#endif
+}
+
+// The header of the journal at `path`, if it has one
+bool readJournalHeader(const std::filesystem::path& path, savefile::JournalHeader& header) {
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(header)) return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    return std::memcmp(header.magic, savefile::JOURNAL_MAGIC, sizeof(header.magic)) == 0;
+}
+
+} // namespace
+
+bool writeFileAtomically(const std::filesystem::path& path, const void* data, size_t size) {
+    std::error_code error;
+    const std::filesystem::path directory = path.parent_path();
+    if (!directory.empty()) std::filesystem::create_directories(directory, error);
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    std::FILE* file = openFile(temporary, false);
+    if (!file) return false;
+    bool ok = (size == 0 || std::fwrite(data, 1, size, file) == size) && flushToDisk(file);
+    ok = std::fclose(file) == 0 && ok;
+
+    if (ok) std::filesystem::rename(temporary, path, error);
+    if (!ok || error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    flushDirectory(directory);
+    return true;
+}
+
+bool SaveManager::saveDelta(const SaveData& delta, const std::string& filename, size_t* bytesWritten) {
+    const uint64_t baseId = SaveView::readSaveId(filename);
+    if (baseId == 0) return false;
+
+    // Deltas are written often, so the world snapshot goes in compressed
+    std::vector<uint8_t> world;
+    if (!delta.world.empty()) {
+        world.resize(compression::compressBound(delta.world.size()));
+        world.resize(compression::compress(delta.world.data(), delta.world.size(), world.data()));
+    }
+
+    const size_t regionBytes = delta.regions.size() * sizeof(RegionSave);
+    const size_t payloadSize = sizeof(SaveMeta) + regionBytes + world.size();
+    if (payloadSize > UINT32_MAX) return false;
+    std::string bytes(sizeof(savefile::JournalRecord) + payloadSize, '\0');
+    char* payload = bytes.data() + sizeof(savefile::JournalRecord);
+    std::memcpy(payload, &delta.meta(), sizeof(SaveMeta));
+    if (regionBytes) std::memcpy(payload + sizeof(SaveMeta), delta.regions.data(), regionBytes);
+    if (!world.empty()) std::memcpy(payload + sizeof(SaveMeta) + regionBytes, world.data(), world.size());
+    const savefile::JournalRecord record = {static_cast<uint32_t>(payloadSize), savefile::checksum(payload, payloadSize),
+                                            static_cast<uint32_t>(delta.regions.size()), static_cast<uint32_t>(world.size())};
+    std::memcpy(bytes.data(), &record, sizeof(record));
+
+    // A journal left by another base is stale: start a new one. One this
+    // base got from an older build is not, but cannot take these records,
+    // so fail and let a full save replace both.
+    const std::filesystem::path path = savefile::journalPath(filename);
+    savefile::JournalHeader existing;
+    const bool append = readJournalHeader(path, existing) && existing.baseId == baseId;
+    if (append && existing.version != savefile::JOURNAL_VERSION) return false;
+    std::FILE* file = openFile(path, append);
+    if (!file) return false;
+    bool ok = true;
+    if (!append) {
+        savefile::JournalHeader header{};
+        std::memcpy(header.magic, savefile::JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = savefile::JOURNAL_VERSION;
+        header.baseId = baseId;
+        ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+    ok = ok && std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size() && flushToDisk(file);
+    ok = std::fclose(file) == 0 && ok;
+    if (ok && bytesWritten) *bytesWritten = bytes.size();
+    return ok;
+}
+
+bool SaveManager::compact(const std::string& filename, JobSystem* jobs) {
+    // Only binary saves have a journal
+    if (SaveView::readSaveId(filename) == 0) return false;
+    SaveData data;
+    // save() writes a new base and drops the journal; a crash in between
+    // leaves a journal naming the old base, which is then ignored
+    return load(data, filename) && save(data, filename, nullptr, jobs);
+}
+
+uint64_t SaveManager::newSaveId() {
+    static std::atomic<uint64_t> counter{0};
+    std::random_device device;
+    const uint64_t random = (uint64_t(device()) << 32) ^ device();
+    const uint64_t time = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    const uint64_t id = random ^ time ^ (counter++ * 0x9E3779B97F4A7C15ull);
+    return id ? id : 1;
+}
+
+} // namespace myth
@@ -1,16 +1,27 @@
 ﻿#pragma once
 
+#include "Compression.h"
+#include "JsonReader.h"
+#include "MappedFile.h"
 #include "RegionState.h"
 #include <glm/glm.hpp>
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <span>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 #include <filesystem>
 
 namespace myth {
 
-struct SaveData {
+// Everything in a save but the regions. Fixed layout: the binary format
+// stores it as is.
+struct SaveMeta {
     // Player state
     glm::vec3 playerPosition{0, 0, 0};
     float playerYaw = 0.0f;
@@ -20,136 +31,549 @@ struct SaveData {
     float cameraPitch = 25.0f;
     float cameraDistance = 8.0f;
     
-    // Region states
-    struct RegionSave {
-        int x, z;
-        int state;  // RegionState enum as int
-        float pressure;
-    };
-    std::vector<RegionSave> regions;
-    
     // Metadata
     float playTime = 0.0f;
 };
 
+// One region's record; fixed layout like SaveMeta
+struct RegionSave {
+    int x, z;
+    int state;  // RegionState enum as int
+    float pressure;
+};
+
+struct SaveData : SaveMeta {
+    using RegionSave = myth::RegionSave;
+    std::vector<RegionSave> regions;
+    // ecs::serializeWorld() bytes; binary saves only. A delta carries one
+    // when the world changed since the last one, and it replaces the base's.
+    std::string world;
+
+    const SaveMeta& meta() const { return *this; }
+};
+
+// Fold a newer delta into `data`: its meta wins, and its regions replace
+// those at the same coordinates or are added
+inline void applyDelta(SaveData& data, const SaveMeta& meta, std::span<const RegionSave> regions) {
+    static_cast<SaveMeta&>(data) = meta;
+    auto key = [](const RegionSave& r) { return uint64_t(uint32_t(r.x)) << 32 | uint32_t(r.z); };
+    std::unordered_map<uint64_t, const RegionSave*> changed;
+    changed.reserve(regions.size());
+    for (const RegionSave& r : regions) changed[key(r)] = &r;
+    for (RegionSave& r : data.regions) {
+        auto it = changed.find(key(r));
+        if (it == changed.end()) continue;
+        r = *it->second;
+        changed.erase(it);
+    }
+    for (const RegionSave& r : regions) {
+        auto it = changed.find(key(r));
+        if (it == changed.end()) continue; // replaced above, or a repeat
+        data.regions.push_back(*it->second);
+        changed.erase(it);
+    }
+}
+
+// Binary save layout. A Header, then `sectionCount` Section entries, then
+// the sections' payloads, each SECTION_ALIGNMENT aligned. A section is an
+// array of fixed-size records; readers skip sections they do not know and
+// reject files from a newer VERSION. Little-endian, as written. Since
+// version 2 a Section also says how its payload is stored: as is, or as a
+// compression stream (Compression.h) of `storedSize` bytes decoding to
+// `size`. Version 1 files have the shorter SectionV1 and nothing
+// compressed.
+//
+// Beside a base save "x.sav" may sit a journal "x.sav.journal" of deltas
+// appended since: a JournalHeader naming the base by its SAVE_ID, then
+// JournalRecords, each followed by a SaveMeta, `regionCount` RegionSaves
+// and, since journal version 2, `worldSize` bytes of world snapshot that
+// replace the base's; since version 3 those are a compression stream. A
+// journal naming another base is stale and ignored, and
+// replay stops at the first record whose size or checksum is off, which
+// is where a crash interrupted an append.
+namespace savefile {
+
+constexpr char MAGIC[4] = {'M', 'B', 'S', 'V'};
+constexpr uint32_t VERSION = 2;
+constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+constexpr uint32_t fourcc(const char (&s)[5]) {
+    return uint32_t(uint8_t(s[0])) | uint32_t(uint8_t(s[1])) << 8 | uint32_t(uint8_t(s[2])) << 16 | uint32_t(uint8_t(s[3])) << 24;
+}
+constexpr uint32_t META = fourcc("META");       // one SaveMeta
+constexpr uint32_t REGIONS = fourcc("REGN");    // RegionSave records
+constexpr uint32_t SAVE_ID = fourcc("SVID");    // one uint64_t naming this base for its journal
+constexpr uint32_t WORLD = fourcc("WRLD");      // an ECS world snapshot, as bytes
+
+constexpr char JOURNAL_MAGIC[4] = {'M', 'B', 'J', 'N'};
+constexpr uint32_t JOURNAL_VERSION = 3;
+
+inline std::string journalPath(const std::string& filename) { return filename + ".journal"; }
+
+// FNV-1a, to catch torn journal appends
+inline uint32_t checksum(const void* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 16777619u;
+    return hash;
+}
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint32_t reserved;
+};
+
+enum class Encoding : uint32_t { Raw, Compressed };
+
+struct Section {
+    uint32_t id;
+    uint32_t recordSize;
+    uint64_t offset;     // from the start of the file
+    uint64_t size;       // bytes once decoded, a multiple of recordSize
+    uint64_t storedSize; // bytes in the file
+    Encoding encoding;
+    uint32_t reserved;
+};
+
+struct SectionV1 {
+    uint32_t id;
+    uint32_t recordSize;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Sections smaller than this are stored as is; a stream header and block
+// table would eat most of what compressing them could save
+constexpr uint64_t MIN_COMPRESSED_SIZE = 4096;
+
+struct JournalHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t baseId;
+};
+
+struct JournalRecord {
+    uint32_t size;     // bytes after this header: the SaveMeta, the regions and the world
+    uint32_t checksum; // of those bytes
+    uint32_t regionCount;
+    uint32_t worldSize; // stored bytes; 0 if the world did not change, always 0 in version 1
+};
+
+static_assert(std::endian::native == std::endian::little, "the binary save format is little-endian");
+static_assert(std::is_trivially_copyable_v<SaveMeta> && sizeof(SaveMeta) == 32);
+static_assert(std::is_trivially_copyable_v<RegionSave> && sizeof(RegionSave) == 16);
+static_assert(sizeof(Section) == 40 && sizeof(SectionV1) == 24);
+static_assert(sizeof(JournalHeader) == 16 && sizeof(JournalRecord) == 16);
+
+} // namespace savefile
+
+// A binary save and its journal mapped into memory. Sections stored as is
+// are not parsed or copied: meta(), regions(), world() and the deltas
+// point into the mappings. Compressed sections, and the newest journal
+// snapshot, are decoded once, on open(), into memory the view owns. Either way they stay valid while the
+// view is open. The state saved is the base with every delta applied in
+// order; world() is already the newest snapshot, the base's or a delta's.
+class SaveView {
+public:
+    // False if the file is missing, not a binary save, from a newer
+    // version, or has sections that do not fit or do not decode. A
+    // missing, stale or unreadable journal just leaves no deltas.
+    bool open(const std::string& filename) { return map(filename, true); }
+
+    // The id of the binary save at `filename`, without decoding its
+    // compressed sections; 0 if there is no such save or it has no id
+    static uint64_t readSaveId(const std::string& filename) {
+        SaveView view;
+        return view.map(filename, false) ? view.m_saveId : 0;
+    }
+
+    void close() {
+        m_file.close();
+        m_journal.close();
+        m_decoded.clear();
+        m_meta = nullptr;
+        m_regions = {};
+        m_world = {};
+        m_version = 0;
+        m_saveId = 0;
+        m_journalEnd = 0;
+        m_deltaCount = 0;
+    }
+
+    bool isOpen() const { return m_meta != nullptr; }
+    uint32_t version() const { return m_version; }
+    // Names this base for its journal; 0 for saves written without one
+    uint64_t saveId() const { return m_saveId; }
+    const SaveMeta& meta() const { return *m_meta; }
+    std::span<const RegionSave> regions() const { return m_regions; }
+    // The newest world snapshot: the last delta's that has one, else the
+    // base's. Empty for saves written without one.
+    std::span<const uint8_t> world() const { return m_world; }
+
+    size_t deltaCount() const { return m_deltaCount; }
+    // func(const SaveMeta&, std::span<const RegionSave>) for each delta, oldest first
+    template<typename Func>
+    void forEachDelta(Func&& func) const {
+        for (size_t offset = sizeof(savefile::JournalHeader); offset < m_journalEnd;) {
+            savefile::JournalRecord record;
+            std::memcpy(&record, m_journal.data() + offset, sizeof(record));
+            const uint8_t* payload = m_journal.data() + offset + sizeof(record);
+            func(*reinterpret_cast<const SaveMeta*>(payload),
+                 std::span<const RegionSave>(reinterpret_cast<const RegionSave*>(payload + sizeof(SaveMeta)), record.regionCount));
+            offset += sizeof(record) + record.size;
+        }
+    }
+
+private:
+    bool fail() {
+        close();
+        return false;
+    }
+
+    // With `decode` false, compressed sections are checked for size but left empty
+    bool map(const std::string& filename, bool decode) {
+        close();
+        if (!m_file.open(filename) || m_file.size() < sizeof(savefile::Header)) return fail();
+        savefile::Header header;
+        std::memcpy(&header, m_file.data(), sizeof(header));
+        if (std::memcmp(header.magic, savefile::MAGIC, sizeof(header.magic)) != 0 || header.version > savefile::VERSION) return fail();
+        const size_t entrySize = header.version >= 2 ? sizeof(savefile::Section) : sizeof(savefile::SectionV1);
+        if (header.sectionCount > (m_file.size() - sizeof(header)) / entrySize) return fail();
+
+        m_version = header.version;
+        for (uint32_t i = 0; i < header.sectionCount; i++) {
+            const uint8_t* entry = m_file.data() + sizeof(header) + i * entrySize;
+            savefile::Section section;
+            if (header.version >= 2) {
+                std::memcpy(&section, entry, sizeof(section));
+            } else {
+                savefile::SectionV1 old;
+                std::memcpy(&old, entry, sizeof(old));
+                section = {old.id, old.recordSize, old.offset, old.size, old.size, savefile::Encoding::Raw, 0};
+            }
+            if (section.offset > m_file.size() || section.storedSize > m_file.size() - section.offset ||
+                section.offset % savefile::SECTION_ALIGNMENT != 0) return fail();
+
+            std::span<const uint8_t> bytes;
+            if (section.id == savefile::META) {
+                if (section.recordSize != sizeof(SaveMeta) || section.size != sizeof(SaveMeta) || !payload(section, true, bytes)) return fail();
+                m_meta = reinterpret_cast<const SaveMeta*>(bytes.data());
+            } else if (section.id == savefile::REGIONS) {
+                if (section.recordSize != sizeof(RegionSave) || section.size % sizeof(RegionSave) != 0 || !payload(section, decode, bytes)) return fail();
+                m_regions = {reinterpret_cast<const RegionSave*>(bytes.data()), bytes.size() / sizeof(RegionSave)};
+            } else if (section.id == savefile::SAVE_ID) {
+                if (section.recordSize != sizeof(uint64_t) || section.size != sizeof(uint64_t) || !payload(section, true, bytes)) return fail();
+                std::memcpy(&m_saveId, bytes.data(), sizeof(uint64_t));
+            } else if (section.id == savefile::WORLD) {
+                if (section.recordSize != 1 || !payload(section, decode, bytes)) return fail();
+                m_world = bytes;
+            }
+        }
+        if (!m_meta) return fail();
+        if (m_saveId != 0 && decode) openJournal(savefile::journalPath(filename));
+        return true;
+    }
+
+    // A section's decoded bytes: in the mapping, or decoded into m_decoded
+    bool payload(const savefile::Section& section, bool decode, std::span<const uint8_t>& bytes) {
+        const uint8_t* stored = m_file.data() + section.offset;
+        if (section.encoding == savefile::Encoding::Raw) {
+            if (section.storedSize != section.size) return false;
+            bytes = {stored, section.size};
+            return true;
+        }
+        // decompressedSize() refuses sizes beyond MAX_EXPANSION times the
+        // stored bytes, so a damaged header cannot make this allocate more
+        uint64_t size;
+        if (section.encoding != savefile::Encoding::Compressed ||
+            section.size > section.storedSize * compression::MAX_EXPANSION ||
+            !compression::decompressedSize(stored, section.storedSize, size) || size != section.size) return false;
+        if (!decode) return true;
+        auto& decoded = m_decoded.emplace_back(section.size);
+        if (!compression::decompress(stored, section.storedSize, decoded.data(), decoded.size())) return false;
+        bytes = decoded;
+        return true;
+    }
+
+    // Keep the records that are whole; m_journalEnd marks the first that is not
+    void openJournal(const std::string& path) {
+        if (!m_journal.open(path)) return;
+        savefile::JournalHeader header;
+        if (m_journal.size() < sizeof(header)) {
+            m_journal.close();
+            return;
+        }
+        std::memcpy(&header, m_journal.data(), sizeof(header));
+        if (std::memcmp(header.magic, savefile::JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version > savefile::JOURNAL_VERSION || header.baseId != m_saveId) {
+            m_journal.close();
+            return;
+        }
+
+        const bool compressed = header.version >= 3;
+        std::span<const uint8_t> newest;
+        uint64_t newestSize = 0;
+        size_t offset = sizeof(header);
+        while (m_journal.size() - offset >= sizeof(savefile::JournalRecord)) {
+            savefile::JournalRecord record;
+            std::memcpy(&record, m_journal.data() + offset, sizeof(record));
+            const size_t payload = offset + sizeof(record);
+            const uint64_t regionBytes = uint64_t(record.regionCount) * sizeof(RegionSave);
+            if (record.size > m_journal.size() - payload ||
+                record.size != sizeof(SaveMeta) + regionBytes + record.worldSize ||
+                record.checksum != savefile::checksum(m_journal.data() + payload, record.size)) break;
+            const std::span<const uint8_t> world(m_journal.data() + payload + sizeof(SaveMeta) + regionBytes, record.worldSize);
+            uint64_t size = 0;
+            if (compressed && !world.empty() && !compression::decompressedSize(world.data(), world.size(), size)) break;
+            if (!world.empty()) {
+                newest = world;
+                newestSize = size;
+            }
+            offset = payload + record.size;
+            m_deltaCount++;
+        }
+        m_journalEnd = offset;
+
+        // Only the newest snapshot is used, so only it is decoded
+        if (newest.empty()) return;
+        if (!compressed) {
+            m_world = newest;
+            return;
+        }
+        // A stream that passed its checksum but will not decode leaves the base's
+        auto& decoded = m_decoded.emplace_back(newestSize);
+        if (compression::decompress(newest.data(), newest.size(), decoded.data(), decoded.size())) m_world = decoded;
+    }
+
+    MappedFile m_file;
+    MappedFile m_journal;
+    std::vector<std::vector<uint8_t>> m_decoded; // compressed sections, decoded
+    const SaveMeta* m_meta = nullptr;
+    std::span<const RegionSave> m_regions;
+    std::span<const uint8_t> m_world;
+    uint32_t m_version = 0;
+    uint64_t m_saveId = 0;
+    size_t m_journalEnd = 0;
+    size_t m_deltaCount = 0;
+};
+
+// Replace `path` so it holds either its old contents or all of the new
+// ones, even across a crash: write a temporary file beside it, flush that
+// to disk, then rename it over. Creates missing parent directories.
+bool writeFileAtomically(const std::filesystem::path& path, const void* data, size_t size);
+
+// save() and load() pick the format from the file: binary normally, JSON
+// for names ending in .json, which is kept for export and debugging and
+// leaves out the world snapshot
 class SaveManager {
 public:
     static constexpr const char* SAVE_DIRECTORY = "saves";
-    static constexpr const char* DEFAULT_SAVE = "saves/quicksave.json";
+    static constexpr const char* DEFAULT_SAVE = "saves/quicksave.sav";
+    // Where older builds kept the quicksave, as JSON
+    static constexpr const char* LEGACY_SAVE = "saves/quicksave.json";
     
-    static bool save(const SaveData& data, const std::string& filename = DEFAULT_SAVE) {
-        // Ensure saves directory exists
-        std::filesystem::create_directories(SAVE_DIRECTORY);
-        
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            return false;
+    // Encode, then replace the file atomically. A binary save is a new
+    // base, with a new id, so any journal beside it no longer applies.
+    // `jobs` helps compress its sections.
+    static bool save(const SaveData& data, const std::string& filename = DEFAULT_SAVE, size_t* bytesWritten = nullptr,
+                     JobSystem* jobs = nullptr) {
+        const std::string bytes = encode(data, filename, jobs);
+        if (!writeFileAtomically(filename, bytes.data(), bytes.size())) return false;
+        if (!isJson(filename)) {
+            std::error_code ignored;
+            std::filesystem::remove(savefile::journalPath(filename), ignored);
+        }
+        if (bytesWritten) *bytesWritten = bytes.size();
+        return true;
+    }
+
+    // Append what changed since the last save to the journal of the binary
+    // base save at `filename`. False if there is no such base (or it has
+    // no id), in which case a full save() is needed first.
+    static bool saveDelta(const SaveData& delta, const std::string& filename = DEFAULT_SAVE, size_t* bytesWritten = nullptr);
+
+    // Fold the journal into a new base and remove it
+    static bool compact(const std::string& filename = DEFAULT_SAVE, JobSystem* jobs = nullptr);
+
+    // Bytes in the journal beside `filename`, stale or not; 0 if none
+    static uint64_t journalSize(const std::string& filename = DEFAULT_SAVE) {
+        std::error_code error;
+        const uint64_t size = std::filesystem::file_size(savefile::journalPath(filename), error);
+        return error ? 0 : size;
+    }
+
+    // The base with its journal applied. Files named .json, or without the
+    // binary magic, are read as JSON; a binary save this build cannot read
+    // (a newer version, a damaged header) fails instead.
+    static bool load(SaveData& data, const std::string& filename = DEFAULT_SAVE) {
+        if (isJson(filename) || !hasBinaryMagic(filename)) return loadJson(data, filename);
+        SaveView view;
+        if (!view.open(filename)) return false;
+        data = SaveData{};
+        static_cast<SaveMeta&>(data) = view.meta();
+        data.regions.assign(view.regions().begin(), view.regions().end());
+        data.world.assign(view.world().begin(), view.world().end());
+        if (view.deltaCount() > 0) {
+            // Gather the deltas first so the base is walked once
+            SaveData changes;
+            static_cast<SaveMeta&>(changes) = data.meta();
+            view.forEachDelta([&](const SaveMeta& meta, std::span<const RegionSave> regions) { applyDelta(changes, meta, regions); });
+            applyDelta(data, changes.meta(), changes.regions);
+        }
+        return true;
+    }
+
+    // The bytes save() writes for `filename`. No shared state, so any
+    // thread can do it; binary saves get a fresh id each time.
+    static std::string encode(const SaveData& data, const std::string& filename = DEFAULT_SAVE, JobSystem* jobs = nullptr) {
+        return isJson(filename) ? encodeJson(data) : encodeBinary(data, newSaveId(), jobs);
+    }
+
+    // Sections of MIN_COMPRESSED_SIZE or more are compressed, their blocks
+    // spread over `jobs`, unless that does not make them smaller
+    static std::string encodeBinary(const SaveData& data, uint64_t saveId, JobSystem* jobs = nullptr) {
+        using compression::Filter;
+        struct Payload { uint32_t id, recordSize; const void* bytes; uint64_t size; Filter filter; uint32_t stride; };
+        const Payload payloads[] = {
+            {savefile::META, sizeof(SaveMeta), &data.meta(), sizeof(SaveMeta), Filter::None, 0},
+            {savefile::REGIONS, sizeof(RegionSave), data.regions.data(), data.regions.size() * sizeof(RegionSave), Filter::None, 0},
+            {savefile::SAVE_ID, sizeof(uint64_t), &saveId, sizeof(uint64_t), Filter::None, 0},
+            // Packed columns of 4-byte fields, mostly
+            {savefile::WORLD, 1, data.world.data(), data.world.size(), Filter::Delta, 4},
+        };
+        constexpr uint32_t SECTION_COUNT = std::size(payloads);
+
+        std::vector<uint8_t> packed[SECTION_COUNT];
+        for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+            const Payload& p = payloads[i];
+            if (p.size < savefile::MIN_COMPRESSED_SIZE) continue;
+            packed[i].resize(compression::compressBound(p.size));
+            packed[i].resize(compression::compress(p.bytes, p.size, packed[i].data(), p.filter, p.stride, jobs));
+            if (packed[i].size() >= p.size) packed[i].clear();
+        }
+
+        savefile::Header header{};
+        std::memcpy(header.magic, savefile::MAGIC, sizeof(header.magic));
+        header.version = savefile::VERSION;
+        header.sectionCount = SECTION_COUNT;
+        savefile::Section sections[SECTION_COUNT];
+        const void* stored[SECTION_COUNT];
+        uint64_t offset = sizeof(header) + sizeof(sections);
+        for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+            const bool compressed = !packed[i].empty();
+            offset = alignUp(offset);
+            sections[i] = {payloads[i].id, payloads[i].recordSize, offset, payloads[i].size,
+                           compressed ? packed[i].size() : payloads[i].size,
+                           compressed ? savefile::Encoding::Compressed : savefile::Encoding::Raw, 0};
+            stored[i] = compressed ? packed[i].data() : payloads[i].bytes;
+            offset += sections[i].storedSize;
         }
+
+        // Zero-filled, so the padding between sections needs no writing
+        std::string bytes;
+        bytes.resize(offset);
+        char* out = bytes.data();
+        std::memcpy(out, &header, sizeof(header));
+        std::memcpy(out + sizeof(header), sections, sizeof(sections));
+        for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+            if (sections[i].storedSize) std::memcpy(out + sections[i].offset, stored[i], sections[i].storedSize);
+        }
+        return bytes;
+    }
+
+    static std::string encodeJson(const SaveData& data) {
+        std::ostringstream out;
         
         // Write JSON manually (simple format)
-        file << "{\n";
-        file << "  \"version\": 1,\n";
-        file << "  \"playTime\": " << data.playTime << ",\n";
+        out << "{\n";
+        out << "  \"version\": 1,\n";
+        out << "  \"playTime\": " << data.playTime << ",\n";
         
         // Player
-        file << "  \"player\": {\n";
-        file << "    \"position\": [" << data.playerPosition.x << ", " 
-             << data.playerPosition.y << ", " << data.playerPosition.z << "],\n";
-        file << "    \"yaw\": " << data.playerYaw << "\n";
-        file << "  },\n";
+        out << "  \"player\": {\n";
+        out << "    \"position\": [" << data.playerPosition.x << ", " 
+            << data.playerPosition.y << ", " << data.playerPosition.z << "],\n";
+        out << "    \"yaw\": " << data.playerYaw << "\n";
+        out << "  },\n";
         
         // Camera
-        file << "  \"camera\": {\n";
-        file << "    \"yaw\": " << data.cameraYaw << ",\n";
-        file << "    \"pitch\": " << data.cameraPitch << ",\n";
-        file << "    \"distance\": " << data.cameraDistance << "\n";
-        file << "  },\n";
+        out << "  \"camera\": {\n";
+        out << "    \"yaw\": " << data.cameraYaw << ",\n";
+        out << "    \"pitch\": " << data.cameraPitch << ",\n";
+        out << "    \"distance\": " << data.cameraDistance << "\n";
+        out << "  },\n";
         
         // Regions
-        file << "  \"regions\": [\n";
+        out << "  \"regions\": [\n";
         for (size_t i = 0; i < data.regions.size(); i++) {
             const auto& r = data.regions[i];
-            file << "    {\"x\": " << r.x << ", \"z\": " << r.z 
-                 << ", \"state\": " << r.state << ", \"pressure\": " << r.pressure << "}";
-            if (i < data.regions.size() - 1) file << ",";
-            file << "\n";
+            out << "    {\"x\": " << r.x << ", \"z\": " << r.z 
+                << ", \"state\": " << r.state << ", \"pressure\": " << r.pressure << "}";
+            if (i < data.regions.size() - 1) out << ",";
+            out << "\n";
         }
-        file << "  ]\n";
+        out << "  ]\n";
         
-        file << "}\n";
-        file.close();
-        return true;
+        out << "}\n";
+        return out.str();
     }
     
-    static bool load(SaveData& data, const std::string& filename = DEFAULT_SAVE) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
+    // Single pass over the mapped text; unknown keys are skipped
+    static bool loadJson(SaveData& data, const std::string& filename) {
+        MappedFile file;
+        if (!file.open(filename)) {
             return false;
         }
-        
-        // Read entire file
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string content = buffer.str();
-        file.close();
-        
-        // Simple JSON parsing (not robust, but works for our format)
+        JsonReader json({reinterpret_cast<const char*>(file.data()), file.size()});
         data = SaveData{}; // Reset
-        
-        // Parse playTime
-        data.playTime = parseFloat(content, "\"playTime\":");
-        
-        // Parse player position
-        size_t posStart = content.find("\"position\": [");
-        if (posStart != std::string::npos) {
-            posStart += 13;
-            size_t posEnd = content.find("]", posStart);
-            std::string posStr = content.substr(posStart, posEnd - posStart);
-            sscanf(posStr.c_str(), "%f, %f, %f", 
-                   &data.playerPosition.x, &data.playerPosition.y, &data.playerPosition.z);
-        }
-        
-        // Parse player yaw (find it in player section)
-        size_t playerSection = content.find("\"player\":");
-        if (playerSection != std::string::npos) {
-            size_t playerEnd = content.find("}", playerSection);
-            std::string playerStr = content.substr(playerSection, playerEnd - playerSection);
-            data.playerYaw = parseFloat(playerStr, "\"yaw\":");
-        }
-        
-        // Parse camera
-        size_t cameraSection = content.find("\"camera\":");
-        if (cameraSection != std::string::npos) {
-            size_t cameraEnd = content.find("}", cameraSection);
-            std::string cameraStr = content.substr(cameraSection, cameraEnd - cameraSection);
-            data.cameraYaw = parseFloat(cameraStr, "\"yaw\":");
-            data.cameraPitch = parseFloat(cameraStr, "\"pitch\":");
-            data.cameraDistance = parseFloat(cameraStr, "\"distance\":");
-        }
-        
-        // Parse regions array
-        size_t regionsStart = content.find("\"regions\": [");
-        if (regionsStart != std::string::npos) {
-            size_t regionsEnd = content.find("]", regionsStart);
-            std::string regionsStr = content.substr(regionsStart, regionsEnd - regionsStart);
-            
-            size_t pos = 0;
-            while ((pos = regionsStr.find("{", pos)) != std::string::npos) {
-                size_t end = regionsStr.find("}", pos);
-                std::string regionStr = regionsStr.substr(pos, end - pos);
-                
-                SaveData::RegionSave r;
-                r.x = static_cast<int>(parseFloat(regionStr, "\"x\":"));
-                r.z = static_cast<int>(parseFloat(regionStr, "\"z\":"));
-                r.state = static_cast<int>(parseFloat(regionStr, "\"state\":"));
-                r.pressure = parseFloat(regionStr, "\"pressure\":");
-                data.regions.push_back(r);
-                
-                pos = end + 1;
+
+        std::string_view key;
+        if (!json.beginObject()) return false;
+        while (json.nextKey(key)) {
+            if (key == "playTime") {
+                json.read(data.playTime);
+            } else if (key == "player") {
+                json.beginObject();
+                while (json.nextKey(key)) {
+                    if (key == "position") {
+                        json.beginArray();
+                        for (int i = 0; json.nextElement(); i++) {
+                            if (i < 3) json.read(data.playerPosition[i]);
+                            else json.skipValue();
+                        }
+                    } else if (key == "yaw") {
+                        json.read(data.playerYaw);
+                    } else {
+                        json.skipValue();
+                    }
+                }
+            } else if (key == "camera") {
+                json.beginObject();
+                while (json.nextKey(key)) {
+                    if (key == "yaw") json.read(data.cameraYaw);
+                    else if (key == "pitch") json.read(data.cameraPitch);
+                    else if (key == "distance") json.read(data.cameraDistance);
+                    else json.skipValue();
+                }
+            } else if (key == "regions") {
+                json.beginArray();
+                while (json.nextElement()) {
+                    RegionSave& r = data.regions.emplace_back();
+                    json.beginObject();
+                    while (json.nextKey(key)) {
+                        if (key == "x") json.read(r.x);
+                        else if (key == "z") json.read(r.z);
+                        else if (key == "state") json.read(r.state);
+                        else if (key == "pressure") json.read(r.pressure);
+                        else json.skipValue();
+                    }
+                }
+            } else {
+                json.skipValue();
             }
         }
-        
-        return true;
+        return json.ok();
     }
     
     static bool saveExists(const std::string& filename = DEFAULT_SAVE) {
@@ -157,13 +581,20 @@ public:
     }
 
 private:
-    static float parseFloat(const std::string& str, const std::string& key) {
-        size_t pos = str.find(key);
-        if (pos == std::string::npos) return 0.0f;
-        pos += key.length();
-        // Skip whitespace
-        while (pos < str.length() && (str[pos] == ' ' || str[pos] == '\t')) pos++;
-        return std::stof(str.substr(pos));
+    static uint64_t newSaveId();
+
+    static bool isJson(const std::string& filename) {
+        return std::filesystem::path(filename).extension() == ".json";
+    }
+
+    static bool hasBinaryMagic(const std::string& filename) {
+        char magic[sizeof(savefile::MAGIC)] = {};
+        std::ifstream file(filename, std::ios::binary);
+        return file.read(magic, sizeof(magic)) && std::memcmp(magic, savefile::MAGIC, sizeof(magic)) == 0;
+    }
+
+    static uint64_t alignUp(uint64_t offset) {
+        return (offset + savefile::SECTION_ALIGNMENT - 1) & ~(savefile::SECTION_ALIGNMENT - 1);
     }
 };
 
@@ -1,17 +1,74 @@
 ﻿#include "Timer.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 
 namespace myth {
 
-Timer::Timer() : m_startTime(Clock::now()), m_lastTime(m_startTime) {}
+uint32_t TimeHistogram::bucketOf(uint64_t micros) {
+    if (micros < SUB_BUCKETS) return static_cast<uint32_t>(micros);
+    micros = std::min<uint64_t>(micros, (uint64_t(1) << MAX_BITS) - 1);
+    // Shifted right by `shift`, the value lands in [SUB_BUCKETS / 2, SUB_BUCKETS)
+    const uint32_t shift = static_cast<uint32_t>(std::bit_width(micros)) - SUB_BITS;
+    return SUB_BUCKETS + (shift - 1) * (SUB_BUCKETS / 2) + static_cast<uint32_t>(micros >> shift) - SUB_BUCKETS / 2;
+}
+
+uint64_t TimeHistogram::bucketStart(uint32_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    const uint32_t shift = (bucket - SUB_BUCKETS) / (SUB_BUCKETS / 2) + 1;
+    const uint64_t sub = (bucket - SUB_BUCKETS) % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2;
+    return sub << shift;
+}
+
+void TimeHistogram::record(uint64_t micros) {
+    m_counts[bucketOf(micros)]++;
+    m_count++;
+    m_sum += micros;
+    m_max = std::max(m_max, micros);
+}
+
+void TimeHistogram::add(const TimeHistogram& other) {
+    for (uint32_t i = 0; i < BUCKETS; i++) m_counts[i] += other.m_counts[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = std::max(m_max, other.m_max);
+}
+
+float TimeHistogram::percentileMs(double fraction) const {
+    if (m_count == 0) return 0.0f;
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(m_count))));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        seen += m_counts[i];
+        if (seen >= rank) {
+            const uint64_t start = bucketStart(i);
+            const uint64_t width = i + 1 < BUCKETS ? bucketStart(i + 1) - start : 1;
+            const double middle = static_cast<double>(start) + static_cast<double>(width - 1) / 2.0;
+            return static_cast<float>(std::min(middle, static_cast<double>(m_max)) / 1000.0);
+        }
+    }
+    return maxMs();
+}
+
+Timer::Timer() : m_startTime(Clock::now()), m_lastTime(m_startTime), m_sliceStart(m_startTime) {
+    m_series.push_back({"frame"});
+}
 
 void Timer::tick() {
     auto now = Clock::now();
     m_deltaTime = std::chrono::duration<float>(now - m_lastTime).count();
+    advanceWindow(now);
+    // The first frame's time is however long startup took
+    if (!m_firstTick) add(m_series[0], now - m_lastTime);
+    m_firstTick = false;
     m_lastTime = now;
-    
+
     m_fpsAccum += m_deltaTime;
     m_frameCount++;
-    
+
     if (m_fpsAccum >= 1.0f) {
         m_fps = static_cast<float>(m_frameCount) / m_fpsAccum;
         m_frameCount = 0;
@@ -27,4 +84,80 @@ float Timer::totalTime() const {
     return std::chrono::duration<float>(Clock::now() - m_startTime).count();
 }
 
+void Timer::record(const char* name, std::chrono::nanoseconds duration) {
+    for (size_t i = 1; i < m_series.size(); i++) {
+        if (m_series[i].name == name || std::strcmp(m_series[i].name, name) == 0) {
+            add(m_series[i], duration);
+            return;
+        }
+    }
+    m_series.push_back({name});
+    add(m_series.back(), duration);
+}
+
+void Timer::add(Series& series, std::chrono::nanoseconds duration) {
+    const uint64_t micros = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+    series.slices[m_slice].record(micros);
+    series.total.record(micros);
+    if (static_cast<float>(micros) > hitchMs * 1000.0f) {
+        series.sliceHitches[m_slice]++;
+        series.hitches++;
+    }
+}
+
+// Start a new slice for every SLICE_SECONDS gone by, dropping the oldest
+void Timer::advanceWindow(TimePoint now) {
+    const auto slice = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(SLICE_SECONDS));
+    for (int n = 0; now - m_sliceStart >= slice; n++) {
+        m_sliceStart += slice;
+        if (n >= WINDOW_SLICES) continue; // all of them are already cleared
+        m_slice = (m_slice + 1) % WINDOW_SLICES;
+        for (Series& series : m_series) {
+            series.slices[m_slice].clear();
+            series.sliceHitches[m_slice] = 0;
+        }
+    }
+}
+
+Timer::Stats Timer::windowStats(const Series& series) const {
+    TimeHistogram window;
+    uint64_t hitches = 0;
+    for (int i = 0; i < WINDOW_SLICES; i++) {
+        window.add(series.slices[i]);
+        hitches += series.sliceHitches[i];
+    }
+    return statsOf(window, hitches);
+}
+
+Timer::Stats Timer::statsOf(const TimeHistogram& histogram, uint64_t hitches) {
+    return {histogram.count(), hitches, histogram.percentileMs(0.50), histogram.percentileMs(0.95),
+            histogram.percentileMs(0.99), histogram.maxMs()};
+}
+
+Timer::Stats Timer::phaseStats(const char* name) const {
+    for (size_t i = 1; i < m_series.size(); i++) {
+        if (std::strcmp(m_series[i].name, name) == 0) return windowStats(m_series[i]);
+    }
+    return {};
+}
+
+bool Timer::writeCsv(const std::string& filename) const {
+    const std::filesystem::path path(filename);
+    std::error_code error;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), error);
+    std::FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) return false;
+    std::fprintf(file, "series,count,mean_ms,p50_ms,p90_ms,p95_ms,p99_ms,p999_ms,max_ms,hitches\n");
+    for (const Series& s : m_series) {
+        const TimeHistogram& h = s.total;
+        std::fprintf(file, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%llu\n", s.name,
+                     static_cast<unsigned long long>(h.count()), h.meanMs(), h.percentileMs(0.50), h.percentileMs(0.90),
+                     h.percentileMs(0.95), h.percentileMs(0.99), h.percentileMs(0.999), h.maxMs(),
+                     static_cast<unsigned long long>(s.hitches));
+    }
+    const bool ok = std::fflush(file) == 0 && !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
 } // namespace myth
@@ -1,28 +1,128 @@
 ﻿#pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace myth {
 
+// Durations counted in log-spaced buckets, in the style of an HDR
+// histogram: microseconds below SUB_BUCKETS are exact, and above that each
+// power of two is split into SUB_BUCKETS / 2 linear buckets, so a value is
+// known to within about 3% whatever its size, in a fixed 2.8 KB.
+class TimeHistogram {
+public:
+    static constexpr uint32_t SUB_BITS = 6;
+    static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BITS;
+    static constexpr uint32_t MAX_BITS = 26; // about 67 s; longer ones count as that
+    static constexpr uint32_t BUCKETS = SUB_BUCKETS + (MAX_BITS - SUB_BITS) * (SUB_BUCKETS / 2);
+
+    void record(uint64_t micros);
+    void add(const TimeHistogram& other);
+    void clear() { *this = {}; }
+
+    uint64_t count() const { return m_count; }
+    // In milliseconds; the middle of the bucket holding that rank, never
+    // more than the largest value recorded
+    float percentileMs(double fraction) const;
+    float maxMs() const { return static_cast<float>(m_max) / 1000.0f; }
+    float meanMs() const { return m_count ? static_cast<float>(static_cast<double>(m_sum) / static_cast<double>(m_count) / 1000.0) : 0.0f; }
+
+private:
+    static uint32_t bucketOf(uint64_t micros);
+    static uint64_t bucketStart(uint32_t bucket);
+
+    std::array<uint32_t, BUCKETS> m_counts{};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_max = 0;
+};
+
+// Frame clock. Besides deltaTime() and an averaged fps(), it keeps a
+// histogram of every frame time and of named phases within frames, both
+// over the whole run and over a sliding window of the last WINDOW_SLICES
+// seconds, and counts hitches: frames or phases longer than hitchMs.
 class Timer {
 public:
+    static constexpr int WINDOW_SLICES = 10;
+    static constexpr float SLICE_SECONDS = 1.0f;
+
+    struct Stats {
+        uint64_t count = 0;
+        uint64_t hitches = 0;
+        float p50 = 0.0f, p95 = 0.0f, p99 = 0.0f, max = 0.0f; // milliseconds
+    };
+
+    // Times the rest of a scope into the phase it was made for
+    class Phase {
+    public:
+        Phase(Timer& timer, const char* name) : m_timer(timer), m_name(name), m_start(Clock::now()) {}
+        ~Phase() { m_timer.record(m_name, Clock::now() - m_start); }
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+    private:
+        Timer& m_timer;
+        const char* m_name;
+        std::chrono::high_resolution_clock::time_point m_start;
+    };
+
     Timer();
     void tick();
+    // Start the current frame over: the time since the last tick(), e.g. a
+    // stall that is not the frame's own work, counts toward no frame
+    void restartFrame() { m_lastTime = Clock::now(); }
     float deltaTime() const { return m_deltaTime; }
     float clampedDeltaTime(float maxDt = 0.1f) const;
     float totalTime() const;
     float fps() const { return m_fps; }
 
+    // `name` has to outlive the Timer; a literal, normally
+    Phase phase(const char* name) { return Phase(*this, name); }
+    void record(const char* name, std::chrono::nanoseconds duration);
+
+    // Over the sliding window; a phase never recorded has no samples
+    Stats frameStats() const { return windowStats(m_series[0]); }
+    Stats phaseStats(const char* name) const;
+    // Frames over the whole run
+    Stats runStats() const { return statsOf(m_series[0].total, m_series[0].hitches); }
+
+    // One row per series over the whole run: name, count, mean, p50, p90,
+    // p95, p99, p99.9 and max in milliseconds, then hitches
+    bool writeCsv(const std::string& filename) const;
+
+    float hitchMs = 1000.0f / 30.0f;
+
 private:
     using Clock = std::chrono::high_resolution_clock;
     using TimePoint = Clock::time_point;
-    
+
+    struct Series {
+        const char* name;
+        std::array<TimeHistogram, WINDOW_SLICES> slices{};
+        std::array<uint32_t, WINDOW_SLICES> sliceHitches{};
+        TimeHistogram total{};
+        uint64_t hitches = 0;
+    };
+
+    void add(Series& series, std::chrono::nanoseconds duration);
+    Stats windowStats(const Series& series) const;
+    static Stats statsOf(const TimeHistogram& histogram, uint64_t hitches);
+    void advanceWindow(TimePoint now);
+
     TimePoint m_startTime;
     TimePoint m_lastTime;
     float m_deltaTime = 0.016f;
     float m_fps = 60.0f;
     float m_fpsAccum = 0.0f;
     int m_frameCount = 0;
+    bool m_firstTick = true;
+
+    std::vector<Series> m_series; // frames first, then phases as they turn up
+    TimePoint m_sliceStart;
+    int m_slice = 0;
 };
 
 } // namespace myth
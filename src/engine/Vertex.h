@@ -0,0 +1,16 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+
+namespace myth {
+
+// Interleaved mesh vertex shared by terrain generation and the renderer.
+// The Vulkan input layout for it lives in vulkan/VulkanTypes.h.
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 color;
+    glm::vec2 texCoord;
+    glm::vec3 normal;
+};
+
+} // namespace myth
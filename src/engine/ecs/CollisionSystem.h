@@ -0,0 +1,465 @@
+﻿#pragma once
+
+#include "World.h"
+#include "core/JobSystem.h"
+#include "engine/math/SimdMath.h"
+#include "engine/spatial/SweepAndPrune.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace myth {
+namespace ecs {
+
+// Oriented and axis-aligned world boxes for `count` local boxes under their
+// matrices, W lanes at a time. Produces the same result as
+// WorldMatrix::transformObb() followed by Obb::bounds().
+inline void orientBoxes(const WorldMatrix* matrices, const Aabb* local, Obb* obbs, Aabb* bounds, size_t count) {
+    using V = simd::FloatN;
+    constexpr int W = V::Width;
+
+    // Lane-major scratch: 12 matrix + 6 box input columns; center, axes,
+    // half extents and box radius out
+    alignas(32) float src[18][W];
+    alignas(32) float dst[18][W];
+
+    for (size_t base = 0; base < count; base += W) {
+        const int n = static_cast<int>(std::min<size_t>(W, count - base));
+        for (int k = 0; k < W; k++) {
+            const size_t i = base + (k < n ? k : 0);
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 4; c++) src[r * 4 + c][k] = matrices[i].rows[r][c];
+            }
+            for (int a = 0; a < 3; a++) {
+                src[12 + a][k] = local[i].min[a];
+                src[15 + a][k] = local[i].max[a];
+            }
+        }
+
+        V m[12];
+        for (int j = 0; j < 12; j++) m[j] = V::load(src[j]);
+        V center[3], extent[3];
+        for (int a = 0; a < 3; a++) {
+            const V lo = V::load(src[12 + a]), hi = V::load(src[15 + a]);
+            center[a] = (lo + hi) * V(0.5f);
+            extent[a] = (hi - lo) * V(0.5f);
+        }
+        for (int r = 0; r < 3; r++) {
+            (m[r * 4] * center[0] + m[r * 4 + 1] * center[1] + m[r * 4 + 2] * center[2] + m[r * 4 + 3]).store(dst[r]);
+            (abs(m[r * 4]) * extent[0] + abs(m[r * 4 + 1]) * extent[1] + abs(m[r * 4 + 2]) * extent[2]).store(dst[15 + r]);
+        }
+        for (int c = 0; c < 3; c++) {
+            const V x = m[c], y = m[4 + c], z = m[8 + c];
+            const V length = sqrt(x * x + y * y + z * z);
+            const V valid = length > V(0.0f);
+            const V inv = V(1.0f) / select(valid, length, V(1.0f));
+            select(valid, x * inv, V(c == 0 ? 1.0f : 0.0f)).store(dst[3 + c * 3]);
+            select(valid, y * inv, V(c == 1 ? 1.0f : 0.0f)).store(dst[4 + c * 3]);
+            select(valid, z * inv, V(c == 2 ? 1.0f : 0.0f)).store(dst[5 + c * 3]);
+            (extent[c] * length).store(dst[12 + c]);
+        }
+
+        for (int k = 0; k < n; k++) {
+            Obb& o = obbs[base + k];
+            o.center = {dst[0][k], dst[1][k], dst[2][k]};
+            for (int c = 0; c < 3; c++) o.axes[c] = {dst[3 + c * 3][k], dst[4 + c * 3][k], dst[5 + c * 3][k]};
+            o.halfExtents = {dst[12][k], dst[13][k], dst[14][k]};
+            const glm::vec3 radius(dst[15][k], dst[16][k], dst[17][k]);
+            bounds[base + k] = {o.center - radius, o.center + radius};
+        }
+    }
+}
+
+struct Contact {
+    Entity a = NULL_ENTITY;
+    Entity b = NULL_ENTITY;
+    glm::vec3 normal = {0.0f, 1.0f, 0.0f}; // from a toward b
+    float depth = 0.0f;
+};
+
+// Collision for every entity with Collider + LocalBounds. update() syncs the
+// sweep-and-prune broadphase from changed WorldMatrix/LocalBounds/Collider
+// data and runs the OBB narrowphase on its pairs, producing contacts().
+// Pairs are kept between updates: a pair of bodies neither of which moved
+// keeps its narrowphase result, and only moved bodies look for overlaps
+// again, so an update costs in proportion to what moved.
+// resolveCharacters() moves CharacterControllers out of whatever they ran
+// into during the step.
+class CollisionSystem {
+public:
+    void update(World& world, JobSystem* jobs = nullptr) {
+        uint32_t closed = world.advanceVersion();
+        const auto colliders = world.colliders.view();
+        bool rebuild = colliders.size() != m_colliderCount;
+
+        // A body whose matrix and bounds both changed is queued once
+        m_dirty.clear();
+        auto refresh = [&](Entity e) {
+            uint32_t id = e < m_ids.size() ? m_ids[e] : UINT32_MAX;
+            if (id == UINT32_MAX) { rebuild = true; return; }
+            if (rebuild || m_queued[id]) return;
+            m_queued[id] = 1;
+            m_dirty.push_back(id);
+        };
+        colliders.changedSince(m_seenVersion, [&](Entity e, const Collider& c) {
+            uint32_t id = e < m_ids.size() ? m_ids[e] : UINT32_MAX;
+            if (id == UINT32_MAX || m_sap.isStatic(id) != c.isStatic) rebuild = true;
+            else refresh(e);
+        });
+        world.bounds.view().changedSince(m_seenVersion, [&](Entity e, const LocalBounds&) {
+            if (colliders.has(e)) refresh(e);
+        });
+        world.worldMatrices.view().changedSince(m_seenVersion, [&](Entity e, const WorldMatrix&) {
+            if (colliders.has(e)) refresh(e);
+        });
+        m_seenVersion = closed;
+
+        // Pairs are stored lower id first, which puts the dynamic body of a
+        // dynamic/static pair first as rebuild() numbers dynamic bodies first
+        size_t fresh = 0;
+        if (rebuild) {
+            for (uint32_t id : m_dirty) m_queued[id] = 0;
+            this->rebuild(world, jobs);
+            m_pairs.clear();
+            m_sap.findPairs([&](uint32_t a, uint32_t b) { m_pairs.push_back(a < b ? Pair{a, b} : Pair{b, a}); });
+        } else {
+            orient(world, m_dirty, jobs);
+            for (size_t i = 0; i < m_dirty.size(); i++) {
+                m_obbs[m_dirty[i]] = m_batchObbs[i];
+                m_sap.update(m_dirty[i], m_batchBounds[i]);
+            }
+            m_sap.sort();
+
+            // Keep the pairs of bodies that did not move, results and all
+            for (size_t i = 0; i < m_pairs.size(); i++) {
+                if (m_queued[m_pairs[i].a] || m_queued[m_pairs[i].b]) continue;
+                m_pairs[fresh] = m_pairs[i];
+                m_results[fresh] = m_results[i];
+                fresh++;
+            }
+            m_pairs.resize(fresh);
+            m_sap.findPairs([this](uint32_t id) { return m_queued[id] != 0; },
+                            [this](uint32_t a, uint32_t b) { m_pairs.push_back(a < b ? Pair{a, b} : Pair{b, a}); });
+            for (uint32_t id : m_dirty) m_queued[id] = 0;
+        }
+
+        // Narrowphase the new pairs into one slot each, so they can be split
+        // over the workers and the contacts still come out in pair order
+        m_results.resize(m_pairs.size());
+        const uint32_t newPairs = static_cast<uint32_t>(m_pairs.size() - fresh);
+        auto narrowphase = [this, fresh](uint32_t begin, uint32_t end) { this->narrowphase(fresh + begin, fresh + end); };
+        if (jobs) jobs->parallelFor(newPairs, PAIR_BATCH_SIZE, narrowphase);
+        else narrowphase(0, newPairs);
+
+        m_contacts.clear();
+        for (size_t i = 0; i < m_pairs.size(); i++) {
+            if (!m_results[i].hit) continue;
+            const Penetration& p = m_results[i].penetration;
+            m_contacts.push_back({m_entities[m_pairs[i].a], m_entities[m_pairs[i].b], p.normal, p.depth});
+        }
+    }
+
+    // Re-register every collider from scratch
+    void rebuild(World& world, JobSystem* jobs = nullptr) {
+        const auto colliders = world.colliders.view();
+        const Entity* dense = world.colliders.entities();
+        const size_t count = colliders.size();
+        std::vector<Entity> entities;
+        std::vector<uint8_t> isStatic;
+        for (size_t i = 0; i < count; i++) {
+            if (!world.bounds.has(dense[i])) continue;
+            entities.push_back(dense[i]);
+            isStatic.push_back(colliders.get(dense[i]).isStatic ? 1 : 0);
+        }
+        m_entities = entities;
+        m_dirty.resize(entities.size());
+        for (uint32_t id = 0; id < m_dirty.size(); id++) m_dirty[id] = id;
+        orient(world, m_dirty, jobs);
+
+        // Number ids in sweep order, dynamic before static, so the
+        // narrowphase reads m_obbs close to sequentially
+        const int axis = SweepAndPrune::chooseAxis(m_batchBounds);
+        std::vector<uint32_t> order(entities.size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            if (isStatic[a] != isStatic[b]) return isStatic[a] < isStatic[b];
+            return m_batchBounds[a].min[axis] < m_batchBounds[b].min[axis];
+        });
+
+        const size_t n = order.size();
+        std::vector<Aabb> bounds(n);
+        std::vector<uint8_t> ordered(n);
+        m_obbs.resize(n);
+        m_ids.assign(world.entities.capacity(), UINT32_MAX);
+        for (uint32_t id = 0; id < n; id++) {
+            m_entities[id] = entities[order[id]];
+            m_ids[m_entities[id]] = id;
+            m_obbs[id] = m_batchObbs[order[id]];
+            bounds[id] = m_batchBounds[order[id]];
+            ordered[id] = isStatic[order[id]];
+        }
+        m_queued.assign(n, 0);
+        m_sap.reset(bounds, ordered);
+        m_colliderCount = count;
+    }
+
+    // Sweep each character from where the last resolve left it to where
+    // motion put it, in steps no longer than its own half size so it cannot
+    // tunnel. At each step it is pushed out along the shallowest axis of the
+    // deepest overlap and loses the velocity driving it into the surface.
+    // Standing on a collider's top sets Gravity's ground to it.
+    void resolveCharacters(World& world) {
+        world.characterControllers.view().each([&](Entity e, const CharacterController& cc) {
+            const auto* transform = world.transforms.view().tryGet(e);
+            const auto* shape = world.bounds.view().tryGet(e);
+            if (!transform || !shape) return;
+
+            const glm::vec3 end = transform->position;
+            const bool continuous = cc.hasLastPosition && glm::distance(cc.lastPosition, end) < TELEPORT_DISTANCE;
+            const glm::vec3 start = continuous ? cc.lastPosition : end;
+            const Aabb local(shape->min * transform->scale, shape->max * transform->scale);
+
+            Aabb swept(glm::min(start, end) + local.min, glm::max(start, end) + local.max);
+            swept.min -= glm::vec3(cc.skinWidth + SUPPORT_PROBE);
+            swept.max += glm::vec3(cc.skinWidth);
+            m_candidates.clear();
+            m_sap.queryAabb(swept, [&](uint32_t id) { if (m_entities[id] != e) m_candidates.push_back(id); });
+
+            const auto* velocityIn = world.velocities.view().tryGet(e);
+            glm::vec3 velocity = velocityIn ? velocityIn->linear : glm::vec3(0.0f);
+            glm::vec3 pos = start;
+            bool supported = false;
+
+            const glm::vec3 size = local.max - local.min;
+            const float maxStep = 0.5f * std::max(std::min(size.x, std::min(size.y, size.z)), 0.01f);
+            const glm::vec3 delta = end - start;
+            const int steps = std::clamp(static_cast<int>(std::ceil(glm::length(delta) / maxStep)), 1, MAX_SUBSTEPS);
+            glm::vec3 stepDelta = delta / static_cast<float>(steps);
+
+            if (m_candidates.empty()) pos = end;
+            for (int s = 0; s < steps && !m_candidates.empty(); s++) {
+                pos += stepDelta;
+                for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+                    Penetration deepest;
+                    if (!deepestContact(Obb::fromAabb(Aabb(pos + local.min, pos + local.max)), deepest)) break;
+                    const glm::vec3 n = deepest.normal; // character -> obstacle
+                    pos -= n * (deepest.depth + cc.skinWidth);
+                    velocity -= n * std::max(glm::dot(velocity, n), 0.0f);
+                    stepDelta -= n * std::max(glm::dot(stepDelta, n), 0.0f);
+                    supported |= -n.y > SUPPORT_NORMAL_Y;
+                }
+            }
+
+            // Resting on a top face overlaps nothing; probe just below, and
+            // settle onto the surface if it is within reach
+            if (!supported && !m_candidates.empty() && velocity.y <= 0.0f) {
+                glm::vec3 probe = pos - glm::vec3(0.0f, SUPPORT_PROBE, 0.0f);
+                Penetration below;
+                if (deepestContact(Obb::fromAabb(Aabb(probe + local.min, probe + local.max)), below) &&
+                    -below.normal.y > SUPPORT_NORMAL_Y) {
+                    supported = true;
+                    pos.y -= std::max(SUPPORT_PROBE - below.depth - cc.skinWidth, 0.0f);
+                    velocity.y = 0.0f;
+                }
+            }
+
+            if (pos != end) world.transforms.get(e).position = pos;
+            if (velocityIn && velocity != velocityIn->linear) world.velocities.get(e).linear = velocity;
+            if (const auto* g = world.gravities.view().tryGet(e)) {
+                float ground = supported ? pos.y : cc.floorHeight;
+                if (g->groundHeight != ground || (supported && !g->grounded)) {
+                    Gravity& gravity = world.gravities.get(e);
+                    gravity.groundHeight = ground;
+                    gravity.grounded |= supported;
+                }
+            }
+            if (!cc.hasLastPosition || cc.lastPosition != pos) {
+                CharacterController& state = world.characterControllers.get(e);
+                state.lastPosition = pos;
+                state.hasLastPosition = true;
+            }
+        });
+    }
+
+    const std::vector<Contact>& contacts() const { return m_contacts; }
+
+    // Broadphase pairs as of the last update(), kept or new
+    size_t pairCount() const { return m_pairs.size(); }
+    size_t colliderCount() const { return m_entities.size(); }
+
+    // func(Entity) for every collider whose box overlaps `box`
+    template<typename Func>
+    void queryAabb(const Aabb& box, Func&& func) const {
+        m_sap.queryAabb(box, [&](uint32_t id) { func(m_entities[id]); });
+    }
+
+private:
+    static constexpr int MAX_SUBSTEPS = 16;
+    static constexpr int MAX_ITERATIONS = 4;
+    static constexpr float TELEPORT_DISTANCE = 10.0f;
+    static constexpr float SUPPORT_PROBE = 0.05f;
+    static constexpr float SUPPORT_NORMAL_Y = 0.7f; // about 45 degrees
+
+    static constexpr uint32_t BATCH_SIZE = 2048;
+    static constexpr uint32_t PAIR_BATCH_SIZE = 1024;
+
+    struct Pair { uint32_t a, b; };
+    struct PairResult {
+        Penetration penetration;
+        bool hit = false;
+    };
+
+    // World boxes of `ids` into m_batchObbs/m_batchBounds, in the same order
+    void orient(const World& world, const std::vector<uint32_t>& ids, JobSystem* jobs) {
+        const auto matrices = world.worldMatrices.view();
+        const auto bounds = world.bounds.view();
+        m_batchMatrices.resize(ids.size());
+        m_batchLocal.resize(ids.size());
+        m_batchObbs.resize(ids.size());
+        m_batchBounds.resize(ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+            const Entity e = m_entities[ids[i]];
+            const auto* m = matrices.tryGet(e);
+            m_batchMatrices[i] = m ? *m : WorldMatrix{};
+            m_batchLocal[i] = bounds.get(e).box();
+        }
+
+        uint32_t count = static_cast<uint32_t>(ids.size());
+        if (jobs) {
+            jobs->parallelFor(count, BATCH_SIZE, [this](uint32_t begin, uint32_t end) {
+                orientBoxes(&m_batchMatrices[begin], &m_batchLocal[begin], &m_batchObbs[begin], &m_batchBounds[begin], end - begin);
+            });
+        } else {
+            orientBoxes(m_batchMatrices.data(), m_batchLocal.data(), m_batchObbs.data(), m_batchBounds.data(), count);
+        }
+    }
+
+    // intersect() for pairs [begin, end), W at a time with one pair per
+    // lane, so no axis test branches. Every axis is tested in the same
+    // order and with the same arithmetic as intersect(), so the results
+    // match it exactly.
+    void narrowphase(size_t begin, size_t end) {
+        using V = simd::FloatN;
+        constexpr int W = V::Width;
+        constexpr float PARALLEL_EPSILON = 1e-6f;
+        constexpr float EDGE_BIAS = 1.05f;
+
+        // Lane-major scratch: the fields of a, then of b, in Obb's order
+        static_assert(sizeof(Obb) == 15 * sizeof(float));
+        alignas(32) float src[30][W];
+        alignas(32) float dst[4][W];
+
+        for (size_t base = begin; base < end; base += W) {
+            const int n = static_cast<int>(std::min<size_t>(W, end - base));
+            for (int k = 0; k < W; k++) {
+                const Pair& pair = m_pairs[base + (k < n ? k : 0)];
+                for (int box = 0; box < 2; box++) {
+                    float fields[15];
+                    std::memcpy(fields, &m_obbs[box == 0 ? pair.a : pair.b], sizeof(fields));
+                    for (int f = 0; f < 15; f++) src[box * 15 + f][k] = fields[f];
+                }
+            }
+
+            V A[3][3], B[3][3], ha[3], hb[3], d[3];
+            for (int c = 0; c < 3; c++) {
+                d[c] = V::load(src[15 + c]) - V::load(src[c]);
+                ha[c] = V::load(src[12 + c]);
+                hb[c] = V::load(src[27 + c]);
+                for (int a = 0; a < 3; a++) {
+                    A[a][c] = V::load(src[3 + a * 3 + c]);
+                    B[a][c] = V::load(src[18 + a * 3 + c]);
+                }
+            }
+            V R[3][3], absR[3][3], t[3];
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                    R[i][j] = A[i][0] * B[j][0] + A[i][1] * B[j][1] + A[i][2] * B[j][2];
+                    absR[i][j] = abs(R[i][j]) + V(PARALLEL_EPSILON);
+                }
+                t[i] = d[0] * A[i][0] + d[1] * A[i][1] + d[2] * A[i][2];
+            }
+
+            V separated(0.0f), flip(0.0f), best(FLT_MAX);
+            V axis[3] = {V(0.0f), V(1.0f), V(0.0f)};
+            auto consider = [&](V better, V depth, const V (&candidate)[3], V negative) {
+                best = select(better, depth, best);
+                for (int c = 0; c < 3; c++) axis[c] = select(better, candidate[c], axis[c]);
+                flip = select(better, negative, flip);
+            };
+            for (int i = 0; i < 3; i++) {
+                V rb = hb[0] * absR[i][0] + hb[1] * absR[i][1] + hb[2] * absR[i][2];
+                V overlap = ha[i] + rb - abs(t[i]);
+                separated = separated | (overlap < V(0.0f));
+                consider(overlap < best, overlap, A[i], t[i] < V(0.0f));
+            }
+            for (int j = 0; j < 3; j++) {
+                V ra = ha[0] * absR[0][j] + ha[1] * absR[1][j] + ha[2] * absR[2][j];
+                V distance = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+                V overlap = ra + hb[j] - abs(distance);
+                separated = separated | (overlap < V(0.0f));
+                consider(overlap < best, overlap, B[j], distance < V(0.0f));
+            }
+            for (int i = 0; i < 3; i++) {
+                const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+                for (int j = 0; j < 3; j++) {
+                    const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+                    V lengthSq = V(1.0f) - R[i][j] * R[i][j];
+                    V edge = lengthSq >= V(PARALLEL_EPSILON); // else parallel, covered by the face axes
+                    V ra = ha[i1] * absR[i2][j] + ha[i2] * absR[i1][j];
+                    V rb = hb[j1] * absR[i][j2] + hb[j2] * absR[i][j1];
+                    V distance = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+                    V overlap = ra + rb - abs(distance);
+                    separated = separated | (edge & (overlap < V(0.0f)));
+                    V better = edge & (overlap * overlap * V(EDGE_BIAS * EDGE_BIAS) < best * best * lengthSq);
+                    if (movemask(better) == 0) continue;
+                    V invLength = V(1.0f) / sqrt(select(edge, lengthSq, V(1.0f)));
+                    const V cross[3] = {(A[i][1] * B[j][2] - B[j][1] * A[i][2]) * invLength,
+                                        (A[i][2] * B[j][0] - B[j][2] * A[i][0]) * invLength,
+                                        (A[i][0] * B[j][1] - B[j][0] * A[i][1]) * invLength};
+                    consider(better, overlap * invLength, cross, distance < V(0.0f));
+                }
+            }
+
+            for (int c = 0; c < 3; c++) select(flip, -axis[c], axis[c]).store(dst[c]);
+            best.store(dst[3]);
+            const int hits = ~movemask(separated);
+            for (int k = 0; k < n; k++) {
+                PairResult& result = m_results[base + k];
+                result.hit = (hits >> k) & 1;
+                result.penetration = {{dst[0][k], dst[1][k], dst[2][k]}, dst[3][k]};
+            }
+        }
+    }
+
+    bool deepestContact(const Obb& box, Penetration& deepest) const {
+        bool found = false;
+        for (uint32_t id : m_candidates) {
+            Penetration p;
+            if (intersect(box, m_obbs[id], &p) && (!found || p.depth > deepest.depth)) {
+                deepest = p;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    SweepAndPrune m_sap;
+    std::vector<Entity> m_entities; // id -> entity
+    std::vector<uint32_t> m_ids;    // entity -> id
+    std::vector<Obb> m_obbs;
+    std::vector<uint32_t> m_dirty;  // ids to re-orient this update
+    std::vector<uint8_t> m_queued;  // id -> already in m_dirty
+    std::vector<WorldMatrix> m_batchMatrices;
+    std::vector<Aabb> m_batchLocal;
+    std::vector<Obb> m_batchObbs;
+    std::vector<Aabb> m_batchBounds;
+    std::vector<Pair> m_pairs;      // broadphase pairs of the last update
+    std::vector<PairResult> m_results; // narrowphase result per pair
+    std::vector<Contact> m_contacts;
+    std::vector<uint32_t> m_candidates;
+    size_t m_colliderCount = 0;     // colliders seen by the last rebuild, with or without bounds
+    uint32_t m_seenVersion = 0;
+};
+
+} // namespace ecs
+} // namespace myth
@@ -0,0 +1,176 @@
+﻿#pragma once
+
+#include "World.h"
+#include "core/JobSystem.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <span>
+#include <tuple>
+#include <vector>
+
+namespace myth {
+namespace ecs {
+
+// Records structural changes (create, destroy, add/remove component) into flat
+// memory so they can be made from any thread and applied later at a sync point.
+// Entities returned by create() are placeholders until playback() resolves them
+// and are only meaningful to the buffer that handed them out.
+class EntityCommandBuffer {
+public:
+    static constexpr Entity DEFERRED_BIT = 0x80000000u;
+
+    static bool isDeferred(Entity e) {
+        return e != NULL_ENTITY && (e & DEFERRED_BIT) != 0;
+    }
+
+    Entity create() {
+        assert(m_createCount < DEFERRED_BIT - 1);
+        return DEFERRED_BIT | m_createCount++;
+    }
+
+    void destroy(Entity e) {
+        m_destroys.push_back(e);
+    }
+
+    template<typename T>
+    void add(Entity e, const T& component) {
+        stream<T>().push_back({e, false, component});
+        m_componentCommands++;
+    }
+
+    template<typename T>
+    void remove(Entity e) {
+        stream<T>().push_back({e, true, T{}});
+        m_componentCommands++;
+    }
+
+    size_t commandCount() const { return m_createCount + m_destroys.size() + m_componentCommands; }
+    bool empty() const { return commandCount() == 0; }
+
+    void clear() {
+        std::apply([](auto&... streams) { (streams.clear(), ...); }, m_streams);
+        m_destroys.clear();
+        m_createCount = 0;
+        m_componentCommands = 0;
+    }
+
+    // Apply every buffer to the world and clear them. Creates run first, then
+    // component commands type by type so each pool is grown and touched
+    // once, then destroys. Commands on the same component keep record order.
+    static void playback(World& world, std::span<EntityCommandBuffer> buffers);
+
+private:
+    template<typename T>
+    struct Command {
+        Entity entity;
+        bool remove;
+        T component; // for an add
+    };
+
+    template<typename List>
+    struct Streams;
+    template<typename... Ts>
+    struct Streams<ComponentList<Ts...>> {
+        using type = std::tuple<std::vector<Command<Ts>>...>;
+    };
+
+    template<typename T>
+    std::vector<Command<T>>& stream() { return std::get<componentTypeId<T>()>(m_streams); }
+
+    // Component commands are kept apart by type as they are recorded, so
+    // playback reads each type's in order with nothing to sort
+    Streams<ComponentTypes>::type m_streams;
+    std::vector<Entity> m_destroys;
+    uint32_t m_createCount = 0;
+    size_t m_componentCommands = 0;
+};
+
+// One command buffer per JobSystem thread plus one for the calling thread, so
+// jobs can record without locking.
+class EntityCommandBuffers {
+public:
+    explicit EntityCommandBuffers(const JobSystem& jobs)
+        : m_jobs(&jobs), m_buffers(jobs.threadCount() + 1) {}
+
+    EntityCommandBuffer& local() { return m_buffers[m_jobs->currentThreadIndex()]; }
+
+    void playback(World& world) { EntityCommandBuffer::playback(world, m_buffers); }
+
+private:
+    const JobSystem* m_jobs;
+    std::vector<EntityCommandBuffer> m_buffers;
+};
+
+// ========================= Implementation ===================================
+
+inline void EntityCommandBuffer::playback(World& world, std::span<EntityCommandBuffer> buffers) {
+    // Resolve placeholders: each buffer's creates map to a contiguous run
+    size_t createTotal = 0;
+    for (const auto& b : buffers) createTotal += b.m_createCount;
+    world.entities.reserve(world.entities.capacity() + createTotal);
+
+    std::vector<Entity> created;
+    std::vector<size_t> firstCreated(buffers.size());
+    created.reserve(createTotal);
+    for (size_t i = 0; i < buffers.size(); i++) {
+        firstCreated[i] = created.size();
+        for (uint32_t k = 0; k < buffers[i].m_createCount; k++) created.push_back(world.entities.create());
+    }
+
+    auto resolve = [&](size_t buffer, Entity e) {
+        return isDeferred(e) ? created[firstCreated[buffer] + (e & ~DEFERRED_BIT)] : e;
+    };
+
+    std::vector<Entity> fresh;
+
+    // Per type, buffer by buffer: the order commands were recorded in within
+    // a buffer, and buffers in order
+    [&]<typename... Ts>(ComponentList<Ts...>) {
+        ([&] {
+            size_t commands = 0;
+            for (auto& b : buffers) commands += b.stream<Ts>().size();
+            if (commands == 0) return;
+
+            auto& components = world.storage<Ts>();
+            components.reserve(components.size() + commands, world.entities.capacity());
+            for (size_t i = 0; i < buffers.size(); i++) {
+                const std::vector<Command<Ts>>& stream = buffers[i].stream<Ts>();
+                for (size_t k = 0; k < stream.size();) {
+                    // Adds to entities created here, in creation order, as a
+                    // spawn records them: they go in with one extend()
+                    size_t end = k;
+                    while (end < stream.size() && !stream[end].remove && isDeferred(stream[end].entity) &&
+                           (end == k || stream[end].entity > stream[end - 1].entity)) end++;
+                    if (end - k > 1) {
+                        fresh.clear();
+                        for (size_t c = k; c < end; c++) fresh.push_back(resolve(i, stream[c].entity));
+                        if (std::none_of(fresh.begin(), fresh.end(), [&](Entity e) { return components.has(e); })) {
+                            Ts* out = components.extend(fresh.data(), fresh.size());
+                            for (size_t c = k; c < end; c++) out[c - k] = stream[c].component;
+                            k = end;
+                            continue;
+                        }
+                    }
+
+                    const Command<Ts>& c = stream[k++];
+                    Entity e = resolve(i, c.entity);
+                    if (!world.entities.isAlive(e)) continue;
+                    if (c.remove) components.remove(e);
+                    else components.add(e, c.component);
+                }
+            }
+        }(), ...);
+    }(ComponentTypes{});
+
+    std::vector<Entity> destroyed;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        for (Entity e : buffers[i].m_destroys) destroyed.push_back(resolve(i, e));
+    }
+    world.destroyEntities(destroyed);
+
+    for (auto& b : buffers) b.clear();
+}
+
+} // namespace ecs
+} // namespace myth
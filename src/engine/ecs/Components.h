@@ -2,6 +2,8 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "engine/math/Bounds.h"
+#include "engine/math/Obb.h"
 
 namespace myth {
 namespace ecs {
@@ -22,12 +24,98 @@ struct Transform {
     }
 };
 
+// Cached affine world matrix: rows of [R*S | t], i.e. the top three rows of
+// Transform::getMatrix(). Filled from Transform by WorldMatrixSystem.
+struct WorldMatrix {
+    glm::vec4 rows[3] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+    
+    glm::mat4 toMat4() const {
+        return glm::transpose(glm::mat4(rows[0], rows[1], rows[2], glm::vec4(0, 0, 0, 1)));
+    }
+    
+    glm::vec3 translation() const { return {rows[0].w, rows[1].w, rows[2].w}; }
+    
+    glm::vec3 transformPoint(const glm::vec3& p) const {
+        glm::vec4 h(p, 1.0f);
+        return {glm::dot(rows[0], h), glm::dot(rows[1], h), glm::dot(rows[2], h)};
+    }
+    
+    glm::vec3 transformDirection(const glm::vec3& d) const {
+        return {glm::dot(glm::vec3(rows[0]), d), glm::dot(glm::vec3(rows[1]), d), glm::dot(glm::vec3(rows[2]), d)};
+    }
+    
+    // Box enclosing `local` after transformation
+    Aabb transformBounds(const Aabb& local) const {
+        glm::vec3 c = transformPoint(local.center());
+        glm::vec3 e = local.extent();
+        glm::vec3 r(glm::dot(glm::abs(glm::vec3(rows[0])), e),
+                    glm::dot(glm::abs(glm::vec3(rows[1])), e),
+                    glm::dot(glm::abs(glm::vec3(rows[2])), e));
+        return {c - r, c + r};
+    }
+    
+    // Oriented box for `local` after transformation
+    Obb transformObb(const Aabb& local) const {
+        Obb o;
+        o.center = transformPoint(local.center());
+        glm::vec3 e = local.extent();
+        for (int c = 0; c < 3; c++) {
+            glm::vec3 column(rows[0][c], rows[1][c], rows[2][c]);
+            float length = glm::length(column);
+            o.axes[c] = length > 0.0f ? column / length : glm::vec3(c == 0, c == 1, c == 2);
+            o.halfExtents[c] = e[c] * length;
+        }
+        return o;
+    }
+    
+    WorldMatrix inverse() const {
+        glm::mat3 a = glm::transpose(glm::mat3(glm::vec3(rows[0]), glm::vec3(rows[1]), glm::vec3(rows[2])));
+        glm::mat3 inv = glm::inverse(a);
+        glm::vec3 t = -(inv * translation());
+        WorldMatrix m;
+        for (int r = 0; r < 3; r++) m.rows[r] = glm::vec4(inv[0][r], inv[1][r], inv[2][r], t[r]);
+        return m;
+    }
+};
+
+// Local-space box around an entity's mesh, placed in the world by its
+// WorldMatrix. Entities with bounds are indexed by SpatialIndex.
+struct LocalBounds {
+    glm::vec3 min = {-0.5f, -0.5f, -0.5f};
+    glm::vec3 max = {0.5f, 0.5f, 0.5f};
+    
+    Aabb box() const { return {min, max}; }
+};
+
 // Velocity component for physics
 struct Velocity {
     glm::vec3 linear = {0.0f, 0.0f, 0.0f};
     glm::vec3 angular = {0.0f, 0.0f, 0.0f};
 };
 
+// Constant downward acceleration with a flat ground plane to land on.
+// Entities with Velocity but no Gravity move ballistically.
+struct Gravity {
+    float acceleration = 20.0f;
+    float groundHeight = 0.0f;
+    bool grounded = true;
+};
+
+// Solid for CollisionSystem, shaped by the entity's LocalBounds. Static
+// colliders are expected not to move and never collide with each other.
+struct Collider {
+    bool isStatic = true;
+};
+
+// Moves with its Velocity like any body, then CollisionSystem pushes it out
+// of colliders along its path and slides it along what it touched
+struct CharacterController {
+    float skinWidth = 0.01f;
+    float floorHeight = 0.0f;              // Gravity ground when not standing on a collider
+    glm::vec3 lastPosition = {0.0f, 0.0f, 0.0f}; // where the previous resolve left it
+    bool hasLastPosition = false;
+};
+
 // Renderable component - references mesh data
 struct Renderable {
     uint32_t meshId = 0;        // Which mesh to render
@@ -42,9 +130,7 @@ struct PlayerController {
     float moveSpeed = 10.0f;
     float turnSmoothSpeed = 10.0f;
     float jumpForce = 8.0f;
-    float gravity = 20.0f;
     float targetYaw = 0.0f;
-    bool isGrounded = true;
 };
 
 // Third person camera component
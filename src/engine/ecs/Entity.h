@@ -1,9 +1,13 @@
 ﻿#pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
-#include <queue>
+#include <deque>
+#include <span>
 #include <cassert>
+#include <algorithm>
+#include <utility>
 
 namespace myth {
 namespace ecs {
@@ -17,7 +21,7 @@ public:
         Entity e;
         if (!m_freeList.empty()) {
             e = m_freeList.front();
-            m_freeList.pop();
+            m_freeList.pop_front();
             m_generations[e]++;
         } else {
             e = static_cast<Entity>(m_generations.size());
@@ -32,7 +36,7 @@ public:
     void destroy(Entity e) {
         if (e < m_alive.size() && m_alive[e]) {
             m_alive[e] = false;
-            m_freeList.push(e);
+            m_freeList.push_back(e);
             m_count--;
         }
     }
@@ -44,23 +48,81 @@ public:
     size_t count() const { return m_count; }
     size_t capacity() const { return m_generations.size(); }
     
+    void reserve(size_t n) {
+        m_generations.reserve(n);
+        m_alive.reserve(n);
+    }
+    
     template<typename Func>
     void each(Func&& func) {
         for (Entity e = 0; e < m_alive.size(); e++) {
             if (m_alive[e]) func(e);
         }
     }
+    
+    // ---- Snapshots ----
+    
+    // Times each id has been reused, indexed by id; capacity() entries
+    std::span<const uint32_t> generations() const { return m_generations; }
+    // Destroyed ids in the order create() will reuse them
+    const std::deque<Entity>& freeList() const { return m_freeList; }
+    
+    // Take over a saved allocator state: every id below generations.size()
+    // not on the free list is alive. The caller checks that free ids are
+    // in range and distinct.
+    void restore(std::span<const uint32_t> generations, std::span<const Entity> freeList) {
+        m_generations.assign(generations.begin(), generations.end());
+        m_alive.assign(generations.size(), true);
+        m_freeList.assign(freeList.begin(), freeList.end());
+        for (Entity e : freeList) m_alive[e] = false;
+        m_count = generations.size() - freeList.size();
+    }
 
 private:
     std::vector<uint32_t> m_generations;
     std::vector<bool> m_alive;
-    std::queue<Entity> m_freeList;
+    std::deque<Entity> m_freeList;
     size_t m_count = 0;
 };
 
+template<typename T>
+class ComponentArray;
+
+// Read-only window onto a ComponentArray. Reading through a view never marks
+// anything as changed, so consumers of change tracking should use it.
+template<typename T>
+class ComponentView {
+public:
+    explicit ComponentView(const ComponentArray<T>& components) : m_components(&components) {}
+    
+    bool has(Entity e) const { return m_components->has(e); }
+    const T& get(Entity e) const { return m_components->get(e); }
+    const T* tryGet(Entity e) const { return m_components->tryGet(e); }
+    size_t size() const { return m_components->size(); }
+    
+    template<typename Func>
+    void each(Func&& func) const { m_components->each(std::forward<Func>(func)); }
+    
+    // Visit entries whose change version is newer than `version`.
+    // Blocks with no newer entry are skipped without touching their entries.
+    template<typename Func>
+    void changedSince(uint32_t version, Func&& func) const {
+        m_components->changedSince(version, std::forward<Func>(func));
+    }
+
+private:
+    const ComponentArray<T>* m_components;
+};
+
+// Sparse set with per-entry change versions. Every mutable access (add,
+// non-const get/tryGet/each, markChanged) stamps the entry with the array's
+// current version; the highest stamp per block of entries is kept as well so
+// change queries can skip untouched ranges.
 template<typename T>
 class ComponentArray {
 public:
+    static constexpr size_t VERSION_BLOCK = 64;
+    
     void add(Entity e, const T& component) {
         if (e >= m_sparse.size()) {
             m_sparse.resize(e + 1, UINT32_MAX);
@@ -69,8 +131,12 @@ public:
             m_sparse[e] = static_cast<uint32_t>(m_dense.size());
             m_dense.push_back(e);
             m_components.push_back(component);
+            m_versions.push_back(m_version);
+            if (m_blockVersions.size() * VERSION_BLOCK < m_dense.size()) m_blockVersions.push_back(m_version);
+            else m_blockVersions.back() = m_version;
         } else {
             m_components[m_sparse[e]] = component;
+            stamp(m_sparse[e]);
         }
     }
     
@@ -86,7 +152,12 @@ public:
         
         m_dense.pop_back();
         m_components.pop_back();
+        m_versions.pop_back();
         m_sparse[e] = UINT32_MAX;
+        
+        // The moved entry now lives at a new index
+        if (idx < m_dense.size()) stamp(idx);
+        m_blockVersions.resize((m_dense.size() + VERSION_BLOCK - 1) / VERSION_BLOCK);
     }
     
     bool has(Entity e) const {
@@ -95,6 +166,7 @@ public:
     
     T& get(Entity e) {
         assert(has(e));
+        stamp(m_sparse[e]);
         return m_components[m_sparse[e]];
     }
     
@@ -104,20 +176,64 @@ public:
     }
     
     T* tryGet(Entity e) {
-        return has(e) ? &m_components[m_sparse[e]] : nullptr;
+        if (!has(e)) return nullptr;
+        stamp(m_sparse[e]);
+        return &m_components[m_sparse[e]];
     }
     
     const T* tryGet(Entity e) const {
         return has(e) ? &m_components[m_sparse[e]] : nullptr;
     }
     
+    // Bulk insert for loaders: give each of `count` entities, none of
+    // which has this component yet, a default T stamped as add() would,
+    // and return the first of the new, contiguous entries to fill in
+    T* extend(const Entity* entities, size_t count) {
+        const size_t first = m_dense.size();
+        if (count > 0) {
+            const Entity highest = *std::max_element(entities, entities + count);
+            if (highest >= m_sparse.size()) m_sparse.resize(size_t(highest) + 1, UINT32_MAX);
+        }
+        m_dense.insert(m_dense.end(), entities, entities + count);
+        m_components.resize(first + count);
+        m_versions.resize(first + count, m_version);
+        for (size_t i = 0; i < count; i++) {
+            assert(m_sparse[entities[i]] == UINT32_MAX);
+            m_sparse[entities[i]] = static_cast<uint32_t>(first + i);
+        }
+        m_blockVersions.resize((m_dense.size() + VERSION_BLOCK - 1) / VERSION_BLOCK);
+        for (size_t b = first / VERSION_BLOCK; b < m_blockVersions.size(); b++) m_blockVersions[b] = m_version;
+        return m_components.data() + first;
+    }
+    
+    // Drop every entry; the version carries on
+    void clear() {
+        m_sparse.clear();
+        m_dense.clear();
+        m_components.clear();
+        m_versions.clear();
+        m_blockVersions.clear();
+    }
+    
+    ComponentView<T> view() const { return ComponentView<T>(*this); }
+    
     size_t size() const { return m_dense.size(); }
     
+    // Pre-size storage for a bulk insert so add() never reallocates mid-batch
+    void reserve(size_t count, size_t entityCapacity = 0) {
+        m_dense.reserve(count);
+        m_components.reserve(count);
+        m_versions.reserve(count);
+        if (entityCapacity > m_sparse.size()) m_sparse.resize(entityCapacity, UINT32_MAX);
+    }
+    
     template<typename Func>
     void each(Func&& func) {
         for (size_t i = 0; i < m_dense.size(); i++) {
+            m_versions[i] = m_version;
             func(m_dense[i], m_components[i]);
         }
+        for (auto& v : m_blockVersions) v = m_version;
     }
     
     template<typename Func>
@@ -126,11 +242,78 @@ public:
             func(m_dense[i], m_components[i]);
         }
     }
+    
+    // Raw dense access for batch systems. Writes through data() are not
+    // tracked; follow them with markChangedAt() on this thread.
+    T* data() { return m_components.data(); }
+    const T* data() const { return m_components.data(); }
+    const Entity* entities() const { return m_dense.data(); }
+    
+    uint32_t indexOf(Entity e) const {
+        return has(e) ? m_sparse[e] : UINT32_MAX;
+    }
+    
+    // ---- Change tracking ----
+    
+    // Stamp applied to entries mutated from now on
+    uint32_t version() const { return m_version; }
+    void setVersion(uint32_t version) { m_version = version; }
+    
+    void markChanged(Entity e) {
+        if (has(e)) stamp(m_sparse[e]);
+    }
+    
+    void markChangedAt(uint32_t idx) {
+        stamp(idx);
+    }
+    
+    uint32_t changeVersion(Entity e) const {
+        return has(e) ? m_versions[m_sparse[e]] : 0;
+    }
+    
+    template<typename Func>
+    void changedSince(uint32_t version, Func&& func) const {
+        for (size_t b = 0; b < m_blockVersions.size(); b++) {
+            if (m_blockVersions[b] <= version) continue;
+            size_t end = std::min(m_dense.size(), (b + 1) * VERSION_BLOCK);
+            for (size_t i = b * VERSION_BLOCK; i < end; i++) {
+                if (m_versions[i] > version) func(m_dense[i], m_components[i]);
+            }
+        }
+    }
 
 private:
+    void stamp(uint32_t idx) {
+        m_versions[idx] = m_version;
+        m_blockVersions[idx / VERSION_BLOCK] = m_version;
+    }
+    
     std::vector<uint32_t> m_sparse;
     std::vector<Entity> m_dense;
     std::vector<T> m_components;
+    std::vector<uint32_t> m_versions;
+    std::vector<uint32_t> m_blockVersions;
+    uint32_t m_version = 1;
+};
+
+// Compile-time list of component types. A type's position in the list is its
+// ComponentTypeId, used wherever components are handled generically.
+template<typename... Ts>
+struct ComponentList {
+    static constexpr size_t size = sizeof...(Ts);
+};
+
+template<typename T, typename List>
+struct ComponentIndex;
+
+template<typename T, typename... Ts>
+struct ComponentIndex<T, ComponentList<T, Ts...>> {
+    static constexpr uint16_t value = 0;
+};
+
+template<typename T, typename U, typename... Ts>
+struct ComponentIndex<T, ComponentList<U, Ts...>> {
+    static constexpr uint16_t value = 1 + ComponentIndex<T, ComponentList<Ts...>>::value;
 };
 
 } // namespace ecs
@@ -0,0 +1,183 @@
+﻿#pragma once
+
+#include "World.h"
+#include "core/JobSystem.h"
+#include "engine/math/SimdMath.h"
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+namespace myth {
+namespace ecs {
+
+// Structure-of-arrays view of the integration state for a batch of entities.
+// Each pointer addresses one column; lane i of every column is one entity.
+struct MotionColumns {
+    float* px; float* py; float* pz;     // Transform::position
+    float* rx; float* ry; float* rz;     // Transform::rotation (degrees)
+    float* vx; float* vy; float* vz;     // Velocity::linear
+    float* wx; float* wy; float* wz;     // Velocity::angular (degrees/s)
+    float* gravity;                      // Gravity::acceleration, 0 without Gravity
+    float* ground;                       // Gravity::groundHeight, -FLT_MAX without Gravity
+    float* grounded;                     // 1.0 when resting on the ground, else 0.0
+    float* moved;                        // out: 1.0 when the transform changed
+};
+
+// Semi-implicit Euler step over `count` lanes. Gravity only applies to lanes
+// that are airborne, and landing clamps height and vertical speed; both are
+// mask selects, so there are no per-entity branches.
+inline void integrateMotion(const MotionColumns& c, size_t count, float dt) {
+    using V = simd::FloatN;
+    constexpr int W = V::Width;
+    const V vdt(dt), zero(0.0f), one(1.0f);
+
+    size_t i = 0;
+    for (; i + W <= count; i += W) {
+        V vx = V::load(c.vx + i), vy = V::load(c.vy + i), vz = V::load(c.vz + i);
+        const V wx = V::load(c.wx + i), wy = V::load(c.wy + i), wz = V::load(c.wz + i);
+        const V airborne = V::load(c.grounded + i) == zero;
+
+        vy = vy - (V::load(c.gravity + i) * vdt & airborne);
+
+        const V px = V::load(c.px + i) + vx * vdt;
+        const V py = V::load(c.py + i) + vy * vdt;
+        const V pz = V::load(c.pz + i) + vz * vdt;
+        (V::load(c.rx + i) + wx * vdt).store(c.rx + i);
+        (V::load(c.ry + i) + wy * vdt).store(c.ry + i);
+        (V::load(c.rz + i) + wz * vdt).store(c.rz + i);
+
+        const V ground = V::load(c.ground + i);
+        const V below = py <= ground;
+        const V yOld = V::load(c.py + i);
+        const V yNew = select(below, ground, py);
+        const V moving = (vx != zero) | (vy != zero) | (vz != zero) |
+                         (wx != zero) | (wy != zero) | (wz != zero) | (yNew != yOld);
+
+        px.store(c.px + i);
+        yNew.store(c.py + i);
+        pz.store(c.pz + i);
+        vx.store(c.vx + i);
+        select(below, zero, vy).store(c.vy + i);
+        vz.store(c.vz + i);
+        (below & one).store(c.grounded + i);
+        (moving & one).store(c.moved + i);
+    }
+
+    // Scalar tail, same math
+    for (; i < count; i++) {
+        if (c.grounded[i] == 0.0f) c.vy[i] -= c.gravity[i] * dt;
+        float yOld = c.py[i];
+        c.px[i] += c.vx[i] * dt;
+        c.py[i] += c.vy[i] * dt;
+        c.pz[i] += c.vz[i] * dt;
+        c.rx[i] += c.wx[i] * dt;
+        c.ry[i] += c.wy[i] * dt;
+        c.rz[i] += c.wz[i] * dt;
+        bool below = c.py[i] <= c.ground[i];
+        if (below) { c.py[i] = c.ground[i]; }
+        bool moving = c.vx[i] != 0.0f || c.vy[i] != 0.0f || c.vz[i] != 0.0f ||
+                      c.wx[i] != 0.0f || c.wy[i] != 0.0f || c.wz[i] != 0.0f || c.py[i] != yOld;
+        if (below) c.vy[i] = 0.0f;
+        c.grounded[i] = below ? 1.0f : 0.0f;
+        c.moved[i] = moving ? 1.0f : 0.0f;
+    }
+}
+
+// Integrates every entity with Transform + Velocity. Component data is
+// gathered into SoA columns per job chunk, stepped with integrateMotion() and
+// scattered back; change versions are stamped afterwards on the calling
+// thread, only for entities that actually moved.
+class MotionSystem {
+public:
+    void update(World& world, float dt, JobSystem* jobs = nullptr) {
+        const uint32_t count = static_cast<uint32_t>(world.velocities.size());
+        if (count == 0) return;
+        resize(count);
+
+        auto chunk = [&](uint32_t begin, uint32_t end) { step(world, dt, begin, end); };
+        if (jobs) jobs->parallelFor(count, CHUNK_SIZE, chunk);
+        else chunk(0, count);
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (m_transformIndex[i] == UINT32_MAX || m_moved[i] == 0.0f) continue;
+            world.transforms.markChangedAt(m_transformIndex[i]);
+            world.velocities.markChangedAt(i);
+        }
+    }
+
+private:
+    static constexpr uint32_t CHUNK_SIZE = 4096;
+    static constexpr int COLUMN_COUNT = 15;
+
+    void resize(uint32_t count) {
+        if (m_transformIndex.size() == count) return;
+        m_transformIndex.resize(count);
+        m_gravityIndex.resize(count);
+        m_columns.resize(static_cast<size_t>(count) * COLUMN_COUNT);
+        m_moved.resize(count);
+    }
+
+    MotionColumns columns(uint32_t begin) {
+        const size_t n = m_transformIndex.size();
+        float* base = m_columns.data() + begin;
+        auto col = [&](int k) { return base + k * n; };
+        return {col(0), col(1), col(2), col(3), col(4), col(5), col(6), col(7), col(8),
+                col(9), col(10), col(11), col(12), col(13), col(14), m_moved.data() + begin};
+    }
+
+    void step(World& world, float dt, uint32_t begin, uint32_t end) {
+        const Entity* entities = world.velocities.entities();
+        Transform* transforms = world.transforms.data();
+        Velocity* velocities = world.velocities.data();
+        Gravity* gravities = world.gravities.data();
+        MotionColumns c = columns(begin);
+        const Transform detached{}; // stands in for a missing Transform
+
+        // Gather
+        for (uint32_t i = begin; i < end; i++) {
+            const uint32_t k = i - begin;
+            const uint32_t ti = world.transforms.indexOf(entities[i]);
+            const uint32_t gi = world.gravities.indexOf(entities[i]);
+            m_transformIndex[i] = ti;
+            m_gravityIndex[i] = gi;
+
+            const Transform& t = ti != UINT32_MAX ? transforms[ti] : detached;
+            const Velocity& v = velocities[i];
+            c.px[k] = t.position.x; c.py[k] = t.position.y; c.pz[k] = t.position.z;
+            c.rx[k] = t.rotation.x; c.ry[k] = t.rotation.y; c.rz[k] = t.rotation.z;
+            c.vx[k] = v.linear.x;   c.vy[k] = v.linear.y;   c.vz[k] = v.linear.z;
+            c.wx[k] = v.angular.x;  c.wy[k] = v.angular.y;  c.wz[k] = v.angular.z;
+            if (gi != UINT32_MAX) {
+                c.gravity[k] = gravities[gi].acceleration;
+                c.ground[k] = gravities[gi].groundHeight;
+                c.grounded[k] = gravities[gi].grounded ? 1.0f : 0.0f;
+            } else {
+                c.gravity[k] = 0.0f;
+                c.ground[k] = -FLT_MAX;
+                c.grounded[k] = 0.0f;
+            }
+        }
+
+        integrateMotion(c, end - begin, dt);
+
+        // Scatter
+        for (uint32_t i = begin; i < end; i++) {
+            const uint32_t k = i - begin;
+            if (m_transformIndex[i] == UINT32_MAX) continue;
+            Transform& t = transforms[m_transformIndex[i]];
+            Velocity& v = velocities[i];
+            t.position = {c.px[k], c.py[k], c.pz[k]};
+            t.rotation = {c.rx[k], c.ry[k], c.rz[k]};
+            v.linear = {c.vx[k], c.vy[k], c.vz[k]};
+            if (m_gravityIndex[i] != UINT32_MAX) gravities[m_gravityIndex[i]].grounded = c.grounded[k] != 0.0f;
+        }
+    }
+
+    std::vector<uint32_t> m_transformIndex;
+    std::vector<uint32_t> m_gravityIndex;
+    std::vector<float> m_columns;
+    std::vector<float> m_moved;
+};
+
+} // namespace ecs
+} // namespace myth
@@ -0,0 +1,148 @@
+﻿#pragma once
+
+#include "Entity.h"
+#include "Components.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace myth {
+namespace ecs {
+
+// One serialized member of a component. Fields holding an Entity are
+// declared with entityField() so loaders can remap them.
+template<typename Owner, typename T, bool IsEntity = false>
+struct Field {
+    using Type = T;
+    static constexpr bool isEntity = IsEntity;
+    static_assert(std::is_trivially_copyable_v<T>, "fields are copied as raw bytes");
+
+    T Owner::* member;
+    std::string_view name;
+};
+
+template<typename Owner, typename T>
+constexpr Field<Owner, T> field(T Owner::* member, std::string_view name) { return {member, name}; }
+
+template<typename Owner>
+constexpr Field<Owner, Entity, true> entityField(Entity Owner::* member, std::string_view name) { return {member, name}; }
+
+// Field list of each component, in a fixed order. Anything not listed is
+// left at its default when loaded, so a new member goes here as well.
+// Tags have no fields: having the component is all there is to save.
+template<typename T>
+struct Reflect;
+
+template<> struct Reflect<Transform> {
+    static constexpr auto fields = std::tuple{
+        field(&Transform::position, "position"),
+        field(&Transform::rotation, "rotation"),
+        field(&Transform::scale, "scale"),
+    };
+};
+
+template<> struct Reflect<WorldMatrix> {
+    static constexpr auto fields = std::tuple{field(&WorldMatrix::rows, "rows")};
+};
+
+template<> struct Reflect<LocalBounds> {
+    static constexpr auto fields = std::tuple{
+        field(&LocalBounds::min, "min"),
+        field(&LocalBounds::max, "max"),
+    };
+};
+
+template<> struct Reflect<Velocity> {
+    static constexpr auto fields = std::tuple{
+        field(&Velocity::linear, "linear"),
+        field(&Velocity::angular, "angular"),
+    };
+};
+
+template<> struct Reflect<Gravity> {
+    static constexpr auto fields = std::tuple{
+        field(&Gravity::acceleration, "acceleration"),
+        field(&Gravity::groundHeight, "groundHeight"),
+        field(&Gravity::grounded, "grounded"),
+    };
+};
+
+template<> struct Reflect<Collider> {
+    static constexpr auto fields = std::tuple{field(&Collider::isStatic, "isStatic")};
+};
+
+template<> struct Reflect<CharacterController> {
+    static constexpr auto fields = std::tuple{
+        field(&CharacterController::skinWidth, "skinWidth"),
+        field(&CharacterController::floorHeight, "floorHeight"),
+        field(&CharacterController::lastPosition, "lastPosition"),
+        field(&CharacterController::hasLastPosition, "hasLastPosition"),
+    };
+};
+
+template<> struct Reflect<Renderable> {
+    static constexpr auto fields = std::tuple{
+        field(&Renderable::meshId, "meshId"),
+        field(&Renderable::indexStart, "indexStart"),
+        field(&Renderable::indexCount, "indexCount"),
+        field(&Renderable::vertexOffset, "vertexOffset"),
+        field(&Renderable::visible, "visible"),
+    };
+};
+
+template<> struct Reflect<PlayerController> {
+    static constexpr auto fields = std::tuple{
+        field(&PlayerController::moveSpeed, "moveSpeed"),
+        field(&PlayerController::turnSmoothSpeed, "turnSmoothSpeed"),
+        field(&PlayerController::jumpForce, "jumpForce"),
+        field(&PlayerController::targetYaw, "targetYaw"),
+    };
+};
+
+template<> struct Reflect<ThirdPersonCameraController> {
+    using C = ThirdPersonCameraController;
+    static constexpr auto fields = std::tuple{
+        field(&C::yaw, "yaw"),
+        field(&C::pitch, "pitch"),
+        field(&C::distance, "distance"),
+        field(&C::heightOffset, "heightOffset"),
+        field(&C::mouseSensitivity, "mouseSensitivity"),
+        field(&C::minPitch, "minPitch"),
+        field(&C::maxPitch, "maxPitch"),
+        field(&C::smoothSpeed, "smoothSpeed"),
+        field(&C::currentPosition, "currentPosition"),
+        entityField(&C::targetEntity, "targetEntity"),
+    };
+};
+
+template<> struct Reflect<PlayerTag> { static constexpr std::tuple<> fields{}; };
+template<> struct Reflect<CameraTag> { static constexpr std::tuple<> fields{}; };
+template<> struct Reflect<LandmarkTag> { static constexpr std::tuple<> fields{}; };
+
+// func(field) for each field of T, in order
+template<typename T, typename Func>
+constexpr void forEachField(Func&& func) {
+    std::apply([&](const auto&... fields) { (func(fields), ...); }, Reflect<T>::fields);
+}
+
+template<typename T>
+constexpr size_t fieldCount() { return std::tuple_size_v<std::remove_cv_t<decltype(Reflect<T>::fields)>>; }
+
+// FNV-1a over the field names and sizes, so a reader can tell a column
+// layout written by a build whose component differs from its own
+template<typename T>
+constexpr uint32_t layoutHash() {
+    uint32_t hash = 2166136261u;
+    auto mix = [&](uint8_t byte) { hash = (hash ^ byte) * 16777619u; };
+    forEachField<T>([&](const auto& f) {
+        for (char c : f.name) mix(static_cast<uint8_t>(c));
+        const uint32_t size = sizeof(typename std::remove_cvref_t<decltype(f)>::Type);
+        for (int shift = 0; shift < 32; shift += 8) mix(static_cast<uint8_t>(size >> shift));
+    });
+    return hash;
+}
+
+} // namespace ecs
+} // namespace myth
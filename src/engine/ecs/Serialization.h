@@ -0,0 +1,239 @@
+﻿#pragma once
+
+#include "Reflection.h"
+#include "World.h"
+#include <bit>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace myth {
+namespace ecs {
+
+// Whole-World snapshots, for saves, and for replication where a peer's
+// entities have to be brought into a world that has its own.
+//
+// Layout: a SnapshotHeader, the registry's generations and free list, then
+// one block per component type in ComponentTypeId order: a ColumnHeader,
+// the owning entities, then one packed column per reflected field, each
+// padded to 4 bytes. Entity ids inside are the writer's; the reader maps
+// every one of them, including entityField()s, to ids in the target world.
+namespace snapshot {
+
+constexpr char MAGIC[4] = {'M', 'B', 'W', 'D'};
+constexpr uint32_t VERSION = 1;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t componentCount;
+    uint32_t capacity;  // generations that follow
+    uint32_t freeCount; // free list entries after them
+    Entity playerEntity;
+    Entity cameraEntity;
+    uint32_t reserved;
+};
+
+struct ColumnHeader {
+    uint32_t typeId;
+    uint32_t layout; // layoutHash() of the writer's component
+    uint32_t count;
+    uint32_t size;   // bytes after this header
+};
+
+static_assert(std::endian::native == std::endian::little, "snapshots are little-endian");
+static_assert(sizeof(SnapshotHeader) == 32 && sizeof(ColumnHeader) == 16);
+static_assert(ComponentTypes::size < UINT8_MAX, "the loader marks entities with a type id in a byte");
+
+constexpr size_t padded(size_t bytes) { return (bytes + 3) & ~size_t(3); }
+
+template<typename T>
+constexpr size_t blockSize(size_t count) {
+    size_t size = count * sizeof(Entity);
+    forEachField<T>([&](const auto& f) { size += padded(count * sizeof(typename std::remove_cvref_t<decltype(f)>::Type)); });
+    return size;
+}
+
+template<typename T>
+uint8_t* writeBlock(const ComponentArray<T>& components, uint8_t* out) {
+    const size_t count = components.size();
+    const ColumnHeader header{componentTypeId<T>(), layoutHash<T>(), static_cast<uint32_t>(count), static_cast<uint32_t>(blockSize<T>(count))};
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memcpy(out, components.entities(), count * sizeof(Entity));
+    out += count * sizeof(Entity);
+
+    // One pass over the components feeding every column at once, so each
+    // is read once and written as a sequential stream
+    uint8_t* columns[fieldCount<T>() + 1] = {};
+    size_t k = 0;
+    forEachField<T>([&](const auto& f) {
+        columns[k++] = out;
+        out += padded(count * sizeof(typename std::remove_cvref_t<decltype(f)>::Type));
+    });
+    const T* data = components.data();
+    for (size_t i = 0; i < count; i++) {
+        size_t c = 0;
+        forEachField<T>([&](const auto& f) {
+            using F = typename std::remove_cvref_t<decltype(f)>::Type;
+            std::memcpy(columns[c++] + i * sizeof(F), &(data[i].*f.member), sizeof(F));
+        });
+    }
+    return out;
+}
+
+// Entities in the block are known to be distinct and to have no T in
+// `components` yet, so they go in with one extend()
+template<typename T>
+void readBlock(ComponentArray<T>& components, const uint8_t* in, uint32_t count, std::span<const Entity> remap) {
+    const Entity* entities = reinterpret_cast<const Entity*>(in);
+    const uint8_t* columns[fieldCount<T>() + 1] = {};
+    size_t offset = count * sizeof(Entity);
+    size_t k = 0;
+    forEachField<T>([&](const auto& f) {
+        columns[k++] = in + offset;
+        offset += padded(count * sizeof(typename std::remove_cvref_t<decltype(f)>::Type));
+    });
+
+    auto map = [&](Entity e) { return e < remap.size() ? remap[e] : NULL_ENTITY; };
+    std::vector<Entity> mapped(count);
+    for (uint32_t i = 0; i < count; i++) mapped[i] = remap[entities[i]];
+    T* out = components.extend(mapped.data(), count);
+    for (uint32_t i = 0; i < count; i++) {
+        size_t c = 0;
+        forEachField<T>([&](const auto& f) {
+            using F = typename std::remove_cvref_t<decltype(f)>::Type;
+            std::memcpy(&(out[i].*f.member), columns[c++] + i * sizeof(F), sizeof(F));
+            if constexpr (std::remove_cvref_t<decltype(f)>::isEntity) out[i].*f.member = map(out[i].*f.member);
+        });
+    }
+}
+
+} // namespace snapshot
+
+// Bytes serializeWorld() appends for `world`
+inline size_t serializedSize(const World& world) {
+    size_t size = sizeof(snapshot::SnapshotHeader) + (world.entities.capacity() + world.entities.freeList().size()) * sizeof(uint32_t);
+    [&]<typename... Ts>(ComponentList<Ts...>) {
+        ((size += sizeof(snapshot::ColumnHeader) + snapshot::blockSize<Ts>(world.storage<Ts>().size())), ...);
+    }(ComponentTypes{});
+    return size;
+}
+
+// Append a snapshot of every entity and component in `world` to `out`
+inline void serializeWorld(const World& world, std::string& out) {
+    const size_t start = out.size();
+    out.resize(start + serializedSize(world));
+    uint8_t* cursor = reinterpret_cast<uint8_t*>(out.data()) + start;
+
+    const auto generations = world.entities.generations();
+    const auto& freeList = world.entities.freeList();
+    snapshot::SnapshotHeader header{};
+    std::memcpy(header.magic, snapshot::MAGIC, sizeof(header.magic));
+    header.version = snapshot::VERSION;
+    header.componentCount = ComponentTypes::size;
+    header.capacity = static_cast<uint32_t>(generations.size());
+    header.freeCount = static_cast<uint32_t>(freeList.size());
+    header.playerEntity = world.playerEntity;
+    header.cameraEntity = world.cameraEntity;
+    std::memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    std::memcpy(cursor, generations.data(), generations.size_bytes());
+    cursor += generations.size_bytes();
+    for (Entity e : freeList) {
+        std::memcpy(cursor, &e, sizeof(e));
+        cursor += sizeof(e);
+    }
+
+    [&]<typename... Ts>(ComponentList<Ts...>) {
+        ((cursor = snapshot::writeBlock(world.storage<Ts>(), cursor)), ...);
+    }(ComponentTypes{});
+}
+
+enum class SnapshotLoad {
+    Replace, // clear `world` and take over the writer's ids, free list and player/camera
+    Merge,   // add the entities to `world` under fresh ids
+};
+
+// Load a serializeWorld() snapshot into `world`. remap, if given, receives
+// the id each of the writer's entities got (NULL_ENTITY for ids that were
+// free). The whole snapshot is checked before `world` is touched; false if
+// it is truncated, from a newer version or written by a build whose
+// components differ.
+inline bool deserializeWorld(World& world, std::span<const uint8_t> bytes, SnapshotLoad mode = SnapshotLoad::Replace,
+                             std::vector<Entity>* remap = nullptr) {
+    using namespace snapshot;
+    SnapshotHeader header;
+    if (bytes.size() < sizeof(header)) return false;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 || header.version > VERSION ||
+        header.componentCount != ComponentTypes::size || header.freeCount > header.capacity ||
+        (bytes.size() - sizeof(header)) / sizeof(uint32_t) < uint64_t(header.capacity) + header.freeCount) return false;
+
+    const uint8_t* in = bytes.data() + sizeof(header);
+    if (reinterpret_cast<uintptr_t>(in) % alignof(uint32_t) != 0) return false;
+    std::span<const uint32_t> generations(reinterpret_cast<const uint32_t*>(in), header.capacity);
+    std::span<const Entity> freeList(reinterpret_cast<const Entity*>(in + generations.size_bytes()), header.freeCount);
+    std::vector<uint8_t> alive(header.capacity, 1);
+    std::vector<uint8_t> seenIn(header.capacity, 0); // last component type id + 1 found for each entity
+    for (Entity e : freeList) {
+        if (e >= header.capacity || !alive[e]) return false;
+        alive[e] = 0;
+    }
+
+    // Walk the blocks once to check them, remembering where each starts
+    const uint8_t* blocks[ComponentTypes::size];
+    uint32_t counts[ComponentTypes::size];
+    size_t offset = sizeof(header) + generations.size_bytes() + freeList.size_bytes();
+    bool valid = true;
+    [&]<typename... Ts>(ComponentList<Ts...>) {
+        auto check = [&]<typename T>(std::type_identity<T>) {
+            ColumnHeader column;
+            if (!valid || bytes.size() - offset < sizeof(column)) return valid = false;
+            std::memcpy(&column, bytes.data() + offset, sizeof(column));
+            offset += sizeof(column);
+            if (column.typeId != componentTypeId<T>() || column.layout != layoutHash<T>() ||
+                column.size != blockSize<T>(column.count) || column.size > bytes.size() - offset) return valid = false;
+            for (uint32_t i = 0; i < column.count; i++) {
+                Entity e;
+                std::memcpy(&e, bytes.data() + offset + i * sizeof(Entity), sizeof(e));
+                if (e >= header.capacity || !alive[e] || seenIn[e] == column.typeId + 1) return valid = false;
+                seenIn[e] = static_cast<uint8_t>(column.typeId + 1);
+            }
+            blocks[column.typeId] = bytes.data() + offset;
+            counts[column.typeId] = column.count;
+            offset += column.size;
+            return true;
+        };
+        (check(std::type_identity<Ts>{}), ...);
+    }(ComponentTypes{});
+    if (!valid) return false;
+
+    std::vector<Entity> ids(header.capacity, NULL_ENTITY);
+    if (mode == SnapshotLoad::Replace) {
+        world.eachStorage([](auto& components) { components.clear(); });
+        world.entities.restore(generations, freeList);
+        for (Entity e = 0; e < header.capacity; e++) {
+            if (alive[e]) ids[e] = e;
+        }
+    } else {
+        for (Entity e = 0; e < header.capacity; e++) {
+            if (alive[e]) ids[e] = world.entities.create();
+        }
+    }
+
+    [&]<typename... Ts>(ComponentList<Ts...>) {
+        (readBlock(world.storage<Ts>(), blocks[componentTypeId<Ts>()], counts[componentTypeId<Ts>()], ids), ...);
+    }(ComponentTypes{});
+    if (mode == SnapshotLoad::Replace) {
+        auto map = [&](Entity e) { return e < ids.size() ? ids[e] : NULL_ENTITY; };
+        world.playerEntity = map(header.playerEntity);
+        world.cameraEntity = map(header.cameraEntity);
+    }
+    if (remap) *remap = std::move(ids);
+    return true;
+}
+
+} // namespace ecs
+} // namespace myth
@@ -0,0 +1,279 @@
+﻿#pragma once
+
+#include "World.h"
+#include "TransformSystem.h"
+#include "engine/Profiler.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace myth {
+namespace ecs {
+
+// Copy of every Transform and its cached matrix at one simulation tick
+struct TransformSnapshot {
+    uint64_t tick = 0;
+    double time = 0.0; // steady-clock seconds this state belongs to
+    std::vector<Entity> entities;
+    std::vector<Transform> transforms;
+    std::vector<WorldMatrix> matrices;
+    std::vector<uint32_t> slots; // entity -> index into the arrays above
+
+    void capture(const World& world, uint64_t captureTick, double captureTime) {
+        tick = captureTick;
+        time = captureTime;
+        const size_t count = world.transforms.size();
+        const Entity* dense = world.transforms.entities();
+        entities.assign(dense, dense + count);
+        transforms.assign(world.transforms.data(), world.transforms.data() + count);
+        matrices.resize(count);
+        slots.assign(world.entities.capacity(), UINT32_MAX);
+        for (size_t i = 0; i < count; i++) {
+            const WorldMatrix* m = world.worldMatrices.tryGet(entities[i]);
+            matrices[i] = m ? *m : WorldMatrix{};
+            slots[entities[i]] = static_cast<uint32_t>(i);
+        }
+    }
+
+    uint32_t find(Entity e) const {
+        return e < slots.size() ? slots[e] : UINT32_MAX;
+    }
+};
+
+// The two most recent snapshots. The simulation publishes, any thread reads;
+// readers share ownership, so publishing never waits for them to finish.
+class SnapshotBuffer {
+public:
+    struct Pair {
+        std::shared_ptr<const TransformSnapshot> previous;
+        std::shared_ptr<const TransformSnapshot> current;
+    };
+
+    void publish(const World& world, uint64_t tick, double time) {
+        std::shared_ptr<TransformSnapshot> next = acquire();
+        next->capture(world, tick, time);
+        commit(std::move(next));
+    }
+
+    // publish() in two parts, so the snapshot can be captured while the
+    // world is held still and made current after letting go of it
+    std::shared_ptr<TransformSnapshot> acquire() {
+        std::unique_ptr<TransformSnapshot> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(m_pool->mutex);
+            if (!m_pool->free.empty()) {
+                snapshot = std::move(m_pool->free.back());
+                m_pool->free.pop_back();
+            }
+        }
+        if (!snapshot) snapshot = std::make_unique<TransformSnapshot>();
+        // The last owner, reader or not, hands it back through the pool's
+        // mutex, so its reads are done before the next capture writes
+        return std::shared_ptr<TransformSnapshot>(snapshot.release(), [pool = m_pool](TransformSnapshot* returned) {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->free.emplace_back(returned);
+        });
+    }
+
+    void commit(std::shared_ptr<const TransformSnapshot> next) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_previous = m_current ? m_current : next;
+        m_current = std::move(next);
+    }
+
+    Pair latest() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return {m_previous, m_current};
+    }
+
+    // Blend factor for rendering the instant `renderTime` between the pair
+    static float blendFactor(const Pair& pair, double renderTime) {
+        if (!pair.previous || !pair.current) return 1.0f;
+        double span = pair.current->time - pair.previous->time;
+        if (span <= 0.0) return 1.0f;
+        double t = (renderTime - pair.previous->time) / span;
+        return static_cast<float>(t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t));
+    }
+
+private:
+    // Snapshots nobody holds, ready for reuse. Shared with the deleters, as
+    // a reader may let go of its snapshot after the buffer is gone.
+    struct Pool {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<TransformSnapshot>> free;
+    };
+
+    mutable std::mutex m_mutex;
+    std::shared_ptr<Pool> m_pool = std::make_shared<Pool>();
+    std::shared_ptr<const TransformSnapshot> m_previous;
+    std::shared_ptr<const TransformSnapshot> m_current;
+};
+
+// Render-side matrices blended between two snapshots. Entities whose
+// transform is identical in both reuse the cached matrix; the rest are lerped
+// and recomposed in one composeWorldMatrices() batch.
+class InterpolatedTransforms {
+public:
+    void build(const SnapshotBuffer::Pair& pair, float alpha) {
+        m_pair = pair;
+        m_matrices.clear();
+        if (!pair.current) return;
+        const TransformSnapshot& curr = *pair.current;
+        const TransformSnapshot& prev = pair.previous ? *pair.previous : curr;
+
+        m_matrices = curr.matrices;
+        m_positions.resize(curr.entities.size());
+        m_blendSlots.clear();
+        m_blended.clear();
+        for (size_t i = 0; i < curr.entities.size(); i++) {
+            const Transform& b = curr.transforms[i];
+            m_positions[i] = b.position;
+            uint32_t p = &prev == &curr ? UINT32_MAX : prev.find(curr.entities[i]);
+            if (p == UINT32_MAX) continue;
+            const Transform& a = prev.transforms[p];
+            if (a.position == b.position && a.rotation == b.rotation && a.scale == b.scale) continue;
+
+            Transform t;
+            t.position = glm::mix(a.position, b.position, alpha);
+            t.rotation = a.rotation + wrapDegrees(b.rotation - a.rotation) * alpha;
+            t.scale = glm::mix(a.scale, b.scale, alpha);
+            m_positions[i] = t.position;
+            m_blendSlots.push_back(static_cast<uint32_t>(i));
+            m_blended.push_back(t);
+        }
+
+        m_blendedMatrices.resize(m_blended.size());
+        composeWorldMatrices(m_blended.data(), m_blendedMatrices.data(), m_blended.size());
+        for (size_t k = 0; k < m_blendSlots.size(); k++) m_matrices[m_blendSlots[k]] = m_blendedMatrices[k];
+    }
+
+    const WorldMatrix* tryGet(Entity e) const {
+        uint32_t slot = m_pair.current ? m_pair.current->find(e) : UINT32_MAX;
+        return slot != UINT32_MAX && slot < m_matrices.size() ? &m_matrices[slot] : nullptr;
+    }
+
+    const glm::vec3* position(Entity e) const {
+        uint32_t slot = m_pair.current ? m_pair.current->find(e) : UINT32_MAX;
+        return slot != UINT32_MAX && slot < m_positions.size() ? &m_positions[slot] : nullptr;
+    }
+
+    // Number of matrices recomposed by the last build()
+    size_t blendedCount() const { return m_blended.size(); }
+
+private:
+    static glm::vec3 wrapDegrees(glm::vec3 d) {
+        for (int i = 0; i < 3; i++) d[i] = d[i] - 360.0f * std::floor((d[i] + 180.0f) / 360.0f);
+        return d;
+    }
+
+    SnapshotBuffer::Pair m_pair;
+    std::vector<WorldMatrix> m_matrices;
+    std::vector<glm::vec3> m_positions;
+    std::vector<uint32_t> m_blendSlots;
+    std::vector<Transform> m_blended;
+    std::vector<WorldMatrix> m_blendedMatrices;
+};
+
+// Steps a World at a fixed rate on its own thread, independent of rendering.
+// When it falls behind it runs up to `maxSubsteps` steps back to back before
+// sleeping; time beyond that is dropped rather than spiralling. Any other
+// thread touching the World must hold lockWorld(), which the simulation
+// takes one step at a time, so a catch-up batch never shuts others out.
+class SimulationThread {
+public:
+    using StepFunc = std::function<void(float dt)>;
+
+    ~SimulationThread() { stop(); }
+
+    void start(World& world, float stepSeconds, StepFunc step, int maxSubsteps = 8) {
+        stop();
+        m_world = &world;
+        m_step = stepSeconds;
+        m_maxSubsteps = maxSubsteps;
+        m_stepFunc = std::move(step);
+        m_running = true;
+        {
+            auto lock = lockWorld();
+            m_snapshots.publish(world, m_tick, now());
+        }
+        m_thread = std::thread([this]() { run(); });
+    }
+
+    void stop() {
+        m_running = false;
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    std::unique_lock<std::mutex> lockWorld() { return std::unique_lock<std::mutex>(m_worldMutex); }
+
+    const SnapshotBuffer& snapshots() const { return m_snapshots; }
+
+    // Render one step behind the newest state so there is always a pair to
+    // interpolate between
+    float renderAlpha(const SnapshotBuffer::Pair& pair) const {
+        return SnapshotBuffer::blendFactor(pair, now() - m_step);
+    }
+
+    float stepSeconds() const { return m_step; }
+    uint64_t tick() const { return m_tick.load(); }
+    uint64_t droppedSteps() const { return m_droppedSteps.load(); }
+
+    static double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    void run() {
+        MYTH_PROFILE_THREAD("Simulation");
+        double simTime = now();
+        while (m_running) {
+            double behind = now() - simTime;
+            uint64_t due = behind > 0.0 ? static_cast<uint64_t>(behind / m_step) : 0;
+            if (due > static_cast<uint64_t>(m_maxSubsteps)) {
+                m_droppedSteps += due - m_maxSubsteps;
+                simTime += static_cast<double>(due - m_maxSubsteps) * m_step;
+                due = m_maxSubsteps;
+            }
+
+            if (due > 0) {
+                std::shared_ptr<TransformSnapshot> next = m_snapshots.acquire();
+                for (uint64_t i = 0; i < due; i++) {
+                    // Give a thread waiting on the world a turn between steps
+                    if (i > 0) std::this_thread::yield();
+                    auto lock = lockWorld();
+                    m_stepFunc(m_step);
+                    m_tick++;
+                    if (i + 1 == due) {
+                        MYTH_PROFILE_ZONE("Capture snapshot");
+                        next->capture(*m_world, m_tick, simTime + static_cast<double>(due) * m_step);
+                    }
+                }
+                simTime += static_cast<double>(due) * m_step;
+                m_snapshots.commit(std::move(next));
+            }
+
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(simTime + m_step))));
+        }
+    }
+
+    World* m_world = nullptr;
+    float m_step = 1.0f / 60.0f;
+    int m_maxSubsteps = 8;
+    StepFunc m_stepFunc;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_tick{0};
+    std::atomic<uint64_t> m_droppedSteps{0};
+    std::mutex m_worldMutex;
+    SnapshotBuffer m_snapshots;
+};
+
+} // namespace ecs
+} // namespace myth
@@ -0,0 +1,202 @@
+﻿#pragma once
+
+#include "World.h"
+#include "engine/spatial/Bvh.h"
+#include "core/JobSystem.h"
+#include <algorithm>
+#include <span>
+#include <vector>
+
+namespace myth {
+namespace ecs {
+
+struct SpatialHit {
+    Entity entity = NULL_ENTITY;
+    float distance = FLT_MAX;
+    glm::vec3 point = {0.0f, 0.0f, 0.0f};
+
+    explicit operator bool() const { return entity != NULL_ENTITY; }
+};
+
+struct RayQuery {
+    glm::vec3 origin = {0.0f, 0.0f, 0.0f};
+    glm::vec3 direction = {0.0f, 0.0f, 1.0f};
+    float maxDistance = FLT_MAX;
+    Entity ignore = NULL_ENTITY;
+};
+
+// BVH over the world-space boxes of every entity with LocalBounds, kept in
+// sync with WorldMatrix. update() refits from the entities whose matrix or
+// bounds changed and rebuilds only when entities come or go or refitting has
+// degraded the tree. Queries are const and may run on any number of threads
+// between updates.
+class SpatialIndex {
+public:
+    void update(World& world) {
+        uint32_t closed = world.advanceVersion();
+        const auto bounds = world.bounds.view();
+        bool rebuild = bounds.size() != m_items.size();
+
+        auto refresh = [&](Entity e) {
+            uint32_t id = e < m_ids.size() ? m_ids[e] : UINT32_MAX;
+            if (id == UINT32_MAX) { rebuild = true; return; }
+            if (rebuild) return;
+            m_bvh.update(id, place(world, id));
+        };
+        bounds.changedSince(m_seenVersion, [&](Entity e, const LocalBounds&) { refresh(e); });
+        world.worldMatrices.view().changedSince(m_seenVersion, [&](Entity e, const WorldMatrix&) {
+            if (bounds.has(e)) refresh(e);
+        });
+        m_seenVersion = closed;
+
+        if (rebuild) {
+            this->rebuild(world);
+            return;
+        }
+
+        // Check tree quality every so often; refitting keeps it correct but
+        // lets boxes drift apart from the split planes they were built on
+        bool check = ++m_updatesSinceCheck >= QUALITY_CHECK_INTERVAL;
+        m_bvh.refit(check);
+        if (check) {
+            m_updatesSinceCheck = 0;
+            if (m_bvh.cost() > m_bvh.builtCost() * REBUILD_COST_RATIO) this->rebuild(world);
+        }
+    }
+
+    // Re-index everything from scratch
+    void rebuild(World& world) {
+        const auto bounds = world.bounds.view();
+        const Entity* dense = world.bounds.entities();
+        std::vector<Aabb> worldBounds(bounds.size());
+        for (size_t i = 0; i < bounds.size(); i++) worldBounds[i] = computeBounds(world, dense[i]);
+        m_bvh.build(worldBounds);
+
+        // Store items in leaf order so each leaf reads one contiguous run
+        const auto& order = m_bvh.leafOrder();
+        m_items.resize(order.size());
+        m_ids.assign(world.entities.capacity(), UINT32_MAX);
+        for (uint32_t id = 0; id < order.size(); id++) {
+            m_items[id].entity = dense[order[id]];
+            m_ids[m_items[id].entity] = id;
+            place(world, id);
+        }
+        m_bvh.adoptLeafOrder();
+        m_updatesSinceCheck = 0;
+        m_rebuildCount++;
+    }
+
+    // Closest entity hit by the ray, tested against its oriented box.
+    // `direction` need not be normalised; distances are in units of it.
+    SpatialHit raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+                       Entity ignore = NULL_ENTITY) const {
+        Ray ray(origin, direction);
+        uint32_t id;
+        float t = m_bvh.raycast(ray, maxDistance, id, [&](uint32_t item, float maxT) {
+            const Item& it = m_items[item];
+            if (it.entity == ignore) return FLT_MAX;
+            Ray local(it.inverse.transformPoint(origin), it.inverse.transformDirection(direction));
+            return local.intersect(it.local, maxT);
+        });
+        if (id == UINT32_MAX) return {};
+        return {m_items[id].entity, t, ray.at(t)};
+    }
+
+    // Answer a batch of rays: hits[i] for rays[i]. Rays are traced in
+    // Z-order of their ground positions so that neighbours find the nodes they share
+    // still in cache, split over `jobs` when given.
+    void raycast(std::span<const RayQuery> rays, std::span<SpatialHit> hits, JobSystem* jobs = nullptr) const {
+        const uint32_t count = static_cast<uint32_t>(std::min(rays.size(), hits.size()));
+        std::vector<uint64_t> order(count);
+        const Aabb root = m_bvh.rootBounds();
+        const glm::vec3 scale = 65535.0f / glm::max(root.max - root.min, glm::vec3(FLT_MIN));
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 cell = (glm::clamp(rays[i].origin, root.min, root.max) - root.min) * scale;
+            uint64_t code = interleave(static_cast<uint32_t>(cell.x)) | (interleave(static_cast<uint32_t>(cell.z)) << 1);
+            order[i] = code << 32 | i;
+        }
+        std::sort(order.begin(), order.end());
+
+        auto trace = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                const uint32_t i = static_cast<uint32_t>(order[k]);
+                hits[i] = raycast(rays[i].origin, rays[i].direction, rays[i].maxDistance, rays[i].ignore);
+            }
+        };
+        if (jobs) jobs->parallelFor(count, RAY_BATCH_SIZE, trace);
+        else trace(0, count);
+    }
+
+    // func(Entity) for every entity whose world box overlaps the volume
+    template<typename Func>
+    void queryAabb(const Aabb& box, Func&& func) const {
+        m_bvh.queryAabb(box, [&](uint32_t id) { func(m_items[id].entity); });
+    }
+
+    template<typename Func>
+    void querySphere(const glm::vec3& center, float radius, Func&& func) const {
+        m_bvh.querySphere(center, radius, [&](uint32_t id) { func(m_items[id].entity); });
+    }
+
+    template<typename Func>
+    void queryFrustum(const Frustum& frustum, Func&& func) const {
+        m_bvh.queryFrustum(frustum, [&](uint32_t id) { func(m_items[id].entity); });
+    }
+
+    // World-space box of an indexed entity
+    const Aabb* worldBounds(Entity e) const {
+        uint32_t id = e < m_ids.size() ? m_ids[e] : UINT32_MAX;
+        return id != UINT32_MAX ? &m_bvh.bounds(id) : nullptr;
+    }
+
+    size_t size() const { return m_items.size(); }
+    size_t rebuildCount() const { return m_rebuildCount; }
+    const Bvh& bvh() const { return m_bvh; }
+
+private:
+    static constexpr int QUALITY_CHECK_INTERVAL = 64;
+    static constexpr float REBUILD_COST_RATIO = 1.5f;
+    static constexpr uint32_t RAY_BATCH_SIZE = 1024;
+
+    // Low 16 bits of x spread to the even bits of a 32-bit code
+    static uint64_t interleave(uint32_t x) {
+        x &= 0xFFFF;
+        x = (x | (x << 8)) & 0x00FF00FF;
+        x = (x | (x << 4)) & 0x0F0F0F0F;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+        return x;
+    }
+
+    // Everything a ray test needs for one entity, kept together
+    struct Item {
+        WorldMatrix inverse; // world to local
+        Aabb local;
+        Entity entity = NULL_ENTITY;
+    };
+
+    static Aabb computeBounds(const World& world, Entity e) {
+        const auto* m = world.worldMatrices.view().tryGet(e);
+        return (m ? *m : WorldMatrix{}).transformBounds(world.bounds.view().get(e).box());
+    }
+
+    // Refresh item `id` from the world and return its world-space box
+    Aabb place(const World& world, uint32_t id) {
+        Item& item = m_items[id];
+        const auto* m = world.worldMatrices.view().tryGet(item.entity);
+        const WorldMatrix matrix = m ? *m : WorldMatrix{};
+        item.local = world.bounds.view().get(item.entity).box();
+        item.inverse = matrix.inverse();
+        return matrix.transformBounds(item.local);
+    }
+
+    Bvh m_bvh;
+    std::vector<Item> m_items;   // id -> entity data, in BVH leaf order
+    std::vector<uint32_t> m_ids; // entity -> id
+    uint32_t m_seenVersion = 0;
+    int m_updatesSinceCheck = 0;
+    size_t m_rebuildCount = 0;
+};
+
+} // namespace ecs
+} // namespace myth
@@ -1,24 +1,30 @@
 ﻿#pragma once
 
 #include "World.h"
-#include "engine/Input.h"
-#include <GLFW/glfw3.h>
+#include "SpatialIndex.h"
 
 namespace myth {
 namespace ecs {
 
-// Player input system
-inline void updatePlayerInput(World& world, float dt, bool mouseCaptured, 
-                               float mouseDeltaX, float mouseDeltaY,
-                               ThirdPersonCameraController* cam) {
+// Player intent for one simulation step, sampled by whoever drives the player.
+// Movement axes are relative to the camera: forward/right in [-1, 1].
+struct PlayerCommand {
+    float forward = 0.0f;
+    float right = 0.0f;
+    bool sprint = false;
+    bool jump = false;
+};
+
+// Player input system. Components are read through views and written back
+// only when a value changes, so an idle player is not stamped as changed.
+inline void updatePlayerInput(World& world, const PlayerCommand& command,
+                               const ThirdPersonCameraController* cam) {
     if (world.playerEntity == NULL_ENTITY) return;
+    const Entity player = world.playerEntity;
     
-    auto* transform = world.transforms.tryGet(world.playerEntity);
-    auto* velocity = world.velocities.tryGet(world.playerEntity);
-    auto* controller = world.playerControllers.tryGet(world.playerEntity);
-    if (!transform || !velocity || !controller) return;
-    
-    auto& input = Input::instance();
+    const auto* velocity = world.velocities.view().tryGet(player);
+    const auto* controller = world.playerControllers.view().tryGet(player);
+    if (!world.transforms.has(player) || !velocity || !controller) return;
     
     // Get camera-relative directions
     glm::vec3 camForward(0, 0, 1);
@@ -29,67 +35,67 @@ inline void updatePlayerInput(World& world, float dt, bool mouseCaptured,
     }
     
     // Movement
-    glm::vec3 moveDir(0.0f);
-    if (input.isKeyDown(GLFW_KEY_W)) moveDir += camForward;
-    if (input.isKeyDown(GLFW_KEY_S)) moveDir -= camForward;
-    if (input.isKeyDown(GLFW_KEY_A)) moveDir -= camRight;
-    if (input.isKeyDown(GLFW_KEY_D)) moveDir += camRight;
+    glm::vec3 moveDir = camForward * command.forward + camRight * command.right;
     
     float speed = controller->moveSpeed;
-    if (input.isKeyDown(GLFW_KEY_LEFT_SHIFT)) speed *= 2.0f;
+    if (command.sprint) speed *= 2.0f;
     
+    glm::vec3 linear = velocity->linear;
+    float targetYaw = controller->targetYaw;
     if (glm::length(moveDir) > 0.01f) {
         moveDir = glm::normalize(moveDir);
-        velocity->linear.x = moveDir.x * speed;
-        velocity->linear.z = moveDir.z * speed;
-        controller->targetYaw = glm::degrees(atan2(moveDir.x, moveDir.z));
+        linear.x = moveDir.x * speed;
+        linear.z = moveDir.z * speed;
+        targetYaw = glm::degrees(atan2(moveDir.x, moveDir.z));
     } else {
-        velocity->linear.x *= 0.85f;
-        velocity->linear.z *= 0.85f;
+        // Coast to a stop. Damping alone only ever approaches zero, which
+        // would leave the player moving, and stamped as changed, for good.
+        constexpr float REST_SPEED = 0.01f;
+        linear.x *= 0.85f;
+        linear.z *= 0.85f;
+        if (std::abs(linear.x) < REST_SPEED) linear.x = 0.0f;
+        if (std::abs(linear.z) < REST_SPEED) linear.z = 0.0f;
     }
     
     // Jump
-    if (input.isKeyPressed(GLFW_KEY_SPACE) && controller->isGrounded) {
-        velocity->linear.y = controller->jumpForce;
-        controller->isGrounded = false;
+    const auto* gravity = world.gravities.view().tryGet(player);
+    if (command.jump && gravity && gravity->grounded) {
+        linear.y = controller->jumpForce;
+        world.gravities.get(player).grounded = false;
     }
+    
+    if (linear != velocity->linear) world.velocities.get(player).linear = linear;
+    if (targetYaw != controller->targetYaw) world.playerControllers.get(player).targetYaw = targetYaw;
 }
 
-// Physics/movement system
+// Player steering: turn toward the input direction. Position, gravity and
+// ground contact are integrated for every moving entity by MotionSystem.
 inline void updateMovement(World& world, float dt) {
-    world.playerControllers.each([&](Entity e, PlayerController& controller) {
-        auto* transform = world.transforms.tryGet(e);
-        auto* velocity = world.velocities.tryGet(e);
-        if (!transform || !velocity) return;
+    world.playerControllers.view().each([&](Entity e, const PlayerController& controller) {
+        const auto* transform = world.transforms.view().tryGet(e);
+        if (!transform) return;
         
-        // Smooth rotation
+        // Smooth rotation, snapping the last hundredth of a degree: easing
+        // alone would keep nudging, and stamping, the transform
+        constexpr float SNAP_DEGREES = 0.01f;
         float yawDiff = controller.targetYaw - transform->rotation.y;
         if (yawDiff > 180.0f) yawDiff -= 360.0f;
         if (yawDiff < -180.0f) yawDiff += 360.0f;
-        transform->rotation.y += yawDiff * controller.turnSmoothSpeed * dt;
-        if (transform->rotation.y < 0.0f) transform->rotation.y += 360.0f;
-        if (transform->rotation.y > 360.0f) transform->rotation.y -= 360.0f;
-        
-        // Gravity
-        if (!controller.isGrounded) {
-            velocity->linear.y -= controller.gravity * dt;
-        }
-        
-        // Apply velocity
-        transform->position += velocity->linear * dt;
-        
-        // Ground collision
-        if (transform->position.y <= 0.0f) {
-            transform->position.y = 0.0f;
-            velocity->linear.y = 0.0f;
-            controller.isGrounded = true;
-        }
+        if (yawDiff == 0.0f) return;
+        float yaw = transform->rotation.y + (std::abs(yawDiff) < SNAP_DEGREES ? yawDiff : yawDiff * controller.turnSmoothSpeed * dt);
+        if (yaw < 0.0f) yaw += 360.0f;
+        if (yaw > 360.0f) yaw -= 360.0f;
+        if (yaw != transform->rotation.y) world.transforms.get(e).rotation.y = yaw;
     });
 }
 
-// Camera system
+// Camera system. `targetPosition` overrides the followed entity's Transform,
+// e.g. with its interpolated render position. With `obstacles` the camera is
+// pulled in front of anything between it and the target.
 inline void updateCamera(World& world, float dt, bool mouseCaptured, 
-                         double mouseDeltaX, double mouseDeltaY, float scrollDelta) {
+                         double mouseDeltaX, double mouseDeltaY, float scrollDelta,
+                         const glm::vec3* targetPosition = nullptr,
+                         const SpatialIndex* obstacles = nullptr) {
     world.cameraControllers.each([&](Entity e, ThirdPersonCameraController& cam) {
         // Mouse input
         if (mouseCaptured) {
@@ -105,24 +111,41 @@ inline void updateCamera(World& world, float dt, bool mouseCaptured,
         
         // Follow target
         if (cam.targetEntity != NULL_ENTITY && world.transforms.has(cam.targetEntity)) {
-            const auto& targetTransform = world.transforms.get(cam.targetEntity);
+            glm::vec3 followPos = targetPosition ? *targetPosition : world.transforms.view().get(cam.targetEntity).position;
             
             float horizontalDist = cam.distance * cos(glm::radians(cam.pitch));
             float verticalDist = cam.distance * sin(glm::radians(cam.pitch));
             
             glm::vec3 targetPos;
-            targetPos.x = targetTransform.position.x - horizontalDist * sin(glm::radians(cam.yaw));
-            targetPos.z = targetTransform.position.z - horizontalDist * cos(glm::radians(cam.yaw));
-            targetPos.y = targetTransform.position.y + cam.heightOffset + verticalDist;
+            targetPos.x = followPos.x - horizontalDist * sin(glm::radians(cam.yaw));
+            targetPos.z = followPos.z - horizontalDist * cos(glm::radians(cam.yaw));
+            targetPos.y = followPos.y + cam.heightOffset + verticalDist;
+            
+            // Collide along the line of sight from the look target; an
+            // obstructed camera snaps in rather than easing through the wall
+            bool obstructed = false;
+            if (obstacles) {
+                constexpr float CAMERA_RADIUS = 0.3f;
+                glm::vec3 pivot = followPos + glm::vec3(0.0f, 1.1f, 0.0f);
+                glm::vec3 toCamera = targetPos - pivot;
+                float length = glm::length(toCamera);
+                if (length > 0.0f) {
+                    glm::vec3 dir = toCamera / length;
+                    if (SpatialHit hit = obstacles->raycast(pivot, dir, length + CAMERA_RADIUS, cam.targetEntity)) {
+                        targetPos = pivot + dir * glm::max(hit.distance - CAMERA_RADIUS, 0.0f);
+                        obstructed = glm::distance(cam.currentPosition, pivot) > glm::distance(targetPos, pivot);
+                    }
+                }
+            }
             
-            float t = 1.0f - exp(-cam.smoothSpeed * dt);
+            float t = obstructed ? 1.0f : 1.0f - exp(-cam.smoothSpeed * dt);
             cam.currentPosition = glm::mix(cam.currentPosition, targetPos, t);
         }
     });
 }
 
 // Get camera view matrix
-inline glm::mat4 getCameraViewMatrix(const World& world) {
+inline glm::mat4 getCameraViewMatrix(const World& world, const glm::vec3* targetPosition = nullptr) {
     if (world.cameraEntity == NULL_ENTITY) return glm::mat4(1.0f);
     
     const auto* cam = world.cameraControllers.tryGet(world.cameraEntity);
@@ -131,7 +154,8 @@ inline glm::mat4 getCameraViewMatrix(const World& world) {
     const auto* targetTransform = world.transforms.tryGet(cam->targetEntity);
     if (!targetTransform) return glm::mat4(1.0f);
     
-    glm::vec3 lookTarget = targetTransform->position + glm::vec3(0.0f, 1.1f, 0.0f);
+    glm::vec3 followPos = targetPosition ? *targetPosition : targetTransform->position;
+    glm::vec3 lookTarget = followPos + glm::vec3(0.0f, 1.1f, 0.0f);
     return glm::lookAt(cam->currentPosition, lookTarget, glm::vec3(0.0f, 1.0f, 0.0f));
 }
 
@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include "World.h"
+#include "core/JobSystem.h"
+#include "engine/math/SimdMath.h"
+#include <algorithm>
+#include <vector>
+
+namespace myth {
+namespace ecs {
+
+// Compose world matrices for `count` transforms, W lanes at a time.
+// Produces the same result as Transform::getMatrix(): T * Ry * Rx * Rz * S.
+inline void composeWorldMatrices(const Transform* in, WorldMatrix* out, size_t count) {
+    using V = simd::FloatN;
+    constexpr int W = V::Width;
+    constexpr float DEG_TO_RAD = 0.0174532925199432958f;
+
+    // Lane-major scratch: 9 input columns, 12 output columns
+    alignas(32) float src[9][W];
+    alignas(32) float dst[12][W];
+
+    for (size_t base = 0; base < count; base += W) {
+        const int n = static_cast<int>(std::min<size_t>(W, count - base));
+        for (int k = 0; k < W; k++) {
+            const Transform& t = in[base + (k < n ? k : 0)];
+            src[0][k] = t.position.x; src[1][k] = t.position.y; src[2][k] = t.position.z;
+            src[3][k] = t.rotation.x; src[4][k] = t.rotation.y; src[5][k] = t.rotation.z;
+            src[6][k] = t.scale.x;    src[7][k] = t.scale.y;    src[8][k] = t.scale.z;
+        }
+
+        V sx, cx, sy, cy, sz, cz;
+        simd::sincos(V::load(src[3]) * V(DEG_TO_RAD), sx, cx);
+        simd::sincos(V::load(src[4]) * V(DEG_TO_RAD), sy, cy);
+        simd::sincos(V::load(src[5]) * V(DEG_TO_RAD), sz, cz);
+
+        // R = Ry * Rx * Rz
+        const V sysx = sy * sx, cysx = cy * sx;
+        const V r00 = cy * cz + sysx * sz, r01 = sysx * cz - cy * sz, r02 = sy * cx;
+        const V r10 = cx * sz,             r11 = cx * cz,             r12 = -sx;
+        const V r20 = cysx * sz - sy * cz, r21 = sy * sz + cysx * cz, r22 = cy * cx;
+
+        const V kx = V::load(src[6]), ky = V::load(src[7]), kz = V::load(src[8]);
+        (r00 * kx).store(dst[0]); (r01 * ky).store(dst[1]); (r02 * kz).store(dst[2]);
+        (r10 * kx).store(dst[4]); (r11 * ky).store(dst[5]); (r12 * kz).store(dst[6]);
+        (r20 * kx).store(dst[8]); (r21 * ky).store(dst[9]); (r22 * kz).store(dst[10]);
+        V::load(src[0]).store(dst[3]);
+        V::load(src[1]).store(dst[7]);
+        V::load(src[2]).store(dst[11]);
+
+        for (int k = 0; k < n; k++) {
+            WorldMatrix& m = out[base + k];
+            for (int r = 0; r < 3; r++) {
+                m.rows[r] = {dst[r * 4 + 0][k], dst[r * 4 + 1][k], dst[r * 4 + 2][k], dst[r * 4 + 3][k]};
+            }
+        }
+    }
+}
+
+// Keeps World::worldMatrices in sync with Transform. Only transforms changed
+// since the previous update are recomposed, so static entities cost nothing
+// after their first frame.
+class WorldMatrixSystem {
+public:
+    void update(World& world, JobSystem* jobs = nullptr) {
+        uint32_t closed = world.advanceVersion();
+        m_entities.clear();
+        m_transforms.clear();
+        world.transforms.view().changedSince(m_seenVersion, [&](Entity e, const Transform& t) {
+            m_entities.push_back(e);
+            m_transforms.push_back(t);
+        });
+        m_seenVersion = closed;
+        if (m_entities.empty()) return;
+
+        m_matrices.resize(m_entities.size());
+        uint32_t count = static_cast<uint32_t>(m_entities.size());
+        if (jobs) {
+            jobs->parallelFor(count, BATCH_SIZE, [this](uint32_t begin, uint32_t end) {
+                composeWorldMatrices(&m_transforms[begin], &m_matrices[begin], end - begin);
+            });
+        } else {
+            composeWorldMatrices(m_transforms.data(), m_matrices.data(), count);
+        }
+
+        // Scatter on this thread: writes stamp worldMatrices' change versions
+        for (size_t i = 0; i < m_entities.size(); i++) {
+            if (auto* m = world.worldMatrices.tryGet(m_entities[i])) *m = m_matrices[i];
+            else world.worldMatrices.add(m_entities[i], m_matrices[i]);
+        }
+    }
+
+    // Matrices recomposed by the last update()
+    size_t lastUpdateCount() const { return m_entities.size(); }
+
+    // Recompose everything on the next update()
+    void invalidate() { m_seenVersion = 0; }
+
+private:
+    static constexpr uint32_t BATCH_SIZE = 2048;
+
+    uint32_t m_seenVersion = 0;
+    std::vector<Entity> m_entities;
+    std::vector<Transform> m_transforms;
+    std::vector<WorldMatrix> m_matrices;
+};
+
+} // namespace ecs
+} // namespace myth
@@ -2,17 +2,46 @@
 
 #include "Entity.h"
 #include "Components.h"
+#include <span>
+#include <type_traits>
 
 namespace myth {
 namespace ecs {
 
+// Every component type World stores, in ComponentTypeId order.
+// Adding a component means adding it here, as a member, in storage() and
+// with its field list in Reflection.h.
+using ComponentTypes = ComponentList<
+    Transform,
+    WorldMatrix,
+    LocalBounds,
+    Velocity,
+    Gravity,
+    Collider,
+    CharacterController,
+    Renderable,
+    PlayerController,
+    ThirdPersonCameraController,
+    PlayerTag,
+    CameraTag,
+    LandmarkTag
+>;
+
+template<typename T>
+constexpr uint16_t componentTypeId() { return ComponentIndex<T, ComponentTypes>::value; }
+
 // World holds all ECS data
 struct World {
     EntityRegistry entities;
     
     // Component arrays
     ComponentArray<Transform> transforms;
+    ComponentArray<WorldMatrix> worldMatrices;
+    ComponentArray<LocalBounds> bounds;
     ComponentArray<Velocity> velocities;
+    ComponentArray<Gravity> gravities;
+    ComponentArray<Collider> colliders;
+    ComponentArray<CharacterController> characterControllers;
     ComponentArray<Renderable> renderables;
     ComponentArray<PlayerController> playerControllers;
     ComponentArray<ThirdPersonCameraController> cameraControllers;
@@ -24,6 +53,48 @@ struct World {
     Entity playerEntity = NULL_ENTITY;
     Entity cameraEntity = NULL_ENTITY;
     
+    // Change-tracking clock shared by all component arrays
+    uint32_t version = 1;
+    
+    // Typed access to a component array
+    template<typename T>
+    ComponentArray<T>& storage() {
+        if constexpr (std::is_same_v<T, Transform>) return transforms;
+        else if constexpr (std::is_same_v<T, WorldMatrix>) return worldMatrices;
+        else if constexpr (std::is_same_v<T, LocalBounds>) return bounds;
+        else if constexpr (std::is_same_v<T, Velocity>) return velocities;
+        else if constexpr (std::is_same_v<T, Gravity>) return gravities;
+        else if constexpr (std::is_same_v<T, Collider>) return colliders;
+        else if constexpr (std::is_same_v<T, CharacterController>) return characterControllers;
+        else if constexpr (std::is_same_v<T, Renderable>) return renderables;
+        else if constexpr (std::is_same_v<T, PlayerController>) return playerControllers;
+        else if constexpr (std::is_same_v<T, ThirdPersonCameraController>) return cameraControllers;
+        else if constexpr (std::is_same_v<T, PlayerTag>) return playerTags;
+        else if constexpr (std::is_same_v<T, CameraTag>) return cameraTags;
+        else if constexpr (std::is_same_v<T, LandmarkTag>) return landmarkTags;
+        else static_assert(sizeof(T) == 0, "Component type is not stored in World");
+    }
+    
+    template<typename T>
+    const ComponentArray<T>& storage() const { return const_cast<World*>(this)->storage<T>(); }
+    
+    // Visit every component array in ComponentTypeId order
+    template<typename Func>
+    void eachStorage(Func&& func) {
+        [&]<typename... Ts>(ComponentList<Ts...>) {
+            (func(storage<Ts>()), ...);
+        }(ComponentTypes{});
+    }
+    
+    // Close the current change version and start the next one. Returns the
+    // closed version: every change made so far is stamped at or below it, so a
+    // consumer keeps it and passes it to changedSince() on its next run.
+    uint32_t advanceVersion() {
+        uint32_t closed = version++;
+        eachStorage([this](auto& components) { components.setVersion(version); });
+        return closed;
+    }
+    
     // Create entity with transform
     Entity createEntity(const glm::vec3& pos = {0,0,0}, const glm::vec3& rot = {0,0,0}, const glm::vec3& scl = {1,1,1}) {
         Entity e = entities.create();
@@ -32,6 +103,7 @@ struct World {
         t.rotation = rot;
         t.scale = scl;
         transforms.add(e, t);
+        worldMatrices.add(e, WorldMatrix{});
         return e;
     }
     
@@ -39,6 +111,13 @@ struct World {
     Entity createPlayer(const glm::vec3& pos) {
         Entity e = createEntity(pos);
         velocities.add(e, Velocity{});
+        gravities.add(e, Gravity{});
+        bounds.add(e, LocalBounds{{-0.3f, 0.0f, -0.3f}, {0.3f, 1.8f, 0.3f}}); // player mesh
+        colliders.add(e, Collider{false});
+        CharacterController cc;
+        cc.lastPosition = pos;
+        cc.hasLastPosition = true;
+        characterControllers.add(e, cc);
         playerControllers.add(e, PlayerController{});
         playerTags.add(e, PlayerTag{});
         
@@ -65,6 +144,8 @@ struct World {
     Entity createLandmark(const glm::vec3& pos, const glm::vec3& scale, float rotY) {
         Entity e = createEntity(pos, {0, rotY, 0}, scale);
         landmarkTags.add(e, LandmarkTag{});
+        bounds.add(e, LocalBounds{}); // unit cube
+        colliders.add(e, Collider{true});
         
         Renderable r;
         r.meshId = static_cast<uint32_t>(MeshId::Cube);
@@ -75,19 +156,24 @@ struct World {
     
     // Destroy entity and all its components
     void destroyEntity(Entity e) {
-        transforms.remove(e);
-        velocities.remove(e);
-        renderables.remove(e);
-        playerControllers.remove(e);
-        cameraControllers.remove(e);
-        playerTags.remove(e);
-        cameraTags.remove(e);
-        landmarkTags.remove(e);
+        eachStorage([e](auto& components) { components.remove(e); });
         entities.destroy(e);
         
         if (e == playerEntity) playerEntity = NULL_ENTITY;
         if (e == cameraEntity) cameraEntity = NULL_ENTITY;
     }
+    
+    // Destroy many entities, emptying each component array of them in one pass
+    void destroyEntities(std::span<const Entity> doomed) {
+        eachStorage([doomed](auto& components) {
+            for (Entity e : doomed) components.remove(e);
+        });
+        for (Entity e : doomed) {
+            entities.destroy(e);
+            if (e == playerEntity) playerEntity = NULL_ENTITY;
+            if (e == cameraEntity) cameraEntity = NULL_ENTITY;
+        }
+    }
 };
 
 } // namespace ecs
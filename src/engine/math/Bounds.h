@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+
+namespace myth {
+
+// Axis-aligned bounding box. Default constructed empty (min > max), so
+// expanding it by anything yields that thing.
+struct Aabb {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    Aabb() = default;
+    Aabb(const glm::vec3& lo, const glm::vec3& hi) : min(lo), max(hi) {}
+
+    bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    void expand(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+    void expand(const Aabb& b) { min = glm::min(min, b.min); max = glm::max(max, b.max); }
+
+    float surfaceArea() const {
+        if (empty()) return 0.0f;
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool overlaps(const Aabb& b) const {
+        return min.x <= b.max.x && max.x >= b.min.x &&
+               min.y <= b.max.y && max.y >= b.min.y &&
+               min.z <= b.max.z && max.z >= b.min.z;
+    }
+
+    bool contains(const glm::vec3& p) const {
+        return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z;
+    }
+
+    bool overlapsSphere(const glm::vec3& center, float radius) const {
+        glm::vec3 d = glm::clamp(center, min, max) - center;
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    bool operator==(const Aabb& b) const { return min == b.min && max == b.max; }
+};
+
+// Ray with the reciprocal direction precomputed for slab tests
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 invDirection;
+
+    Ray(const glm::vec3& o, const glm::vec3& d) : origin(o), direction(d), invDirection(1.0f / d) {}
+
+    glm::vec3 at(float t) const { return origin + direction * t; }
+
+    // Entry distance into `box`, or FLT_MAX if the ray misses it within [0, maxT]
+    float intersect(const Aabb& box, float maxT) const {
+        glm::vec3 t1 = (box.min - origin) * invDirection;
+        glm::vec3 t2 = (box.max - origin) * invDirection;
+        glm::vec3 lo = glm::min(t1, t2), hi = glm::max(t1, t2);
+        float tEnter = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+        float tExit = std::min(std::min(hi.x, hi.y), std::min(hi.z, maxT));
+        return tEnter <= tExit ? tEnter : FLT_MAX;
+    }
+};
+
+// Six inward-facing planes (xyz = normal, w = distance) of a view volume
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Extract from a clip-space matrix with Vulkan's [0, 1] depth range
+    static Frustum fromMatrix(const glm::mat4& viewProj) {
+        glm::mat4 m = glm::transpose(viewProj);
+        Frustum f;
+        f.planes[0] = m[3] + m[0]; // left
+        f.planes[1] = m[3] - m[0]; // right
+        f.planes[2] = m[3] + m[1]; // bottom
+        f.planes[3] = m[3] - m[1]; // top
+        f.planes[4] = m[2];        // near
+        f.planes[5] = m[3] - m[2]; // far
+        for (auto& p : f.planes) p /= glm::length(glm::vec3(p));
+        return f;
+    }
+
+    // Conservative: may accept boxes just outside a corner of the volume
+    bool intersects(const Aabb& box) const {
+        for (const auto& p : planes) {
+            glm::vec3 positive(p.x >= 0.0f ? box.max.x : box.min.x,
+                               p.y >= 0.0f ? box.max.y : box.min.y,
+                               p.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(p), positive) + p.w < 0.0f) return false;
+        }
+        return true;
+    }
+};
+
+} // namespace myth
@@ -0,0 +1,266 @@
+﻿#pragma once
+
+#include "SimdMath.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace myth {
+namespace noise {
+
+// Lattice noise and fractal sums over it, evaluated a whole SIMD register
+// of samples at a time. The lattice hash is counter-based (a pure function
+// of the cell, octave and seed) and every lane runs the same IEEE
+// operations in the same order, so a sample's value does not depend on the
+// lane width, the batch it was part of or which thread computed it.
+
+enum class Basis {
+    Value,    // random heights at lattice points, smoothly interpolated
+    Gradient, // Perlin: random slopes at lattice points, zero on them
+};
+
+struct Fractal {
+    Basis basis = Basis::Gradient;
+    bool ridged = false; // sum (1 - |n|)^2 per octave: sharp crests, result in [0, 1]
+    int octaves = 4; // 0 or fewer: the result is 0 everywhere
+    float frequency = 1.0f;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    uint32_t seed = 0;
+    // Non-zero makes the result repeat every period / frequency units along
+    // each axis; must be a power of two, with lacunarity 2
+    uint32_t period = 0;
+};
+
+// ========================= Lane kernels =====================================
+
+// Lattice hashing: each axis multiplies its integer coordinate by its own
+// odd constant, and a corner's hash is the lowbias32 finaliser over the xor
+// of its axis keys and the seed key. The axis keys are shared by the corners
+// of a cell, so a 2D sample pays for four products rather than sixteen.
+constexpr uint32_t KEY_X = 0x8da6b343u, KEY_Y = 0xd8163841u, KEY_Z = 0xcb1ab31fu, KEY_SEED = 0x165667b1u;
+
+template<typename U>
+inline U finalize(U h) {
+    h = (h ^ (h >> 16)) * U(0x7feb352du);
+    h = (h ^ (h >> 15)) * U(0x846ca68bu);
+    return h ^ (h >> 16);
+}
+
+// Uniform in [-1, 1) from the top 24 bits of a hash
+template<typename V>
+inline V hashToUnit(typename V::Int h) {
+    return toFloat(h >> 8) * V(1.0f / 8388608.0f) - V(1.0f);
+}
+
+// Negates lanes of `a` whose hash has bit `bit` set
+template<typename V>
+inline V flipIf(V a, typename V::Int h, int bit) {
+    return a ^ asFloat((h >> bit) << 31);
+}
+
+// All-ones lanes where the hash has bit `bit` set
+template<typename V>
+inline V bitMask(typename V::Int h, int bit) {
+    using U = typename V::Int;
+    return asFloat(U(0u) - ((h >> bit) & U(1u)));
+}
+
+template<typename V>
+inline V fade(V t) {
+    return t * t * t * (t * (t * V(6.0f) - V(15.0f)) + V(10.0f));
+}
+
+template<typename V>
+inline V lerp(V a, V b, V t) {
+    return a + (b - a) * t;
+}
+
+// Lattice cell of each lane along one axis: the keys of its two wrapped
+// integer corners and the fraction inside
+template<typename V>
+struct Cell {
+    using U = typename V::Int;
+    U k0, k1;
+    V f;
+
+    Cell(V x, U wrap, uint32_t key) {
+        const V fl = floor(x);
+        f = x - fl;
+        const U i0 = truncate(fl) & wrap;
+        k0 = i0 * U(key);
+        k1 = ((i0 + U(1u)) & wrap) * U(key);
+    }
+};
+
+// The basis kernels take the seed key (seed * KEY_SEED) and a mask that
+// wraps lattice coordinates, all ones for no period
+
+template<typename V>
+inline V value2(V x, V y, typename V::Int seed, typename V::Int wrap) {
+    const Cell<V> cx(x, wrap, KEY_X), cy(y, wrap, KEY_Y);
+    const V u = fade(cx.f), v = fade(cy.f);
+    auto corner = [&](auto kx, auto ky) { return hashToUnit<V>(finalize(kx ^ ky ^ seed)); };
+    const V bottom = lerp(corner(cx.k0, cy.k0), corner(cx.k1, cy.k0), u);
+    const V top = lerp(corner(cx.k0, cy.k1), corner(cx.k1, cy.k1), u);
+    return lerp(bottom, top, v);
+}
+
+// Gradients are the four diagonals, picked by two hash bits
+template<typename V>
+inline V grad2(typename V::Int h, V x, V y) {
+    return flipIf(x, h, 0) + flipIf(y, h, 1);
+}
+
+template<typename V>
+inline V gradient2(V x, V y, typename V::Int seed, typename V::Int wrap) {
+    const Cell<V> cx(x, wrap, KEY_X), cy(y, wrap, KEY_Y);
+    const V fx1 = cx.f - V(1.0f), fy1 = cy.f - V(1.0f);
+    const V u = fade(cx.f), v = fade(cy.f);
+    auto corner = [&](auto kx, auto ky, V gx, V gy) { return grad2(finalize(kx ^ ky ^ seed), gx, gy); };
+    const V bottom = lerp(corner(cx.k0, cy.k0, cx.f, cy.f), corner(cx.k1, cy.k0, fx1, cy.f), u);
+    const V top = lerp(corner(cx.k0, cy.k1, cx.f, fy1), corner(cx.k1, cy.k1, fx1, fy1), u);
+    return lerp(bottom, top, v);
+}
+
+template<typename V>
+inline V value3(V x, V y, V z, typename V::Int seed, typename V::Int wrap) {
+    const Cell<V> cx(x, wrap, KEY_X), cy(y, wrap, KEY_Y), cz(z, wrap, KEY_Z);
+    const V u = fade(cx.f), v = fade(cy.f), w = fade(cz.f);
+    auto corner = [&](auto kx, auto ky, auto kz) { return hashToUnit<V>(finalize(kx ^ ky ^ kz ^ seed)); };
+    const V front = lerp(lerp(corner(cx.k0, cy.k0, cz.k0), corner(cx.k1, cy.k0, cz.k0), u),
+                        lerp(corner(cx.k0, cy.k1, cz.k0), corner(cx.k1, cy.k1, cz.k0), u), v);
+    const V back = lerp(lerp(corner(cx.k0, cy.k0, cz.k1), corner(cx.k1, cy.k0, cz.k1), u),
+                       lerp(corner(cx.k0, cy.k1, cz.k1), corner(cx.k1, cy.k1, cz.k1), u), v);
+    return lerp(front, back, w);
+}
+
+// Perlin's twelve cube-edge gradients from the low four hash bits, as
+// selects rather than a table lookup
+template<typename V>
+inline V grad3(typename V::Int h, V x, V y, V z) {
+    const V b0 = bitMask<V>(h, 0), b2 = bitMask<V>(h, 2), b3 = bitMask<V>(h, 3);
+    const V u = select(b3, y, x);                                       // h < 8 ? x : y
+    const V v = select(b3 | b2, select(b3 & b2 & (b0 ^ b3), x, z), y);  // h < 4 ? y : h is 12 or 14 ? x : z
+    return flipIf(u, h, 0) + flipIf(v, h, 1);
+}
+
+template<typename V>
+inline V gradient3(V x, V y, V z, typename V::Int seed, typename V::Int wrap) {
+    const Cell<V> cx(x, wrap, KEY_X), cy(y, wrap, KEY_Y), cz(z, wrap, KEY_Z);
+    const V fx1 = cx.f - V(1.0f), fy1 = cy.f - V(1.0f), fz1 = cz.f - V(1.0f);
+    const V u = fade(cx.f), v = fade(cy.f), w = fade(cz.f);
+    auto corner = [&](auto kx, auto ky, auto kz, V gx, V gy, V gz) { return grad3(finalize(kx ^ ky ^ kz ^ seed), gx, gy, gz); };
+    const V front = lerp(lerp(corner(cx.k0, cy.k0, cz.k0, cx.f, cy.f, cz.f), corner(cx.k1, cy.k0, cz.k0, fx1, cy.f, cz.f), u),
+                        lerp(corner(cx.k0, cy.k1, cz.k0, cx.f, fy1, cz.f), corner(cx.k1, cy.k1, cz.k0, fx1, fy1, cz.f), u), v);
+    const V back = lerp(lerp(corner(cx.k0, cy.k0, cz.k1, cx.f, cy.f, fz1), corner(cx.k1, cy.k0, cz.k1, fx1, cy.f, fz1), u),
+                       lerp(corner(cx.k0, cy.k1, cz.k1, cx.f, fy1, fz1), corner(cx.k1, cy.k1, cz.k1, fx1, fy1, fz1), u), v);
+    return lerp(front, back, w);
+}
+
+// Octave sum normalised by the total amplitude: [-1, 1], or [0, 1] ridged.
+// `basis(x, y, seed, wrap)` or `basis(x, y, z, seed, wrap)` per octave.
+template<typename V, typename Kernel, typename... Coords>
+inline V fractal(const Fractal& f, Kernel&& basis, Coords... coords) {
+    using U = typename V::Int;
+    if (f.octaves <= 0) return V(0.0f); // nothing to normalise by
+    V sum(0.0f);
+    float amplitude = 1.0f, total = 0.0f, frequency = f.frequency;
+    for (int octave = 0; octave < f.octaves; octave++) {
+        const U wrap(f.period ? (f.period << octave) - 1u : ~0u);
+        const U seed((f.seed + static_cast<uint32_t>(octave)) * KEY_SEED);
+        V n = basis((coords * V(frequency))..., seed, wrap);
+        if (f.ridged) {
+            n = V(1.0f) - abs(n);
+            n = n * n;
+        }
+        sum = sum + n * V(amplitude);
+        total += amplitude;
+        amplitude *= f.gain;
+        frequency *= f.lacunarity;
+    }
+    return sum * V(1.0f / total);
+}
+
+template<typename V>
+inline V fractal2(const Fractal& f, V x, V y) {
+    using U = typename V::Int;
+    if (f.basis == Basis::Value) return fractal<V>(f, [](V a, V b, U s, U w) { return value2(a, b, s, w); }, x, y);
+    return fractal<V>(f, [](V a, V b, U s, U w) { return gradient2(a, b, s, w); }, x, y);
+}
+
+template<typename V>
+inline V fractal3(const Fractal& f, V x, V y, V z) {
+    using U = typename V::Int;
+    if (f.basis == Basis::Value) return fractal<V>(f, [](V a, V b, V c, U s, U w) { return value3(a, b, c, s, w); }, x, y, z);
+    return fractal<V>(f, [](V a, V b, V c, U s, U w) { return gradient3(a, b, c, s, w); }, x, y, z);
+}
+
+// ========================= Batch entry points ===============================
+
+// out[i] = fractal at (x[i], y[i]), FloatN::Width samples per step
+inline void fill2(const Fractal& f, const float* x, const float* y, float* out, size_t count) {
+    using V = simd::FloatN;
+    size_t i = 0;
+    for (; i + V::Width <= count; i += V::Width) fractal2(f, V::load(x + i), V::load(y + i)).store(out + i);
+    if (i == count) return;
+    // Pad the tail to a full register so it takes the same path
+    const size_t rest = count - i;
+    float tx[V::Width] = {}, ty[V::Width] = {}, to[V::Width];
+    std::copy_n(x + i, rest, tx);
+    std::copy_n(y + i, rest, ty);
+    fractal2(f, V::load(tx), V::load(ty)).store(to);
+    std::copy_n(to, rest, out + i);
+}
+
+inline void fill3(const Fractal& f, const float* x, const float* y, const float* z, float* out, size_t count) {
+    using V = simd::FloatN;
+    size_t i = 0;
+    for (; i + V::Width <= count; i += V::Width) fractal3(f, V::load(x + i), V::load(y + i), V::load(z + i)).store(out + i);
+    if (i == count) return;
+    const size_t rest = count - i;
+    float tx[V::Width] = {}, ty[V::Width] = {}, tz[V::Width] = {}, to[V::Width];
+    std::copy_n(x + i, rest, tx);
+    std::copy_n(y + i, rest, ty);
+    std::copy_n(z + i, rest, tz);
+    fractal3(f, V::load(tx), V::load(ty), V::load(tz)).store(to);
+    std::copy_n(to, rest, out + i);
+}
+
+// out[j * width + i] = fractal at (x0 + i * step, y0 + j * step): a
+// heightfield or an image, without building coordinate arrays
+inline void fillGrid2(const Fractal& f, float x0, float y0, float step, int width, int height, float* out) {
+    using V = simd::FloatN;
+    float lane[V::Width], to[V::Width];
+    for (int k = 0; k < V::Width; k++) lane[k] = static_cast<float>(k);
+    const V lanes = V::load(lane);
+    for (int j = 0; j < height; j++) {
+        const V y(y0 + static_cast<float>(j) * step);
+        float* row = out + static_cast<size_t>(j) * width;
+        for (int i = 0; i < width; i += V::Width) {
+            const V n = fractal2(f, V(x0) + (V(static_cast<float>(i)) + lanes) * V(step), y);
+            if (i + V::Width <= width) {
+                n.store(row + i);
+            } else {
+                n.store(to);
+                for (int k = i; k < width; k++) row[k] = to[k - i];
+            }
+        }
+    }
+}
+
+// Single samples, bit-identical to the batch results
+inline float sample2(const Fractal& f, float x, float y) {
+    float out[simd::Float4::Width];
+    fractal2(f, simd::Float4(x), simd::Float4(y)).store(out);
+    return out[0];
+}
+
+inline float sample3(const Fractal& f, float x, float y, float z) {
+    float out[simd::Float4::Width];
+    fractal3(f, simd::Float4(x), simd::Float4(y), simd::Float4(z)).store(out);
+    return out[0];
+}
+
+} // namespace noise
+} // namespace myth
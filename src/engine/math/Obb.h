@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include "Bounds.h"
+#include <cmath>
+
+namespace myth {
+
+// Oriented box: a center, three orthonormal axes and the half size along each
+struct Obb {
+    glm::vec3 center = {0.0f, 0.0f, 0.0f};
+    glm::vec3 axes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    glm::vec3 halfExtents = {0.5f, 0.5f, 0.5f};
+
+    static Obb fromAabb(const Aabb& box) {
+        Obb o;
+        o.center = box.center();
+        o.halfExtents = box.extent();
+        return o;
+    }
+
+    // Half length of the box's shadow on `axis`
+    float projectedRadius(const glm::vec3& axis) const {
+        return halfExtents.x * std::abs(glm::dot(axes[0], axis)) +
+               halfExtents.y * std::abs(glm::dot(axes[1], axis)) +
+               halfExtents.z * std::abs(glm::dot(axes[2], axis));
+    }
+
+    Aabb bounds() const {
+        glm::vec3 r(projectedRadius({1, 0, 0}), projectedRadius({0, 1, 0}), projectedRadius({0, 0, 1}));
+        return {center - r, center + r};
+    }
+};
+
+// Minimum translation separating two overlapping shapes: moving `a` by
+// -normal * depth (or `b` by +normal * depth) resolves the overlap
+struct Penetration {
+    glm::vec3 normal = {0.0f, 1.0f, 0.0f}; // from a toward b
+    float depth = 0.0f;
+};
+
+// Separating axis test over the 15 candidate axes. Returns true on overlap
+// and, if `out` is given, the axis of least penetration. Works in a's frame
+// with the rotation R taking b's axes into it, so every projection is a few
+// multiply-adds and an edge axis only needs normalising when it is a
+// candidate for the answer. Vector components are copied to plain arrays:
+// indexing a glm vector with a variable goes through a switch.
+inline bool intersect(const Obb& a, const Obb& b, Penetration* out = nullptr) {
+    constexpr float PARALLEL_EPSILON = 1e-6f;
+    const glm::vec3 d = b.center - a.center;
+    float R[3][3], absR[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            R[i][j] = glm::dot(a.axes[i], b.axes[j]);
+            absR[i][j] = std::abs(R[i][j]) + PARALLEL_EPSILON;
+        }
+    }
+    const float t[3] = {glm::dot(d, a.axes[0]), glm::dot(d, a.axes[1]), glm::dot(d, a.axes[2])};
+    const float ha[3] = {a.halfExtents.x, a.halfExtents.y, a.halfExtents.z};
+    const float hb[3] = {b.halfExtents.x, b.halfExtents.y, b.halfExtents.z};
+
+    float bestDepth = FLT_MAX;
+    glm::vec3 bestAxis(0.0f, 1.0f, 0.0f);
+    bool bestFlip = false;
+
+    for (int i = 0; i < 3; i++) {
+        float rb = hb[0] * absR[i][0] + hb[1] * absR[i][1] + hb[2] * absR[i][2];
+        float overlap = ha[i] + rb - std::abs(t[i]);
+        if (overlap < 0.0f) return false;
+        if (overlap < bestDepth) { bestDepth = overlap; bestAxis = a.axes[i]; bestFlip = t[i] < 0.0f; }
+    }
+    for (int j = 0; j < 3; j++) {
+        float ra = ha[0] * absR[0][j] + ha[1] * absR[1][j] + ha[2] * absR[2][j];
+        float distance = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+        float overlap = ra + hb[j] - std::abs(distance);
+        if (overlap < 0.0f) return false;
+        if (overlap < bestDepth) { bestDepth = overlap; bestAxis = b.axes[j]; bestFlip = distance < 0.0f; }
+    }
+
+    // Edge-edge axes must beat face axes by a margin; near-parallel edges
+    // otherwise win on rounding and give unstable contact normals
+    constexpr float EDGE_BIAS = 1.05f;
+    for (int i = 0; i < 3; i++) {
+        const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+        for (int j = 0; j < 3; j++) {
+            const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            float lengthSq = 1.0f - R[i][j] * R[i][j];
+            if (lengthSq < PARALLEL_EPSILON) continue; // parallel edges; covered by the face axes
+            float ra = ha[i1] * absR[i2][j] + ha[i2] * absR[i1][j];
+            float rb = hb[j1] * absR[i][j2] + hb[j2] * absR[i][j1];
+            float distance = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+            float overlap = ra + rb - std::abs(distance);
+            if (overlap < 0.0f) return false;
+            // overlap / length * EDGE_BIAS < bestDepth, squared to keep the
+            // square root off axes that lose
+            if (overlap * overlap * (EDGE_BIAS * EDGE_BIAS) >= bestDepth * bestDepth * lengthSq) continue;
+            float invLength = 1.0f / std::sqrt(lengthSq);
+            bestDepth = overlap * invLength;
+            bestAxis = glm::cross(a.axes[i], b.axes[j]) * invLength;
+            bestFlip = distance < 0.0f;
+        }
+    }
+
+    if (out) *out = {bestFlip ? -bestAxis : bestAxis, bestDepth};
+    return true;
+}
+
+} // namespace myth
@@ -0,0 +1,290 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MYTH_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define MYTH_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace myth {
+namespace simd {
+
+// Thin wrappers over SSE2/AVX2 registers with a shared interface, so batch
+// kernels can be written once as templates over the lane type and
+// instantiated at whatever width the build targets. Comparisons return
+// all-bits lane masks of the same type, consumed by select() and the bitwise
+// operators. Each float type has an unsigned 32-bit integer companion
+// (`Int`) with wrap-around arithmetic and logical shifts, for hashing and
+// bit tricks. Scalar Float4/UInt4 stand in on targets without SSE2.
+//
+// The width is fixed at compile time, with no runtime dispatch: FloatN is
+// Float8 only when the build targets AVX2 (MYTH_AVX2 in CMake, or -mavx2),
+// and such a binary needs an AVX2 CPU to run.
+
+#if MYTH_SIMD_SSE2
+
+struct UInt4 {
+    __m128i v;
+
+    UInt4() = default;
+    UInt4(__m128i x) : v(x) {}
+    UInt4(uint32_t x) : v(_mm_set1_epi32(static_cast<int>(x))) {}
+
+    friend UInt4 operator+(UInt4 a, UInt4 b) { return _mm_add_epi32(a.v, b.v); }
+    friend UInt4 operator-(UInt4 a, UInt4 b) { return _mm_sub_epi32(a.v, b.v); }
+    // Low 32 bits of the product; SSE2 only multiplies even lanes, so do both halves
+    friend UInt4 operator*(UInt4 a, UInt4 b) {
+        __m128i even = _mm_mul_epu32(a.v, b.v);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+    friend UInt4 operator&(UInt4 a, UInt4 b) { return _mm_and_si128(a.v, b.v); }
+    friend UInt4 operator|(UInt4 a, UInt4 b) { return _mm_or_si128(a.v, b.v); }
+    friend UInt4 operator^(UInt4 a, UInt4 b) { return _mm_xor_si128(a.v, b.v); }
+    friend UInt4 operator<<(UInt4 a, int n) { return _mm_sll_epi32(a.v, _mm_cvtsi32_si128(n)); }
+    friend UInt4 operator>>(UInt4 a, int n) { return _mm_srl_epi32(a.v, _mm_cvtsi32_si128(n)); }
+};
+
+struct Float4 {
+    static constexpr int Width = 4;
+    using Int = UInt4;
+    __m128 v;
+
+    Float4() = default;
+    Float4(__m128 x) : v(x) {}
+    Float4(float x) : v(_mm_set1_ps(x)) {}
+
+    static Float4 load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+
+    friend Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+    friend Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+    friend Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+    friend Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+    friend Float4 operator-(Float4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+    friend Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+    friend Float4 operator|(Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+    friend Float4 operator^(Float4 a, Float4 b) { return _mm_xor_ps(a.v, b.v); }
+    friend Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+    friend Float4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+    friend Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+    friend Float4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+    friend Float4 operator==(Float4 a, Float4 b) { return _mm_cmpeq_ps(a.v, b.v); }
+    friend Float4 operator!=(Float4 a, Float4 b) { return _mm_cmpneq_ps(a.v, b.v); }
+
+    friend Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+    friend Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+    friend Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+    friend Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+    // mask ? a : b
+    friend Float4 select(Float4 mask, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+    // Round to nearest integer; valid while |x| < 2^31
+    friend Float4 round(Float4 a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)); }
+    // Lanes where (int)round(a) has any of `bits` set
+    friend Float4 roundedBitsSet(Float4 a, int bits) {
+        __m128i b = _mm_and_si128(_mm_cvtps_epi32(a.v), _mm_set1_epi32(bits));
+        return _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(b, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+    }
+    friend int movemask(Float4 a) { return _mm_movemask_ps(a.v); }
+    // Round toward negative infinity; valid while |x| < 2^31
+    friend Float4 floor(Float4 a) {
+        __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+    }
+    // Truncated integer value of each lane, as two's complement bits
+    friend UInt4 truncate(Float4 a) { return _mm_cvttps_epi32(a.v); }
+};
+
+// Lanes read as signed integers
+inline Float4 toFloat(UInt4 a) { return _mm_cvtepi32_ps(a.v); }
+inline Float4 asFloat(UInt4 a) { return _mm_castsi128_ps(a.v); }
+
+#else
+
+struct UInt4 {
+    uint32_t v[4];
+
+    UInt4() = default;
+    UInt4(uint32_t x) { for (uint32_t& i : v) i = x; }
+
+    template<typename Op>
+    static UInt4 map(UInt4 a, UInt4 b, Op op) { UInt4 r; for (int i = 0; i < 4; i++) r.v[i] = op(a.v[i], b.v[i]); return r; }
+
+    friend UInt4 operator+(UInt4 a, UInt4 b) { return map(a, b, [](uint32_t x, uint32_t y) { return x + y; }); }
+    friend UInt4 operator-(UInt4 a, UInt4 b) { return map(a, b, [](uint32_t x, uint32_t y) { return x - y; }); }
+    friend UInt4 operator*(UInt4 a, UInt4 b) { return map(a, b, [](uint32_t x, uint32_t y) { return x * y; }); }
+    friend UInt4 operator&(UInt4 a, UInt4 b) { return map(a, b, [](uint32_t x, uint32_t y) { return x & y; }); }
+    friend UInt4 operator|(UInt4 a, UInt4 b) { return map(a, b, [](uint32_t x, uint32_t y) { return x | y; }); }
+    friend UInt4 operator^(UInt4 a, UInt4 b) { return map(a, b, [](uint32_t x, uint32_t y) { return x ^ y; }); }
+    friend UInt4 operator<<(UInt4 a, int n) { return map(a, a, [n](uint32_t x, uint32_t) { return x << n; }); }
+    friend UInt4 operator>>(UInt4 a, int n) { return map(a, a, [n](uint32_t x, uint32_t) { return x >> n; }); }
+};
+
+struct Float4 {
+    static constexpr int Width = 4;
+    using Int = UInt4;
+    float v[4];
+
+    Float4() = default;
+    Float4(float x) { for (float& f : v) f = x; }
+
+    static Float4 load(const float* p) { Float4 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+    void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+
+    template<typename Op>
+    static Float4 map(Float4 a, Float4 b, Op op) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = op(a.v[i], b.v[i]); return r; }
+    template<typename Op>
+    static Float4 bits(Float4 a, Float4 b, Op op) {
+        Float4 r;
+        for (int i = 0; i < 4; i++) { uint32_t x, y; std::memcpy(&x, &a.v[i], 4); std::memcpy(&y, &b.v[i], 4); x = op(x, y); std::memcpy(&r.v[i], &x, 4); }
+        return r;
+    }
+    static float maskOf(bool b) { uint32_t m = b ? 0xFFFFFFFFu : 0u; float f; std::memcpy(&f, &m, 4); return f; }
+    template<typename Op>
+    static Float4 cmp(Float4 a, Float4 b, Op op) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = maskOf(op(a.v[i], b.v[i])); return r; }
+
+    friend Float4 operator+(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x + y; }); }
+    friend Float4 operator-(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x - y; }); }
+    friend Float4 operator*(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x * y; }); }
+    friend Float4 operator/(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x / y; }); }
+    friend Float4 operator-(Float4 a) { return map(a, a, [](float x, float) { return -x; }); }
+    friend Float4 operator&(Float4 a, Float4 b) { return bits(a, b, [](uint32_t x, uint32_t y) { return x & y; }); }
+    friend Float4 operator|(Float4 a, Float4 b) { return bits(a, b, [](uint32_t x, uint32_t y) { return x | y; }); }
+    friend Float4 operator^(Float4 a, Float4 b) { return bits(a, b, [](uint32_t x, uint32_t y) { return x ^ y; }); }
+    friend Float4 operator<(Float4 a, Float4 b) { return cmp(a, b, [](float x, float y) { return x < y; }); }
+    friend Float4 operator<=(Float4 a, Float4 b) { return cmp(a, b, [](float x, float y) { return x <= y; }); }
+    friend Float4 operator>(Float4 a, Float4 b) { return cmp(a, b, [](float x, float y) { return x > y; }); }
+    friend Float4 operator>=(Float4 a, Float4 b) { return cmp(a, b, [](float x, float y) { return x >= y; }); }
+    friend Float4 operator==(Float4 a, Float4 b) { return cmp(a, b, [](float x, float y) { return x == y; }); }
+    friend Float4 operator!=(Float4 a, Float4 b) { return cmp(a, b, [](float x, float y) { return x != y; }); }
+
+    friend Float4 min(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return y < x ? y : x; }); }
+    friend Float4 max(Float4 a, Float4 b) { return map(a, b, [](float x, float y) { return x < y ? y : x; }); }
+    friend Float4 sqrt(Float4 a) { return map(a, a, [](float x, float) { return std::sqrt(x); }); }
+    friend Float4 abs(Float4 a) { return map(a, a, [](float x, float) { return std::fabs(x); }); }
+    friend Float4 select(Float4 mask, Float4 a, Float4 b) { return (mask & a) | bits(mask, b, [](uint32_t m, uint32_t y) { return ~m & y; }); }
+    friend Float4 round(Float4 a) { return map(a, a, [](float x, float) { return std::nearbyint(x); }); }
+    friend Float4 roundedBitsSet(Float4 a, int b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = maskOf((static_cast<int>(std::nearbyint(a.v[i])) & b) != 0); return r; }
+    friend int movemask(Float4 a) { int m = 0; for (int i = 0; i < 4; i++) { uint32_t x; std::memcpy(&x, &a.v[i], 4); m |= static_cast<int>(x >> 31) << i; } return m; }
+    friend Float4 floor(Float4 a) { return map(a, a, [](float x, float) { return std::floor(x); }); }
+    friend UInt4 truncate(Float4 a) { UInt4 r; for (int i = 0; i < 4; i++) r.v[i] = static_cast<uint32_t>(static_cast<int32_t>(a.v[i])); return r; }
+};
+
+inline Float4 toFloat(UInt4 a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = static_cast<float>(static_cast<int32_t>(a.v[i])); return r; }
+inline Float4 asFloat(UInt4 a) { Float4 r; std::memcpy(r.v, a.v, sizeof(r.v)); return r; }
+
+#endif
+
+#if MYTH_SIMD_AVX2
+
+struct UInt8 {
+    __m256i v;
+
+    UInt8() = default;
+    UInt8(__m256i x) : v(x) {}
+    UInt8(uint32_t x) : v(_mm256_set1_epi32(static_cast<int>(x))) {}
+
+    friend UInt8 operator+(UInt8 a, UInt8 b) { return _mm256_add_epi32(a.v, b.v); }
+    friend UInt8 operator-(UInt8 a, UInt8 b) { return _mm256_sub_epi32(a.v, b.v); }
+    friend UInt8 operator*(UInt8 a, UInt8 b) { return _mm256_mullo_epi32(a.v, b.v); }
+    friend UInt8 operator&(UInt8 a, UInt8 b) { return _mm256_and_si256(a.v, b.v); }
+    friend UInt8 operator|(UInt8 a, UInt8 b) { return _mm256_or_si256(a.v, b.v); }
+    friend UInt8 operator^(UInt8 a, UInt8 b) { return _mm256_xor_si256(a.v, b.v); }
+    friend UInt8 operator<<(UInt8 a, int n) { return _mm256_sll_epi32(a.v, _mm_cvtsi32_si128(n)); }
+    friend UInt8 operator>>(UInt8 a, int n) { return _mm256_srl_epi32(a.v, _mm_cvtsi32_si128(n)); }
+};
+
+struct Float8 {
+    static constexpr int Width = 8;
+    using Int = UInt8;
+    __m256 v;
+
+    Float8() = default;
+    Float8(__m256 x) : v(x) {}
+    Float8(float x) : v(_mm256_set1_ps(x)) {}
+
+    static Float8 load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+    friend Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+    friend Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+    friend Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+    friend Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+    friend Float8 operator-(Float8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+    friend Float8 operator&(Float8 a, Float8 b) { return _mm256_and_ps(a.v, b.v); }
+    friend Float8 operator|(Float8 a, Float8 b) { return _mm256_or_ps(a.v, b.v); }
+    friend Float8 operator^(Float8 a, Float8 b) { return _mm256_xor_ps(a.v, b.v); }
+    friend Float8 operator<(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+    friend Float8 operator<=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+    friend Float8 operator>(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+    friend Float8 operator>=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+    friend Float8 operator==(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+    friend Float8 operator!=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+
+    friend Float8 min(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+    friend Float8 max(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+    friend Float8 sqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+    friend Float8 abs(Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    friend Float8 select(Float8 mask, Float8 a, Float8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+    friend Float8 round(Float8 a) { return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    friend Float8 roundedBitsSet(Float8 a, int bits) {
+        __m256i b = _mm256_and_si256(_mm256_cvtps_epi32(a.v), _mm256_set1_epi32(bits));
+        return _mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpeq_epi32(b, _mm256_setzero_si256()), _mm256_set1_epi32(-1)));
+    }
+    friend int movemask(Float8 a) { return _mm256_movemask_ps(a.v); }
+    friend Float8 floor(Float8 a) { return _mm256_floor_ps(a.v); }
+    friend UInt8 truncate(Float8 a) { return _mm256_cvttps_epi32(a.v); }
+};
+
+inline Float8 toFloat(UInt8 a) { return _mm256_cvtepi32_ps(a.v); }
+inline Float8 asFloat(UInt8 a) { return _mm256_castsi256_ps(a.v); }
+
+// Widest lane type available in this build
+using FloatN = Float8;
+
+#else
+
+using FloatN = Float4;
+
+#endif
+
+// Sine and cosine of each lane (radians). Cody-Waite reduction by pi/2 and
+// the Cephes minimax polynomials on [-pi/4, pi/4]; max error ~1e-7 for
+// |x| < 8192.
+template<typename V>
+inline void sincos(V x, V& outSin, V& outCos) {
+    const V q = round(x * V(0.636619772367581343f));
+    V r = x - q * V(1.5703125f);
+    r = r - q * V(4.837512969970703125e-4f);
+    r = r - q * V(7.54978995489188216e-8f);
+
+    const V r2 = r * r;
+    V s = V(-1.9515295891e-4f);
+    s = s * r2 + V(8.3321608736e-3f);
+    s = s * r2 + V(-1.6666654611e-1f);
+    s = s * r2 * r + r;
+
+    V c = V(2.443315711809948e-5f);
+    c = c * r2 + V(-1.388731625493765e-3f);
+    c = c * r2 + V(4.166664568298827e-2f);
+    c = c * r2 * r2 - V(0.5f) * r2 + V(1.0f);
+
+    // Quadrant n = q mod 4: (sin, cos) = (s, c), (c, -s), (-s, -c), (-c, s)
+    const V swap = roundedBitsSet(q, 1);
+    const V signMask = V(-0.0f);
+    const V sinNeg = roundedBitsSet(q, 2) & signMask;
+    const V cosNeg = roundedBitsSet(q + V(1.0f), 2) & signMask;
+    outSin = select(swap, c, s) ^ sinNeg;
+    outCos = select(swap, s, c) ^ cosNeg;
+}
+
+} // namespace simd
+} // namespace myth
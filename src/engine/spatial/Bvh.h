@@ -0,0 +1,464 @@
+﻿#pragma once
+
+#include "engine/math/Bounds.h"
+#include "engine/math/SimdMath.h"
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace myth {
+
+// Bounding volume hierarchy over a set of boxes identified by index.
+// Built top-down with binned SAH, then kept valid by refitting as boxes move;
+// the owner rebuilds when refitting has degraded the tree too far (see
+// cost()). Rays traverse a four-wide copy of the tree whose nodes hold their
+// children's boxes side by side, so one SIMD slab test covers a whole node;
+// refits keep that copy in step. Queries are const and allocation free, so
+// any number of threads may query concurrently as long as nobody updates at
+// the same time.
+class Bvh {
+public:
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+    // 32 bytes. Interior nodes store their left child in `leftFirst` (the
+    // right child follows it); leaves store their first item and `count`.
+    struct Node {
+        glm::vec3 min;
+        uint32_t leftFirst;
+        glm::vec3 max;
+        uint32_t count;
+
+        bool isLeaf() const { return count > 0; }
+        Aabb bounds() const { return {min, max}; }
+    };
+
+    // 128 bytes: the boxes of up to four nodes taken from the two levels
+    // below a binary node, as [min/max][axis][lane]. A lane is a leaf when
+    // its count is nonzero (`child` is then its first item), otherwise
+    // `child` is another wide node. Unused lanes hold an inverted box that
+    // no ray enters.
+    struct WideNode {
+        float bounds[2][3][4];
+        uint32_t child[4];
+        uint32_t count[4];
+    };
+
+    // Rebuild over `bounds`; box i gets id i
+    void build(std::span<const Aabb> bounds);
+
+    // Renumber items so that ids follow leaf order: the item at position i of
+    // the old leafOrder() becomes id i. Owners that keep per-item data in
+    // the same order get sequential access from every leaf.
+    void adoptLeafOrder();
+    const std::vector<uint32_t>& leafOrder() const { return m_items; }
+
+    // Move box `id`. The tree is stale until the next refit().
+    void update(uint32_t id, const Aabb& bounds);
+
+    // Propagate updated boxes to the root. `full` refits every node and
+    // recomputes cost(); otherwise only the paths above moved boxes are walked.
+    void refit(bool full = false);
+
+    // SAH cost of the tree (node surface areas relative to the root) as of the
+    // last build() or full refit(), and the cost right after build()
+    float cost() const { return m_cost; }
+    float builtCost() const { return m_builtCost; }
+
+    size_t size() const { return m_bounds.size(); }
+    size_t nodeCount() const { return m_nodes.size(); }
+    size_t wideNodeCount() const { return m_wide.size(); }
+    const Aabb& bounds(uint32_t id) const { return m_bounds[id]; }
+    Aabb rootBounds() const { return m_nodes.empty() ? Aabb{} : m_nodes[0].bounds(); }
+
+    // Closest hit along `ray` within maxT. `intersect(id, maxT)` does the
+    // exact test against item `id` and returns its hit distance or FLT_MAX;
+    // it is only called for items whose box the ray enters.
+    // Returns the hit distance (FLT_MAX on a miss) and its id in `hitId`.
+    template<typename Func>
+    float raycast(const Ray& ray, float maxT, uint32_t& hitId, Func&& intersect) const;
+
+    // Closest hit against the items' boxes themselves
+    float raycast(const Ray& ray, float maxT, uint32_t& hitId) const {
+        return raycast(ray, maxT, hitId, [&](uint32_t id, float t) { return ray.intersect(m_bounds[id], t); });
+    }
+
+    // func(id) for every item whose box overlaps the query volume
+    template<typename Func>
+    void queryAabb(const Aabb& box, Func&& func) const {
+        query([&](const Aabb& b) { return b.overlaps(box); }, func);
+    }
+
+    template<typename Func>
+    void querySphere(const glm::vec3& center, float radius, Func&& func) const {
+        query([&](const Aabb& b) { return b.overlapsSphere(center, radius); }, func);
+    }
+
+    template<typename Func>
+    void queryFrustum(const Frustum& frustum, Func&& func) const {
+        query([&](const Aabb& b) { return frustum.intersects(b); }, func);
+    }
+
+private:
+    static constexpr int BIN_COUNT = 16;
+    static constexpr int STACK_SIZE = 64;
+    // A wide node pushes up to four lanes and the tree is at most 32 wide
+    // levels deep
+    static constexpr int RAY_STACK_SIZE = 128;
+    // Below this depth splits fall back to the median so the tree never
+    // outgrows the traversal stack
+    static constexpr int MAX_SAH_DEPTH = 32;
+
+    void subdivide(uint32_t node, int depth);
+    void updateLeafBounds(uint32_t node);
+    void updateInteriorBounds(uint32_t node);
+    uint32_t collapse(uint32_t node);
+    void writeLane(uint32_t node);
+
+    template<typename Test, typename Func>
+    void query(Test&& test, Func&& func) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_parents;  // node -> parent, UINT32_MAX for the root
+    std::vector<WideNode> m_wide;     // ray traversal copy, root first
+    std::vector<uint32_t> m_laneOf;   // node -> wide node * 4 + lane, UINT32_MAX if none
+    std::vector<uint32_t> m_items;    // item ids in leaf order
+    std::vector<uint32_t> m_leafOf;   // id -> leaf node holding it
+    std::vector<Aabb> m_bounds;       // id -> box
+    std::vector<glm::vec3> m_centroids;
+    std::vector<uint32_t> m_dirtyLeaves;
+    float m_cost = 0.0f;
+    float m_builtCost = 0.0f;
+};
+
+// ========================= Implementation ===================================
+
+inline void Bvh::build(std::span<const Aabb> bounds) {
+    const uint32_t count = static_cast<uint32_t>(bounds.size());
+    m_bounds.assign(bounds.begin(), bounds.end());
+    m_items.resize(count);
+    m_centroids.resize(count);
+    m_leafOf.assign(count, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        m_items[i] = i;
+        m_centroids[i] = m_bounds[i].center();
+    }
+
+    m_nodes.clear();
+    m_parents.clear();
+    m_wide.clear();
+    m_dirtyLeaves.clear();
+    if (count == 0) {
+        m_cost = m_builtCost = 0.0f;
+        return;
+    }
+
+    m_nodes.reserve(2 * count);
+    m_parents.reserve(2 * count);
+    m_nodes.push_back({{}, 0, {}, count});
+    m_parents.push_back(UINT32_MAX);
+    subdivide(0, 0);
+    m_laneOf.assign(m_nodes.size(), UINT32_MAX);
+    m_wide.reserve(m_nodes.size() / 2);
+    collapse(0);
+    refit(true);
+    m_builtCost = m_cost;
+}
+
+inline void Bvh::adoptLeafOrder() {
+    std::vector<Aabb> bounds(m_bounds.size());
+    for (size_t i = 0; i < m_items.size(); i++) {
+        bounds[i] = m_bounds[m_items[i]];
+        m_centroids[i] = bounds[i].center();
+    }
+    m_bounds.swap(bounds);
+    for (uint32_t n = 0; n < m_nodes.size(); n++) {
+        if (!m_nodes[n].isLeaf()) continue;
+        for (uint32_t i = 0; i < m_nodes[n].count; i++) m_leafOf[m_nodes[n].leftFirst + i] = n;
+    }
+    for (uint32_t i = 0; i < m_items.size(); i++) m_items[i] = i;
+}
+
+inline void Bvh::update(uint32_t id, const Aabb& bounds) {
+    if (m_bounds[id] == bounds) return;
+    m_bounds[id] = bounds;
+    m_dirtyLeaves.push_back(m_leafOf[id]);
+}
+
+inline void Bvh::refit(bool full) {
+    if (m_nodes.empty()) return;
+
+    // Touching more than a fraction of the leaves costs about as much as
+    // walking the whole tree once
+    if (full || m_dirtyLeaves.size() * 8 > m_nodes.size()) {
+        const float rootArea = [&] {
+            for (uint32_t n = static_cast<uint32_t>(m_nodes.size()); n-- > 0;) {
+                if (m_nodes[n].isLeaf()) updateLeafBounds(n);
+                else updateInteriorBounds(n);
+            }
+            return std::max(m_nodes[0].bounds().surfaceArea(), FLT_MIN);
+        }();
+        float cost = 0.0f;
+        for (const Node& node : m_nodes) {
+            cost += node.bounds().surfaceArea() * (node.isLeaf() ? static_cast<float>(node.count) : 1.0f);
+        }
+        m_cost = cost / rootArea;
+        m_dirtyLeaves.clear();
+        return;
+    }
+
+    for (uint32_t leaf : m_dirtyLeaves) {
+        Aabb before = m_nodes[leaf].bounds();
+        updateLeafBounds(leaf);
+        // Stop climbing once a node's box comes out unchanged
+        uint32_t n = leaf;
+        while (!(m_nodes[n].bounds() == before) && m_parents[n] != UINT32_MAX) {
+            n = m_parents[n];
+            before = m_nodes[n].bounds();
+            updateInteriorBounds(n);
+        }
+    }
+    m_dirtyLeaves.clear();
+}
+
+inline void Bvh::updateLeafBounds(uint32_t n) {
+    Node& node = m_nodes[n];
+    Aabb box;
+    for (uint32_t i = 0; i < node.count; i++) box.expand(m_bounds[m_items[node.leftFirst + i]]);
+    node.min = box.min;
+    node.max = box.max;
+    writeLane(n);
+}
+
+inline void Bvh::updateInteriorBounds(uint32_t n) {
+    Node& node = m_nodes[n];
+    const Node& l = m_nodes[node.leftFirst];
+    const Node& r = m_nodes[node.leftFirst + 1];
+    node.min = glm::min(l.min, r.min);
+    node.max = glm::max(l.max, r.max);
+    writeLane(n);
+}
+
+inline void Bvh::writeLane(uint32_t n) {
+    const uint32_t slot = m_laneOf[n];
+    if (slot == UINT32_MAX) return;
+    WideNode& wide = m_wide[slot / 4];
+    const uint32_t lane = slot % 4;
+    for (int axis = 0; axis < 3; axis++) {
+        wide.bounds[0][axis][lane] = m_nodes[n].min[axis];
+        wide.bounds[1][axis][lane] = m_nodes[n].max[axis];
+    }
+}
+
+// Wide node for binary node `n`: its children, with interior children
+// replaced by their own two children. Boxes are filled in by refit().
+inline uint32_t Bvh::collapse(uint32_t n) {
+    uint32_t lanes[4];
+    uint32_t laneCount = 0;
+    if (m_nodes[n].isLeaf()) {
+        lanes[laneCount++] = n;
+    } else {
+        for (uint32_t c = m_nodes[n].leftFirst; c < m_nodes[n].leftFirst + 2; c++) {
+            if (m_nodes[c].isLeaf()) {
+                lanes[laneCount++] = c;
+            } else {
+                lanes[laneCount++] = m_nodes[c].leftFirst;
+                lanes[laneCount++] = m_nodes[c].leftFirst + 1;
+            }
+        }
+    }
+
+    const uint32_t w = static_cast<uint32_t>(m_wide.size());
+    m_wide.emplace_back();
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        for (int axis = 0; axis < 3; axis++) {
+            m_wide[w].bounds[0][axis][lane] = FLT_MAX;
+            m_wide[w].bounds[1][axis][lane] = -FLT_MAX;
+        }
+        m_wide[w].child[lane] = 0;
+        m_wide[w].count[lane] = 0;
+    }
+    for (uint32_t lane = 0; lane < laneCount; lane++) {
+        const uint32_t c = lanes[lane];
+        m_laneOf[c] = w * 4 + lane;
+        // Recursing may reallocate m_wide, so don't hold a reference across it
+        const uint32_t child = m_nodes[c].isLeaf() ? m_nodes[c].leftFirst : collapse(c);
+        m_wide[w].child[lane] = child;
+        m_wide[w].count[lane] = m_nodes[c].count;
+    }
+    return w;
+}
+
+inline void Bvh::subdivide(uint32_t n, int depth) {
+    const uint32_t first = m_nodes[n].leftFirst;
+    const uint32_t count = m_nodes[n].count;
+
+    Aabb box, centroidBox;
+    for (uint32_t i = first; i < first + count; i++) {
+        box.expand(m_bounds[m_items[i]]);
+        centroidBox.expand(m_centroids[m_items[i]]);
+    }
+    m_nodes[n].min = box.min;
+    m_nodes[n].max = box.max;
+
+    auto makeLeaf = [&] {
+        for (uint32_t i = first; i < first + count; i++) m_leafOf[m_items[i]] = n;
+    };
+    if (count <= 1) { makeLeaf(); return; }
+
+    // Binned SAH: cost of each split plane, relative to the node's area
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = FLT_MAX;
+    const glm::vec3 span = centroidBox.max - centroidBox.min;
+    if (depth < MAX_SAH_DEPTH) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (span[axis] <= 0.0f) continue;
+            const float scale = BIN_COUNT / span[axis];
+            Aabb bins[BIN_COUNT];
+            uint32_t binCounts[BIN_COUNT] = {};
+            for (uint32_t i = first; i < first + count; i++) {
+                uint32_t id = m_items[i];
+                int b = std::min(BIN_COUNT - 1, static_cast<int>((m_centroids[id][axis] - centroidBox.min[axis]) * scale));
+                bins[b].expand(m_bounds[id]);
+                binCounts[b]++;
+            }
+
+            // Sweep from the right to get each plane's right-hand area and count
+            float rightArea[BIN_COUNT - 1];
+            uint32_t rightCount[BIN_COUNT - 1];
+            Aabb acc;
+            uint32_t sum = 0;
+            for (int b = BIN_COUNT - 1; b > 0; b--) {
+                acc.expand(bins[b]);
+                sum += binCounts[b];
+                rightArea[b - 1] = acc.surfaceArea();
+                rightCount[b - 1] = sum;
+            }
+            acc = Aabb{};
+            sum = 0;
+            for (int b = 0; b < BIN_COUNT - 1; b++) {
+                acc.expand(bins[b]);
+                sum += binCounts[b];
+                if (sum == 0 || rightCount[b] == 0) continue;
+                float cost = sum * acc.surfaceArea() + rightCount[b] * rightArea[b];
+                if (cost < bestCost) { bestCost = cost; bestAxis = axis; bestSplit = b; }
+            }
+        }
+    }
+
+    const float leafCost = count * box.surfaceArea();
+    const float traversalCost = box.surfaceArea(); // one node visit
+    if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || bestCost + traversalCost >= leafCost)) {
+        makeLeaf();
+        return;
+    }
+
+    uint32_t mid;
+    if (bestAxis >= 0) {
+        const float scale = BIN_COUNT / span[bestAxis];
+        const float lo = centroidBox.min[bestAxis];
+        auto* begin = m_items.data() + first;
+        auto* split = std::partition(begin, begin + count, [&](uint32_t id) {
+            return std::min(BIN_COUNT - 1, static_cast<int>((m_centroids[id][bestAxis] - lo) * scale)) <= bestSplit;
+        });
+        mid = static_cast<uint32_t>(split - m_items.data());
+    } else {
+        // Coincident centroids or too deep: split the widest axis at the median
+        int axis = span.x >= span.y && span.x >= span.z ? 0 : (span.y >= span.z ? 1 : 2);
+        mid = first + count / 2;
+        std::nth_element(m_items.begin() + first, m_items.begin() + mid, m_items.begin() + first + count,
+                         [&](uint32_t a, uint32_t b) { return m_centroids[a][axis] < m_centroids[b][axis]; });
+    }
+
+    const uint32_t left = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({{}, first, {}, mid - first});
+    m_nodes.push_back({{}, mid, {}, first + count - mid});
+    m_parents.push_back(n);
+    m_parents.push_back(n);
+    m_nodes[n].leftFirst = left;
+    m_nodes[n].count = 0;
+    subdivide(left, depth + 1);
+    subdivide(left + 1, depth + 1);
+}
+
+template<typename Func>
+float Bvh::raycast(const Ray& ray, float maxT, uint32_t& hitId, Func&& intersect) const {
+    using simd::Float4;
+    hitId = UINT32_MAX;
+    if (m_wide.empty()) return FLT_MAX;
+
+    // Slab test against the near and far planes picked by the ray's sign on
+    // each axis; an inverted box then gives tNear > tFar in every direction
+    const Float4 origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    const Float4 inv[3] = {ray.invDirection.x, ray.invDirection.y, ray.invDirection.z};
+    int nearSide[3];
+    for (int axis = 0; axis < 3; axis++) nearSide[axis] = ray.invDirection[axis] < 0.0f ? 1 : 0;
+
+    // Stack entries carry their entry distance so lanes queued before a
+    // closer hit was found can be skipped without touching them
+    struct Entry { uint32_t child; uint32_t count; float t; };
+    float closest = maxT;
+    Entry stack[RAY_STACK_SIZE];
+    int top = 0;
+    stack[top++] = {0, 0, 0.0f};
+    while (top > 0) {
+        const Entry entry = stack[--top];
+        if (entry.t > closest) continue;
+        if (entry.count > 0) {
+            for (uint32_t i = entry.child; i < entry.child + entry.count; i++) {
+                uint32_t id = m_items[i];
+                if (ray.intersect(m_bounds[id], closest) == FLT_MAX) continue;
+                float t = intersect(id, closest);
+                if (t < closest || (t == closest && hitId == UINT32_MAX)) { closest = t; hitId = id; }
+            }
+            continue;
+        }
+
+        const WideNode& node = m_wide[entry.child];
+        Float4 tNear(0.0f), tFar(closest);
+        for (int axis = 0; axis < 3; axis++) {
+            tNear = max(tNear, (Float4::load(node.bounds[nearSide[axis]][axis]) - origin[axis]) * inv[axis]);
+            tFar = min(tFar, (Float4::load(node.bounds[1 - nearSide[axis]][axis]) - origin[axis]) * inv[axis]);
+        }
+        int hits = movemask(tNear <= tFar);
+        if (hits == 0) continue;
+
+        // Push the lanes hit farthest first so the nearest is visited next
+        float t[4];
+        tNear.store(t);
+        int lanes[4];
+        int hitCount = 0;
+        for (; hits != 0; hits &= hits - 1) lanes[hitCount++] = std::countr_zero(static_cast<unsigned>(hits));
+        for (int i = 1; i < hitCount; i++) {
+            for (int j = i; j > 0 && t[lanes[j - 1]] < t[lanes[j]]; j--) std::swap(lanes[j - 1], lanes[j]);
+        }
+        for (int i = 0; i < hitCount; i++) {
+            const int lane = lanes[i];
+            stack[top++] = {node.child[lane], node.count[lane], t[lane]};
+        }
+    }
+    return hitId == UINT32_MAX ? FLT_MAX : closest;
+}
+
+template<typename Test, typename Func>
+void Bvh::query(Test&& test, Func&& func) const {
+    if (m_nodes.empty()) return;
+    uint32_t stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = m_nodes[stack[--top]];
+        if (!test(node.bounds())) continue;
+        if (node.isLeaf()) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                uint32_t id = m_items[node.leftFirst + i];
+                if (test(m_bounds[id])) func(id);
+            }
+        } else {
+            stack[top++] = node.leftFirst + 1;
+            stack[top++] = node.leftFirst;
+        }
+    }
+}
+
+} // namespace myth
@@ -0,0 +1,432 @@
+﻿#pragma once
+
+#include "engine/math/Bounds.h"
+#include "engine/math/SimdMath.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace myth {
+
+// Sort-and-sweep broadphase. Bodies stay sorted by their lower bound on one
+// axis between frames; as bodies move only a little per step, re-sorting with
+// insertion sort costs close to O(n). The sweep then only compares bodies
+// whose intervals overlap on that axis. Static and dynamic bodies are kept in
+// separate lists: static ones are never re-sorted unless moved and never
+// compared with each other, so a large static world costs one walk over its
+// list per findPairs().
+//
+// A world spread over two axes would give each body every neighbour in a
+// slab across the whole world as a candidate, so the sweep runs per band of
+// the second-most spread axis instead: each list is split into bands of
+// that cross axis after sorting, bodies straddling a boundary going into
+// every band they touch, and a pair is reported only by the band holding the
+// start of its overlap. Within a band the sweep tests a run of candidates
+// per SIMD instruction on all three axes.
+class SweepAndPrune {
+public:
+    // Replace every body; body i gets id i. Sorts along chooseAxis(bounds).
+    void reset(std::span<const Aabb> bounds, std::span<const uint8_t> isStatic);
+
+    // The axis along which the boxes' centers are most spread out
+    static int chooseAxis(std::span<const Aabb> bounds) { return rankAxes(bounds)[0]; }
+
+    // Move body `id`. Takes effect for queries after the next sort().
+    void update(uint32_t id, const Aabb& bounds) {
+        const bool staticBody = m_static[id] != 0;
+        m_lists[staticBody].entries[m_slots[id]] = Entry(bounds);
+        m_moved[staticBody] = true;
+        m_maxWidth = std::max(m_maxWidth, bounds.max[m_axis] - bounds.min[m_axis]);
+    }
+
+    // Restore sorted order after update(). Returns the number of swaps.
+    size_t sort();
+
+    // func(a, b) for every overlapping pair with at least one dynamic body
+    template<typename Func>
+    void findPairs(Func&& func) const;
+
+    // func(a, b) for the pairs findPairs() reports in which moved(a) or
+    // moved(b), each once. Only moved dynamic bodies are swept, in sweep
+    // order; static bodies moved by the last sort(), which is rare, are
+    // looked up one at a time. Pairs of unmoved bodies are as they were.
+    template<typename Moved, typename Func>
+    void findPairs(Moved&& moved, Func&& func) const;
+
+    // func(id) for every body whose box overlaps `box`
+    template<typename Func>
+    void queryAabb(const Aabb& box, Func&& func) const;
+
+    size_t size() const { return m_slots.size(); }
+    Aabb bounds(uint32_t id) const { return m_lists[m_static[id]].entries[m_slots[id]].box(); }
+    bool isStatic(uint32_t id) const { return m_static[id] != 0; }
+    int axis() const { return m_axis; }
+    uint32_t bandCount() const { return m_bandCount; }
+
+private:
+    // A box as two 4-wide rows (w unused and zero) so one pair of SIMD
+    // compares tests all three axes without branching on each
+    struct alignas(16) Entry {
+        float min[4];
+        float max[4];
+
+        Entry() = default;
+        explicit Entry(const Aabb& b) : min{b.min.x, b.min.y, b.min.z, 0.0f}, max{b.max.x, b.max.y, b.max.z, 0.0f} {}
+        Aabb box() const { return {{min[0], min[1], min[2]}, {max[0], max[1], max[2]}}; }
+    };
+
+    // One band's share of a list, still in sweep order: min x/y/z then
+    // max x/y/z columns padded with boxes no sweep reaches, so SIMD loads
+    // can run past the end, and the ids the sweep reads once it finds an
+    // overlap
+    struct Band {
+        std::vector<float> columns[6];
+        std::vector<uint32_t> ids;
+    };
+
+    // Entries sorted by min[m_axis], with their ids alongside, and the
+    // bands they were last split into
+    struct List {
+        std::vector<Entry> entries;
+        std::vector<uint32_t> ids;
+        std::vector<Band> bands;
+    };
+
+    static bool overlaps(const Entry& a, const Entry& b) {
+        using simd::Float4;
+        Float4 separated = (Float4::load(a.max) < Float4::load(b.min)) | (Float4::load(b.max) < Float4::load(a.min));
+        return movemask(separated) == 0;
+    }
+
+    // Target bodies per band, and a cap on the number of bands
+    static constexpr uint32_t BAND_BODIES = 1024;
+    static constexpr uint32_t MAX_BANDS = 64;
+
+    // Axes ordered by how spread out the boxes' centers are along them
+    static std::array<int, 3> rankAxes(std::span<const Aabb> bounds);
+
+    uint32_t bandOf(float cross) const {
+        const float band = std::clamp((cross - m_bandOrigin) * m_bandScale, 0.0f, static_cast<float>(m_bandCount - 1));
+        return static_cast<uint32_t>(band);
+    }
+
+    size_t insertionSort(List& list);
+    void split(List& list) const;
+
+    template<typename Func>
+    void findPairs(uint32_t band, Func&& func) const;
+    template<typename Moved, typename Func>
+    void findPairs(uint32_t band, Moved&& moved, Func&& func) const;
+
+    // func(other) for every dynamic body overlapping static body `id`,
+    // searching each band it touches from the first entry that could reach it
+    template<typename Func>
+    void findDynamicOverlaps(uint32_t id, Func&& func) const;
+
+    static Entry entryAt(const Band& band, size_t i) {
+        Entry e;
+        for (int a = 0; a < 3; a++) {
+            e.min[a] = band.columns[a][i];
+            e.max[a] = band.columns[3 + a][i];
+        }
+        e.min[3] = e.max[3] = 0.0f;
+        return e;
+    }
+
+    // A pair straddling several bands belongs to the one where its overlap
+    // on the cross axis begins
+    bool owned(uint32_t band, float crossA, float crossB) const {
+        return m_bandCount == 1 || bandOf(std::max(crossA, crossB)) == band;
+    }
+
+    // func(j) for every body j >= from of `band` that overlaps `box`,
+    // stopping at the first that starts past its end on the sweep axis
+    template<typename Func>
+    void sweep(const Band& band, size_t from, const Entry& box, Func&& func) const;
+
+    int m_axis = 0;
+    int m_crossAxis = 1;
+    float m_maxWidth = 0.0f; // widest body on the axis seen since reset()
+    bool m_moved[2] = {};    // lists updated since the last sort()
+    bool m_staticMoved = false; // the last sort() had static bodies to re-sort
+    uint32_t m_bandCount = 1;
+    float m_bandOrigin = 0.0f;
+    float m_bandScale = 0.0f; // bands per unit along the cross axis
+    List m_lists[2];               // dynamic, static
+    std::vector<uint32_t> m_slots; // id -> index into its list
+    std::vector<uint8_t> m_static; // id -> which list
+};
+
+// ========================= Implementation ===================================
+
+inline std::array<int, 3> SweepAndPrune::rankAxes(std::span<const Aabb> bounds) {
+    std::array<int, 3> axes = {0, 1, 2};
+    if (bounds.empty()) return axes;
+    const float count = static_cast<float>(bounds.size());
+    glm::vec3 sum(0.0f), sumSq(0.0f);
+    for (const Aabb& b : bounds) {
+        glm::vec3 c = b.center();
+        sum += c;
+        sumSq += c * c;
+    }
+    glm::vec3 variance = sumSq / count - (sum / count) * (sum / count);
+    std::stable_sort(axes.begin(), axes.end(), [&](int a, int b) { return variance[a] > variance[b]; });
+    return axes;
+}
+
+inline void SweepAndPrune::reset(std::span<const Aabb> bounds, std::span<const uint8_t> isStatic) {
+    const uint32_t count = static_cast<uint32_t>(bounds.size());
+    const std::array<int, 3> axes = rankAxes(bounds);
+    m_axis = axes[0];
+    m_crossAxis = axes[1];
+
+    std::vector<uint32_t> order[2];
+    m_static.resize(count);
+    m_maxWidth = 0.0f;
+    float crossWidth = 0.0f, crossMin = FLT_MAX, crossMax = -FLT_MAX;
+    for (uint32_t i = 0; i < count; i++) {
+        m_static[i] = isStatic[i] ? 1 : 0;
+        order[m_static[i]].push_back(i);
+        m_maxWidth = std::max(m_maxWidth, bounds[i].max[m_axis] - bounds[i].min[m_axis]);
+        crossWidth = std::max(crossWidth, bounds[i].max[m_crossAxis] - bounds[i].min[m_crossAxis]);
+        crossMin = std::min(crossMin, bounds[i].center()[m_crossAxis]);
+        crossMax = std::max(crossMax, bounds[i].center()[m_crossAxis]);
+    }
+
+    // Bands several bodies wide, so few bodies straddle a boundary. Bodies
+    // that later move outside the range fall into the outermost bands.
+    const float span = count > 0 ? crossMax - crossMin : 0.0f;
+    m_bandCount = std::clamp(count / BAND_BODIES, 1u, MAX_BANDS);
+    if (crossWidth > 0.0f) {
+        m_bandCount = std::clamp(static_cast<uint32_t>(span / (4.0f * crossWidth)), 1u, m_bandCount);
+    }
+    m_bandOrigin = crossMin;
+    m_bandScale = span > 0.0f ? static_cast<float>(m_bandCount) / span : 0.0f;
+
+    const int axis = m_axis;
+    m_slots.resize(count);
+    for (int l = 0; l < 2; l++) {
+        std::sort(order[l].begin(), order[l].end(),
+                  [&](uint32_t a, uint32_t b) { return bounds[a].min[axis] < bounds[b].min[axis]; });
+        List& list = m_lists[l];
+        list.entries.resize(order[l].size());
+        list.ids = order[l];
+        for (uint32_t i = 0; i < list.ids.size(); i++) {
+            list.entries[i] = Entry(bounds[list.ids[i]]);
+            m_slots[list.ids[i]] = i;
+        }
+        split(list);
+        m_moved[l] = false;
+    }
+    m_staticMoved = false;
+}
+
+inline size_t SweepAndPrune::sort() {
+    size_t swaps = 0;
+    m_staticMoved = m_moved[1];
+    for (int l = 0; l < 2; l++) {
+        if (!m_moved[l]) continue;
+        swaps += insertionSort(m_lists[l]);
+        split(m_lists[l]);
+        m_moved[l] = false;
+    }
+    return swaps;
+}
+
+inline void SweepAndPrune::split(List& list) const {
+    // Count each band's share first so the columns are filled in place
+    std::array<uint32_t, MAX_BANDS> fill{};
+    for (const Entry& e : list.entries) {
+        const uint32_t last = bandOf(e.max[m_crossAxis]);
+        for (uint32_t b = bandOf(e.min[m_crossAxis]); b <= last; b++) fill[b]++;
+    }
+    list.bands.resize(m_bandCount);
+    for (uint32_t b = 0; b < m_bandCount; b++) {
+        Band& band = list.bands[b];
+        band.ids.resize(fill[b]);
+        for (int c = 0; c < 6; c++) {
+            band.columns[c].resize(fill[b] + simd::FloatN::Width);
+            std::fill(band.columns[c].begin() + fill[b], band.columns[c].end(), c < 3 ? FLT_MAX : -FLT_MAX);
+        }
+        fill[b] = 0;
+    }
+
+    for (size_t i = 0; i < list.entries.size(); i++) {
+        const Entry& e = list.entries[i];
+        const uint32_t last = bandOf(e.max[m_crossAxis]);
+        for (uint32_t b = bandOf(e.min[m_crossAxis]); b <= last; b++) {
+            Band& band = list.bands[b];
+            const uint32_t k = fill[b]++;
+            for (int a = 0; a < 3; a++) {
+                band.columns[a][k] = e.min[a];
+                band.columns[3 + a][k] = e.max[a];
+            }
+            band.ids[k] = list.ids[i];
+        }
+    }
+}
+
+inline size_t SweepAndPrune::insertionSort(List& list) {
+    const int axis = m_axis;
+    Entry* entries = list.entries.data();
+    uint32_t* ids = list.ids.data();
+    size_t swaps = 0;
+    for (size_t i = 1; i < list.entries.size(); i++) {
+        if (entries[i - 1].min[axis] <= entries[i].min[axis]) continue;
+        const Entry moving = entries[i];
+        const uint32_t movingId = ids[i];
+        size_t j = i;
+        for (; j > 0 && entries[j - 1].min[axis] > moving.min[axis]; j--) {
+            entries[j] = entries[j - 1];
+            ids[j] = ids[j - 1];
+            m_slots[ids[j]] = static_cast<uint32_t>(j);
+        }
+        entries[j] = moving;
+        ids[j] = movingId;
+        m_slots[movingId] = static_cast<uint32_t>(j);
+        swaps += i - j;
+    }
+    return swaps;
+}
+
+template<typename Func>
+void SweepAndPrune::findPairs(Func&& func) const {
+    for (uint32_t band = 0; band < m_bandCount; band++) findPairs(band, func);
+}
+
+template<typename Func>
+void SweepAndPrune::findPairs(uint32_t b, Func&& func) const {
+    const Band& dynamic = m_lists[0].bands[b];
+    const Band& statics = m_lists[1].bands[b];
+    const size_t dynamicCount = dynamic.ids.size();
+    const size_t staticCount = statics.ids.size();
+    const float* dynamicMin = dynamic.columns[m_axis].data();
+    const float* staticMin = statics.columns[m_axis].data();
+    const float* dynamicCross = dynamic.columns[m_crossAxis].data();
+    const float* staticCross = statics.columns[m_crossAxis].data();
+
+    for (size_t i = 0; i < dynamicCount; i++) {
+        sweep(dynamic, i + 1, entryAt(dynamic, i), [&](size_t j) {
+            if (owned(b, dynamicCross[i], dynamicCross[j])) func(dynamic.ids[i], dynamic.ids[j]);
+        });
+    }
+
+    // Dynamic against static: each dynamic body is swept from the first
+    // static one that could reach it, which only moves forward, so the
+    // static list costs one walk however few dynamic bodies there are
+    size_t first = 0;
+    for (size_t i = 0; i < dynamicCount; i++) {
+        const float from = dynamicMin[i] - m_maxWidth;
+        while (first < staticCount && staticMin[first] < from) first++;
+        sweep(statics, first, entryAt(dynamic, i), [&](size_t j) {
+            if (owned(b, dynamicCross[i], staticCross[j])) func(dynamic.ids[i], statics.ids[j]);
+        });
+    }
+}
+
+template<typename Moved, typename Func>
+void SweepAndPrune::findPairs(Moved&& moved, Func&& func) const {
+    for (uint32_t band = 0; band < m_bandCount; band++) findPairs(band, moved, func);
+    if (!m_staticMoved) return;
+    const List& statics = m_lists[1];
+    for (uint32_t id : statics.ids) {
+        if (!moved(id)) continue;
+        // Moved dynamic bodies found their pairs with it already
+        findDynamicOverlaps(id, [&](uint32_t other) {
+            if (!moved(other)) func(other, id);
+        });
+    }
+}
+
+template<typename Moved, typename Func>
+void SweepAndPrune::findPairs(uint32_t b, Moved&& moved, Func&& func) const {
+    const Band& dynamic = m_lists[0].bands[b];
+    const Band& statics = m_lists[1].bands[b];
+    const size_t dynamicCount = dynamic.ids.size();
+    const size_t staticCount = statics.ids.size();
+    const float* dynamicMin = dynamic.columns[m_axis].data();
+    const float* staticMin = statics.columns[m_axis].data();
+    const float* dynamicCross = dynamic.columns[m_crossAxis].data();
+    const float* staticCross = statics.columns[m_crossAxis].data();
+
+    // As findPairs(), but a moved body also looks back for unmoved dynamic
+    // bodies that start before it; a pair of moved ones is found by the
+    // one that comes first
+    size_t back = 0, first = 0;
+    for (size_t i = 0; i < dynamicCount; i++) {
+        if (!moved(dynamic.ids[i])) continue;
+        const float from = dynamicMin[i] - m_maxWidth;
+        const Entry box = entryAt(dynamic, i);
+        while (dynamicMin[back] < from) back++;
+        sweep(dynamic, back, box, [&](size_t j) {
+            if (j == i || (j < i && moved(dynamic.ids[j]))) return;
+            if (owned(b, dynamicCross[i], dynamicCross[j])) func(dynamic.ids[i], dynamic.ids[j]);
+        });
+        while (first < staticCount && staticMin[first] < from) first++;
+        sweep(statics, first, box, [&](size_t j) {
+            if (owned(b, dynamicCross[i], staticCross[j])) func(dynamic.ids[i], statics.ids[j]);
+        });
+    }
+}
+
+template<typename Func>
+void SweepAndPrune::findDynamicOverlaps(uint32_t id, Func&& func) const {
+    const Entry& box = m_lists[1].entries[m_slots[id]];
+    const float from = box.min[m_axis] - m_maxWidth;
+    const uint32_t last = bandOf(box.max[m_crossAxis]);
+    for (uint32_t b = bandOf(box.min[m_crossAxis]); b <= last; b++) {
+        const Band& band = m_lists[0].bands[b];
+        const float* start = band.columns[m_axis].data();
+        const float* cross = band.columns[m_crossAxis].data();
+        const size_t first = std::lower_bound(start, start + band.ids.size(), from) - start;
+        sweep(band, first, box, [&](size_t j) {
+            if (owned(b, box.min[m_crossAxis], cross[j])) func(band.ids[j]);
+        });
+    }
+}
+
+template<typename Func>
+void SweepAndPrune::sweep(const Band& band, size_t from, const Entry& box, Func&& func) const {
+    using V = simd::FloatN;
+    constexpr int W = V::Width;
+    const float* minX = band.columns[0].data();
+    const float* minY = band.columns[1].data();
+    const float* minZ = band.columns[2].data();
+    const float* maxX = band.columns[3].data();
+    const float* maxY = band.columns[4].data();
+    const float* maxZ = band.columns[5].data();
+    const float* start = band.columns[m_axis].data();
+    const V loX(box.min[0]), loY(box.min[1]), loZ(box.min[2]);
+    const V hiX(box.max[0]), hiY(box.max[1]), hiZ(box.max[2]);
+    const V end(box.max[m_axis]);
+
+    // Padding starts past every box, so the loop ends within the band
+    for (size_t j = from;; j += W) {
+        const V reached = V::load(start + j) <= end;
+        const V hit = reached & (V::load(minX + j) <= hiX) & (loX <= V::load(maxX + j)) &
+                      (V::load(minY + j) <= hiY) & (loY <= V::load(maxY + j)) &
+                      (V::load(minZ + j) <= hiZ) & (loZ <= V::load(maxZ + j));
+        for (int m = movemask(hit); m != 0; m &= m - 1) func(j + std::countr_zero(static_cast<unsigned>(m)));
+        if (movemask(reached) != (1 << W) - 1) return;
+    }
+}
+
+template<typename Func>
+void SweepAndPrune::queryAabb(const Aabb& box, Func&& func) const {
+    // No body starting before this can reach the query
+    const int axis = m_axis;
+    const float from = box.min[axis] - m_maxWidth;
+    const Entry query(box);
+    for (const List& list : m_lists) {
+        auto it = std::lower_bound(list.entries.begin(), list.entries.end(), from,
+                                   [axis](const Entry& e, float value) { return e.min[axis] < value; });
+        for (; it != list.entries.end() && it->min[axis] <= box.max[axis]; ++it) {
+            if (overlaps(*it, query)) func(list.ids[it - list.entries.begin()]);
+        }
+    }
+}
+
+} // namespace myth
@@ -0,0 +1,138 @@
+﻿#include "TerrainBuffer.h"
+#include <cstring>
+
+namespace myth {
+namespace vk {
+
+void TerrainBuffer::init(VulkanContext* ctx, uint32_t slotCount, uint32_t verticesPerSlot, uint32_t indicesPerSlot, uint32_t uploadsPerFrame,
+                         VkDeviceSize ringSize) {
+    m_context = ctx;
+    m_verticesPerSlot = verticesPerSlot;
+    m_indicesPerSlot = indicesPerSlot;
+    m_uploadsPerFrame = uploadsPerFrame;
+    m_vertexBuffer.create(ctx, VkDeviceSize(slotCount) * verticesPerSlot * sizeof(Vertex),
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    m_indexBuffer.create(ctx, VkDeviceSize(slotCount) * indicesPerSlot * sizeof(uint32_t),
+                         VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    m_ring.init(ctx, ringSize);
+
+    m_freeSlots.resize(slotCount);
+    for (uint32_t i = 0; i < slotCount; i++) m_freeSlots[i] = slotCount - 1 - i; // low slots first
+}
+
+void TerrainBuffer::destroy() {
+    m_ring.destroy();
+    m_indexBuffer.destroy();
+    m_vertexBuffer.destroy();
+    m_resident.clear();
+    m_freeSlots.clear();
+    m_retired.clear();
+}
+
+void TerrainBuffer::beginFrame() {
+    m_frameNumber++;
+    m_ring.beginFrame(m_frameNumber);
+    m_stagedUploads = 0;
+    m_vertexCopies.clear();
+    m_indexCopies.clear();
+
+    // A slot last drawn MAX_FRAMES_IN_FLIGHT frames ago is no longer read
+    size_t kept = 0;
+    for (const Retired& r : m_retired) {
+        if (r.frameNumber + MAX_FRAMES_IN_FLIGHT <= m_frameNumber) m_freeSlots.push_back(r.slot);
+        else m_retired[kept++] = r;
+    }
+    m_retired.resize(kept);
+}
+
+bool TerrainBuffer::upload(ChunkCoord coord, const ChunkGeometry& geometry) {
+    if (geometry.vertexCount > m_verticesPerSlot || geometry.indexCount > m_indicesPerSlot) throw std::runtime_error("Chunk exceeds terrain slot size");
+    if (!geometry.vertices || (geometry.handle && !m_ring.isLive(geometry.handle))) return true; // already copied
+    if (m_freeSlots.empty() || m_stagedUploads == m_uploadsPerFrame) return false;
+
+    const VkDeviceSize vertexBytes = VkDeviceSize(geometry.vertexCount) * sizeof(Vertex);
+    const VkDeviceSize indexBytes = VkDeviceSize(geometry.indexCount) * sizeof(uint32_t);
+    VkDeviceSize vertexOffset, indexOffset;
+    uint64_t id = geometry.handle;
+    if (id) {
+        vertexOffset = reinterpret_cast<const char*>(geometry.vertices) - m_ring.base();
+        indexOffset = reinterpret_cast<const char*>(geometry.indices) - m_ring.base();
+    } else {
+        UploadRing::Allocation a;
+        if (!m_ring.allocate(vertexBytes + indexBytes, a)) return false;
+        std::memcpy(a.data, geometry.vertices, vertexBytes);
+        std::memcpy(static_cast<char*>(a.data) + vertexBytes, geometry.indices, indexBytes);
+        vertexOffset = a.offset;
+        indexOffset = a.offset + vertexBytes;
+        id = a.id;
+    }
+
+    // A resident chunk may still be drawn by a frame in flight, so its
+    // replacement goes to a fresh slot
+    auto it = m_resident.find(coord);
+    if (it != m_resident.end()) {
+        retire(it->second.slot);
+        m_resident.erase(it);
+    }
+    const uint32_t slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+
+    m_vertexCopies.push_back({vertexOffset, VkDeviceSize(slot) * m_verticesPerSlot * sizeof(Vertex), vertexBytes});
+    m_indexCopies.push_back({indexOffset, VkDeviceSize(slot) * m_indicesPerSlot * sizeof(uint32_t), indexBytes});
+    m_stagedUploads++;
+    m_ring.release(id); // reusable once this frame's copies have executed
+
+    m_resident[coord] = {slot, geometry.indexCount};
+    return true;
+}
+
+void TerrainBuffer::release(ChunkCoord coord) {
+    auto it = m_resident.find(coord);
+    if (it == m_resident.end()) return;
+    retire(it->second.slot);
+    m_resident.erase(it);
+}
+
+bool TerrainBuffer::allocate(uint32_t maxVertices, uint32_t maxIndices, ChunkGeometry& out) {
+    const VkDeviceSize vertexBytes = VkDeviceSize(maxVertices) * sizeof(Vertex);
+    UploadRing::Allocation a;
+    if (!m_ring.allocate(vertexBytes + VkDeviceSize(maxIndices) * sizeof(uint32_t), a)) return false;
+    out.vertices = static_cast<Vertex*>(a.data);
+    out.indices = reinterpret_cast<uint32_t*>(static_cast<char*>(a.data) + vertexBytes);
+    out.handle = a.id;
+    return true;
+}
+
+void TerrainBuffer::release(const ChunkGeometry& geometry) {
+    m_ring.release(geometry.handle);
+}
+
+void TerrainBuffer::retire(uint32_t slot) {
+    m_retired.push_back({slot, m_frameNumber});
+}
+
+void TerrainBuffer::recordUploads(VkCommandBuffer cmd) {
+    if (m_vertexCopies.empty()) return;
+    VkBuffer staging = m_ring.buffer();
+    vkCmdCopyBuffer(cmd, staging, m_vertexBuffer.buffer(), static_cast<uint32_t>(m_vertexCopies.size()), m_vertexCopies.data());
+    vkCmdCopyBuffer(cmd, staging, m_indexBuffer.buffer(), static_cast<uint32_t>(m_indexCopies.size()), m_indexCopies.data());
+
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void TerrainBuffer::draw(VkCommandBuffer cmd) const {
+    if (m_resident.empty()) return;
+    VkBuffer vb[] = {m_vertexBuffer.buffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(cmd, 0, 1, vb, offsets);
+    vkCmdBindIndexBuffer(cmd, m_indexBuffer.buffer(), 0, VK_INDEX_TYPE_UINT32);
+    for (const auto& [coord, r] : m_resident) {
+        vkCmdDrawIndexed(cmd, r.indexCount, 1, r.slot * m_indicesPerSlot, static_cast<int32_t>(r.slot * m_verticesPerSlot), 0);
+    }
+}
+
+} // namespace vk
+} // namespace myth
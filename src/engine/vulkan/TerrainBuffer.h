@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "UploadRing.h"
+#include "VulkanBuffer.h"
+#include "VulkanContext.h"
+#include "VulkanTypes.h"
+#include "engine/world/ChunkManager.h"
+#include <unordered_map>
+#include <vector>
+
+namespace myth {
+namespace vk {
+
+// Persistent terrain geometry: one vertex and one index buffer, each split
+// into equal per-chunk slots handed out from a free list. Loading a chunk
+// records a copy from the upload ring into its own slot; unloading returns
+// the slot once no frame in flight can still draw it. Nothing waits on the
+// device, and work is proportional to the chunks that changed.
+//
+// As the ChunkManager's allocator, it lets generation jobs write geometry
+// straight into the ring, so upload() only records the copy. Chunks that
+// found the ring full are copied into it by upload() instead.
+class TerrainBuffer : public ChunkAllocator {
+public:
+    void init(VulkanContext* ctx, uint32_t slotCount, uint32_t verticesPerSlot, uint32_t indicesPerSlot, uint32_t uploadsPerFrame,
+              VkDeviceSize ringSize);
+    void destroy();
+
+    // Call once per frame after waiting on that frame's fence, before upload()
+    void beginFrame();
+
+    // Place (or replace) the geometry for `coord`. Returns false when this
+    // frame is out of slots or upload space; try again next frame. Geometry
+    // from the ring is consumed: a second upload of it, or of geometry
+    // cleared by ChunkManager::releaseGeometry(), does nothing.
+    bool upload(ChunkCoord coord, const ChunkGeometry& geometry);
+    void release(ChunkCoord coord);
+
+    // ChunkAllocator, called from generation jobs and the simulation
+    bool allocate(uint32_t maxVertices, uint32_t maxIndices, ChunkGeometry& out) override;
+    void release(const ChunkGeometry& geometry) override;
+
+    // Outside a render pass: copies staged this frame, then a barrier
+    // making them visible to vertex input
+    void recordUploads(VkCommandBuffer cmd);
+
+    // Inside the render pass with the terrain pipeline and material bound
+    void draw(VkCommandBuffer cmd) const;
+
+    size_t residentCount() const { return m_resident.size(); }
+
+private:
+    struct Resident {
+        uint32_t slot;
+        uint32_t indexCount;
+    };
+
+    struct Retired {
+        uint32_t slot;
+        uint64_t frameNumber; // frame that last drew it
+    };
+
+    void retire(uint32_t slot);
+
+    VulkanContext* m_context = nullptr;
+    uint32_t m_verticesPerSlot = 0;
+    uint32_t m_indicesPerSlot = 0;
+    uint32_t m_uploadsPerFrame = 0;
+    VulkanBuffer m_vertexBuffer;
+    VulkanBuffer m_indexBuffer;
+
+    std::unordered_map<ChunkCoord, Resident, ChunkCoordHash> m_resident;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<Retired> m_retired;
+    uint64_t m_frameNumber = 0;
+
+    UploadRing m_ring;
+    uint32_t m_stagedUploads = 0;
+    std::vector<VkBufferCopy> m_vertexCopies;
+    std::vector<VkBufferCopy> m_indexCopies;
+};
+
+} // namespace vk
+} // namespace myth
@@ -0,0 +1,73 @@
+﻿#include "UploadRing.h"
+
+namespace myth {
+namespace vk {
+
+void UploadRing::init(VulkanContext* ctx, VkDeviceSize capacity) {
+    m_buffer.create(ctx, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    m_base = static_cast<char*>(m_buffer.map());
+    m_capacity = capacity;
+}
+
+void UploadRing::destroy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffer.destroy();
+    m_base = nullptr;
+    m_capacity = 0;
+    m_firstId += m_entries.size();
+    m_entries.clear();
+    m_head = 0;
+    m_used = 0;
+}
+
+void UploadRing::beginFrame(uint64_t frameNumber) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_frameNumber = frameNumber;
+    while (!m_entries.empty()) {
+        const Entry& e = m_entries.front();
+        if (e.releaseFrame == LIVE || e.releaseFrame + MAX_FRAMES_IN_FLIGHT > frameNumber) break;
+        m_used -= e.bytes;
+        m_entries.pop_front();
+        m_firstId++;
+    }
+    if (m_entries.empty()) m_head = 0; // start over at the front while it is free
+}
+
+bool UploadRing::allocate(VkDeviceSize size, Allocation& out) {
+    size = (size + 15) & ~VkDeviceSize(15);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Never split an allocation across the end; skip to the front instead
+    VkDeviceSize start = m_head, padding = 0;
+    if (start + size > m_capacity) {
+        padding = m_capacity - start;
+        start = 0;
+    }
+    if (m_used + padding + size > m_capacity) return false;
+
+    m_entries.push_back({padding + size, LIVE});
+    m_used += padding + size;
+    m_head = start + size;
+    out = {m_base + start, start, m_firstId + m_entries.size() - 1};
+    return true;
+}
+
+void UploadRing::release(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < m_firstId || id - m_firstId >= m_entries.size()) return;
+    Entry& e = m_entries[id - m_firstId];
+    if (e.releaseFrame == LIVE) e.releaseFrame = m_frameNumber;
+}
+
+bool UploadRing::isLive(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id < m_firstId || id - m_firstId >= m_entries.size()) return false;
+    return m_entries[id - m_firstId].releaseFrame == LIVE;
+}
+
+VkDeviceSize UploadRing::used() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_used;
+}
+
+} // namespace vk
+} // namespace myth
@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include "VulkanBuffer.h"
+#include "VulkanContext.h"
+#include "VulkanTypes.h"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace myth {
+namespace vk {
+
+// One persistently mapped CPU_TO_GPU buffer handed out front to back as a
+// ring. Any thread may allocate and write into the mapped memory; once the
+// data has been consumed (a copy recorded, or the data abandoned) release()
+// marks it reusable after the current frame's fence. Space is reclaimed in
+// allocation order, so a long-held allocation holds back everything behind it.
+class UploadRing {
+public:
+    struct Allocation {
+        void* data = nullptr;
+        VkDeviceSize offset = 0;
+        uint64_t id = 0; // never 0 for a successful allocation
+    };
+
+    void init(VulkanContext* ctx, VkDeviceSize capacity);
+    void destroy();
+
+    // Render thread, after waiting on the frame's fence. Reclaims space
+    // released MAX_FRAMES_IN_FLIGHT frames ago.
+    void beginFrame(uint64_t frameNumber);
+
+    // Thread-safe. False when the ring has no contiguous room for `size`.
+    bool allocate(VkDeviceSize size, Allocation& out);
+    // Thread-safe. Releasing twice, or after the space was reused, is a no-op.
+    void release(uint64_t id);
+    // Thread-safe. True until the allocation is released.
+    bool isLive(uint64_t id) const;
+
+    VkBuffer buffer() const { return m_buffer.buffer(); }
+    const char* base() const { return m_base; }
+    VkDeviceSize used() const;
+
+private:
+    static constexpr uint64_t LIVE = UINT64_MAX;
+
+    struct Entry {
+        VkDeviceSize bytes;   // including any padding skipped to wrap
+        uint64_t releaseFrame; // LIVE until released
+    };
+
+    VulkanBuffer m_buffer;
+    char* m_base = nullptr;
+    VkDeviceSize m_capacity = 0;
+
+    mutable std::mutex m_mutex;
+    std::deque<Entry> m_entries; // oldest first; entry i has id m_firstId + i
+    uint64_t m_firstId = 1;
+    VkDeviceSize m_head = 0;
+    VkDeviceSize m_used = 0;
+    uint64_t m_frameNumber = 0;
+};
+
+} // namespace vk
+} // namespace myth
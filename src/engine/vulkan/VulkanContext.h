@@ -1,6 +1,8 @@
 ﻿#pragma once
 
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#endif
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 #include <GLFW/glfw3.h>
@@ -26,8 +26,8 @@ void VulkanPipeline::init(VulkanContext* ctx, VulkanSwapchain* swapchain, Descri
 
     VkPipelineShaderStageCreateInfo stages[] = {vertStage, fragStage};
 
-    auto bindingDesc = Vertex::getBindingDescription();
-    auto attrDescs = Vertex::getAttributeDescriptions();
+    auto bindingDesc = vertexBindingDescription();
+    auto attrDescs = vertexAttributeDescriptions();
 
     VkPipelineVertexInputStateCreateInfo vertexInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
     vertexInput.vertexBindingDescriptionCount = 1;
@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
+#include "engine/Vertex.h"
 #include <array>
 #include <optional>
 
@@ -14,33 +15,28 @@ namespace vk {
 
 constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 color;
-    glm::vec2 texCoord;
-    glm::vec3 normal;
-    
-    static VkVertexInputBindingDescription getBindingDescription() {
-        VkVertexInputBindingDescription desc{};
-        desc.binding = 0;
-        desc.stride = sizeof(Vertex);
-        desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return desc;
-    }
-    
-    static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 4> attrs{};
-        attrs[0].binding = 0; attrs[0].location = 0;
-        attrs[0].format = VK_FORMAT_R32G32B32_SFLOAT; attrs[0].offset = offsetof(Vertex, position);
-        attrs[1].binding = 0; attrs[1].location = 1;
-        attrs[1].format = VK_FORMAT_R32G32B32_SFLOAT; attrs[1].offset = offsetof(Vertex, color);
-        attrs[2].binding = 0; attrs[2].location = 2;
-        attrs[2].format = VK_FORMAT_R32G32_SFLOAT; attrs[2].offset = offsetof(Vertex, texCoord);
-        attrs[3].binding = 0; attrs[3].location = 3;
-        attrs[3].format = VK_FORMAT_R32G32B32_SFLOAT; attrs[3].offset = offsetof(Vertex, normal);
-        return attrs;
-    }
-};
+using myth::Vertex;
+
+inline VkVertexInputBindingDescription vertexBindingDescription() {
+    VkVertexInputBindingDescription desc{};
+    desc.binding = 0;
+    desc.stride = sizeof(Vertex);
+    desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return desc;
+}
+
+inline std::array<VkVertexInputAttributeDescription, 4> vertexAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 4> attrs{};
+    attrs[0].binding = 0; attrs[0].location = 0;
+    attrs[0].format = VK_FORMAT_R32G32B32_SFLOAT; attrs[0].offset = offsetof(Vertex, position);
+    attrs[1].binding = 0; attrs[1].location = 1;
+    attrs[1].format = VK_FORMAT_R32G32B32_SFLOAT; attrs[1].offset = offsetof(Vertex, color);
+    attrs[2].binding = 0; attrs[2].location = 2;
+    attrs[2].format = VK_FORMAT_R32G32_SFLOAT; attrs[2].offset = offsetof(Vertex, texCoord);
+    attrs[3].binding = 0; attrs[3].location = 3;
+    attrs[3].format = VK_FORMAT_R32G32B32_SFLOAT; attrs[3].offset = offsetof(Vertex, normal);
+    return attrs;
+}
 
 struct CameraUBO {
     glm::mat4 view;
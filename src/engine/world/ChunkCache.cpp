@@ -0,0 +1,251 @@
+﻿#include "ChunkCache.h"
+#include "engine/Compression.h"
+#include "engine/Logger.h"
+#include "engine/Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace myth {
+
+namespace {
+
+constexpr char REGION_MAGIC[4] = {'M', 'B', 'R', 'G'};
+constexpr uint32_t REGION_FORMAT = 2;
+constexpr size_t RECORD_ALIGNMENT = 16;
+
+struct RegionHeader {
+    char magic[4];
+    uint32_t format;
+    uint32_t generation;
+    uint32_t vertexSize; // sizeof(Vertex); records hold compressed vertex arrays
+    float chunkSize;
+    uint32_t reserved[3];
+};
+static_assert(sizeof(RegionHeader) == 32);
+
+// Followed by the vertices and the indices, each a compression stream
+struct RecordHeader {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexStream; // bytes
+    uint32_t indexStream;
+};
+
+// Indices delta against the same corner of the previous quad, which is mostly +1
+constexpr uint32_t INDEX_STRIDE = 6 * sizeof(uint32_t);
+static_assert(sizeof(RecordHeader) == RECORD_ALIGNMENT);
+
+RegionHeader makeHeader(float chunkSize) {
+    RegionHeader header{};
+    std::memcpy(header.magic, REGION_MAGIC, sizeof(REGION_MAGIC));
+    header.format = REGION_FORMAT;
+    header.generation = TERRAIN_GENERATION;
+    header.vertexSize = sizeof(Vertex);
+    header.chunkSize = chunkSize;
+    return header;
+}
+
+} // namespace
+
+static_assert(ChunkCache::REGION_TILES == 32, "regionOf() and slotOf() shift and mask by 5 bits");
+
+ChunkCache::ChunkCache(std::filesystem::path directory, float chunkSize, JobSystem* jobs)
+    : m_directory(std::move(directory)), m_chunkSize(chunkSize), m_jobs(jobs) {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error) Logger::warnf("Chunk cache: cannot create {}: {}", m_directory.string(), error.message());
+}
+
+ChunkCache::~ChunkCache() {
+    waitForWrites();
+    flush();
+    waitForWrites();
+}
+
+std::filesystem::path ChunkCache::pathOf(ChunkCoord region) const {
+    return m_directory / ("r." + std::to_string(region.level) + "." + std::to_string(region.x) + "." +
+                          std::to_string(region.z) + ".bin");
+}
+
+ChunkCache::Region& ChunkCache::open(ChunkCoord region) {
+    auto& slot = m_regions[region];
+    if (slot) return *slot;
+    slot = std::make_unique<Region>();
+    Region& r = *slot;
+
+    if (!r.file.open(pathOf(region))) return r;
+    const RegionHeader expected = makeHeader(m_chunkSize);
+    const size_t tableEnd = sizeof(RegionHeader) + sizeof(Table);
+    if (r.file.size() < tableEnd || std::memcmp(r.file.data(), &expected, sizeof(RegionHeader)) != 0) {
+        r.file.close(); // stale: ignored, and replaced on the next write
+        return r;
+    }
+    std::memcpy(r.table.data(), r.file.data() + sizeof(RegionHeader), sizeof(Table));
+    for (Slot& s : r.table) {
+        // A torn write can leave the table pointing past the end; treat those as missing
+        if (s.offset < tableEnd || static_cast<size_t>(s.offset) + s.size > r.file.size()) s = {};
+    }
+    r.current = true;
+    return r;
+}
+
+bool ChunkCache::decode(const uint8_t* data, size_t size, Chunk& chunk, ChunkAllocator* allocator) {
+    if (size < sizeof(RecordHeader)) return false;
+    RecordHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.vertexCount > Chunk::MAX_VERTICES || header.indexCount > Chunk::MAX_INDICES) return false;
+    if (size != sizeof(RecordHeader) + uint64_t(header.vertexStream) + header.indexStream) return false;
+
+    // Straight into the chunk's memory; no staging copy
+    chunk.reserve(allocator);
+    const uint8_t* vertices = data + sizeof(RecordHeader);
+    const uint32_t* indices = chunk.geometry.indices;
+    if (!compression::decompress(vertices, header.vertexStream, chunk.geometry.vertices, header.vertexCount * sizeof(Vertex)) ||
+        !compression::decompress(vertices + header.vertexStream, header.indexStream, chunk.geometry.indices,
+                                 header.indexCount * sizeof(uint32_t)) ||
+        // A damaged record must not send the GPU reading past the tile's vertices
+        std::any_of(indices, indices + header.indexCount, [&](uint32_t i) { return i >= header.vertexCount; })) {
+        // Keep the memory: the caller generates the tile into it instead
+        chunk.geometry.vertexCount = chunk.geometry.indexCount = 0;
+        return false;
+    }
+    chunk.geometry.vertexCount = header.vertexCount;
+    chunk.geometry.indexCount = header.indexCount;
+    return true;
+}
+
+bool ChunkCache::find(ChunkCoord coord, const Region* region, Chunk& chunk, ChunkAllocator* allocator) const {
+    for (const auto* pending : {&m_queued, &m_inWrite}) {
+        auto it = pending->find(coord);
+        if (it != pending->end()) return decode(it->second.data(), it->second.size(), chunk, allocator);
+    }
+    if (!region || !region->current) return false;
+    const Slot& s = region->table[slotOf(coord)];
+    return s.offset != 0 && decode(region->file.data() + s.offset, s.size, chunk, allocator);
+}
+
+bool ChunkCache::read(ChunkCoord coord, Chunk& chunk, ChunkAllocator* allocator) {
+    chunk.coord = coord;
+    const ChunkCoord region = regionOf(coord);
+    {
+        std::shared_lock lock(m_mutex);
+        auto it = m_regions.find(region);
+        if (it != m_regions.end() || m_queued.count(coord) || m_inWrite.count(coord)) {
+            return find(coord, it != m_regions.end() ? it->second.get() : nullptr, chunk, allocator);
+        }
+    }
+    // First visit to this region: map it
+    std::unique_lock lock(m_mutex);
+    return find(coord, &open(region), chunk, allocator);
+}
+
+void ChunkCache::store(const Chunk& chunk) {
+    const ChunkGeometry& g = chunk.geometry;
+    const size_t vertexBytes = g.vertexCount * sizeof(Vertex), indexBytes = g.indexCount * sizeof(uint32_t);
+    // Compressed on the calling job, so generation workers share the work
+    Record record(sizeof(RecordHeader) + compression::compressBound(vertexBytes) + compression::compressBound(indexBytes));
+    uint8_t* out = record.data() + sizeof(RecordHeader);
+    // Vertices unfiltered: neighbouring vertices differ in every float, so
+    // deltas pack no smaller here and take twice as long to read back
+    const size_t vertexStream = compression::compress(g.vertices, vertexBytes, out);
+    const size_t indexStream = compression::compress(g.indices, indexBytes, out + vertexStream, compression::Filter::Delta, INDEX_STRIDE);
+    record.resize(sizeof(RecordHeader) + vertexStream + indexStream);
+    const RecordHeader header{g.vertexCount, g.indexCount, static_cast<uint32_t>(vertexStream), static_cast<uint32_t>(indexStream)};
+    std::memcpy(record.data(), &header, sizeof(header));
+
+    std::unique_lock lock(m_mutex);
+    const Region& region = open(regionOf(chunk.coord));
+    if (m_inWrite.count(chunk.coord) || (region.current && region.table[slotOf(chunk.coord)].offset != 0)) return;
+    m_queued.emplace(chunk.coord, std::move(record));
+}
+
+size_t ChunkCache::queuedCount() const {
+    std::shared_lock lock(m_mutex);
+    return m_queued.size();
+}
+
+void ChunkCache::flush(size_t minBatch) {
+    if (m_writing.load()) return;
+    {
+        std::unique_lock lock(m_mutex);
+        if (m_queued.empty() || m_queued.size() < minBatch) return;
+        m_inWrite.swap(m_queued); // m_inWrite is empty whenever no write is running
+    }
+    m_writing = true;
+    if (m_jobs) m_jobs->schedule([this]() { write(); });
+    else write();
+}
+
+void ChunkCache::waitForWrites() {
+    while (m_writing.load()) std::this_thread::yield();
+    // The writer clears m_writing before it lets go of the mutex
+    std::unique_lock lock(m_mutex);
+}
+
+void ChunkCache::write() {
+    MYTH_PROFILE_ZONE("ChunkCache::write");
+    // Nothing else changes m_inWrite until this clears it, so it is read without the lock
+    std::unordered_map<ChunkCoord, std::vector<const std::pair<const ChunkCoord, Record>*>, ChunkCoordHash> byRegion;
+    for (const auto& entry : m_inWrite) byRegion[regionOf(entry.first)].push_back(&entry);
+
+    for (const auto& [region, records] : byRegion) {
+        const std::filesystem::path path = pathOf(region);
+        Table table;
+        bool current;
+        {
+            std::shared_lock lock(m_mutex);
+            const Region& r = *m_regions.at(region); // store() opened it
+            table = r.table;
+            current = r.current;
+        }
+
+        std::fstream file;
+        if (current) {
+            file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+        } else {
+            table = {};
+            file.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+            const RegionHeader header = makeHeader(m_chunkSize);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(table.data()), sizeof(Table));
+        }
+
+        // Append the records, each aligned, then point the table at them
+        file.seekp(0, std::ios::end);
+        uint64_t end = static_cast<uint64_t>(file.tellp());
+        static constexpr char PADDING[RECORD_ALIGNMENT] = {};
+        for (const auto* entry : records) {
+            const size_t pad = (RECORD_ALIGNMENT - end % RECORD_ALIGNMENT) % RECORD_ALIGNMENT;
+            file.write(PADDING, static_cast<std::streamsize>(pad));
+            end += pad;
+            const Record& record = entry->second;
+            file.write(reinterpret_cast<const char*>(record.data()), static_cast<std::streamsize>(record.size()));
+            table[slotOf(entry->first)] = {static_cast<uint32_t>(end), static_cast<uint32_t>(record.size())};
+            end += record.size();
+        }
+        file.seekp(sizeof(RegionHeader));
+        file.write(reinterpret_cast<const char*>(table.data()), sizeof(Table));
+        file.close();
+        if (!file) {
+            Logger::warnf("Chunk cache: failed writing {}", path.string());
+            continue; // those tiles are regenerated next time
+        }
+
+        MappedFile mapped;
+        const bool ok = mapped.open(path);
+        std::unique_lock lock(m_mutex);
+        Region& r = *m_regions.at(region);
+        r.file = std::move(mapped);
+        r.table = table;
+        r.current = ok;
+    }
+
+    std::unique_lock lock(m_mutex);
+    m_inWrite.clear();
+    m_writing = false;
+}
+
+} // namespace myth
@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include "ChunkManager.h"
+#include "engine/MappedFile.h"
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+
+namespace myth {
+
+// Bump whenever Chunk::generate() output changes, so tiles cached by an
+// older build are regenerated rather than read back
+constexpr uint32_t TERRAIN_GENERATION = 1;
+
+// On-disk cache of generated tiles. Each region file packs a
+// REGION_TILES x REGION_TILES block of one level's tiles: a header, an
+// offset table with a slot per tile, then the records appended in the
+// order they were written. Files are memory-mapped for reading, so a tile
+// coming back into view is one copy out of the page cache instead of a
+// regeneration.
+//
+// store() only queues a copy in memory. flush() hands everything queued
+// to a single background writer on the JobSystem (inline without one),
+// which appends the records, rewrites the tables and then maps the
+// regions again; reads keep using the old mapping until then, and tiles
+// still waiting to be written are served from memory. A region whose
+// header does not match this build (format, TERRAIN_GENERATION, vertex
+// layout or chunk size) reads as empty and is started afresh on the next
+// write.
+class ChunkCache {
+public:
+    static constexpr int REGION_TILES = 32;
+
+    ChunkCache(std::filesystem::path directory, float chunkSize, JobSystem* jobs = nullptr);
+    // Writes whatever is still queued
+    ~ChunkCache();
+    ChunkCache(const ChunkCache&) = delete;
+    ChunkCache& operator=(const ChunkCache&) = delete;
+
+    // Any thread. Fill `chunk` from the cache, in memory from `allocator`
+    // when it has room. False when the tile is not cached.
+    bool read(ChunkCoord coord, Chunk& chunk, ChunkAllocator* allocator = nullptr);
+
+    // Any thread. Queue a generated tile for writing; no-op if it is cached.
+    void store(const Chunk& chunk);
+
+    // Start writing the queued tiles, unless fewer than `minBatch` are
+    // waiting or the previous batch is still being written
+    void flush(size_t minBatch = 1);
+    void waitForWrites();
+
+    size_t queuedCount() const;
+    bool writing() const { return m_writing.load(); }
+
+private:
+    struct Slot {
+        uint32_t offset = 0; // 0: empty
+        uint32_t size = 0;
+    };
+    using Table = std::array<Slot, REGION_TILES * REGION_TILES>;
+    using Record = std::vector<uint8_t>;
+
+    struct Region {
+        MappedFile file; // open only while `current`
+        Table table{};
+        bool current = false; // the file exists and was written by this build
+    };
+
+    static ChunkCoord regionOf(ChunkCoord tile) { return {tile.x >> 5, tile.z >> 5, tile.level}; }
+    static size_t slotOf(ChunkCoord tile) { return static_cast<size_t>((tile.z & 31) * REGION_TILES + (tile.x & 31)); }
+    std::filesystem::path pathOf(ChunkCoord region) const;
+
+    // Caller holds m_mutex exclusively
+    Region& open(ChunkCoord region);
+    // Caller holds m_mutex; false if the tile is not cached or `region` is not open yet
+    bool find(ChunkCoord coord, const Region* region, Chunk& chunk, ChunkAllocator* allocator) const;
+    static bool decode(const uint8_t* data, size_t size, Chunk& chunk, ChunkAllocator* allocator);
+    // Background writer: everything in m_inWrite
+    void write();
+
+    std::filesystem::path m_directory;
+    float m_chunkSize;
+    JobSystem* m_jobs;
+    mutable std::shared_mutex m_mutex; // guards everything below but m_writing
+    std::unordered_map<ChunkCoord, std::unique_ptr<Region>, ChunkCoordHash> m_regions;
+    std::unordered_map<ChunkCoord, Record, ChunkCoordHash> m_queued;   // stored, not yet handed to the writer
+    std::unordered_map<ChunkCoord, Record, ChunkCoordHash> m_inWrite;  // with the writer
+    std::atomic<bool> m_writing{false};
+};
+
+} // namespace myth
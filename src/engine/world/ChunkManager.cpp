@@ -0,0 +1,378 @@
+﻿#include "ChunkManager.h"
+#include "ChunkCache.h"
+#include "engine/Profiler.h"
+#include "engine/math/Noise.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace myth {
+
+// Four octaves from four-chunk features down, scaled by the relief
+static constexpr noise::Fractal TERRAIN_FRACTAL = {.basis = noise::Basis::Gradient, .octaves = 4, .frequency = 0.25f, .seed = 10};
+
+float terrainHeight(float x, float z) {
+    return noise::sample2(TERRAIN_FRACTAL, x, z) * TERRAIN_RELIEF;
+}
+
+void Chunk::reserve(ChunkAllocator* allocator) {
+    if (geometry.vertices) return;
+    if (!allocator || !allocator->allocate(MAX_VERTICES, MAX_INDICES, geometry)) {
+        ownVertices.resize(MAX_VERTICES);
+        ownIndices.resize(MAX_INDICES);
+        geometry = {ownVertices.data(), ownIndices.data(), 0, 0, 0};
+    }
+}
+
+void Chunk::generate(float chunkSize, ChunkAllocator* allocator) {
+    reserve(allocator);
+
+    constexpr uint32_t N = TILE_CELLS;
+    constexpr float UV_PER_CHUNK = 2.0f;
+    // Two reliefs is the most two surfaces can differ by, so this always reaches below a neighbour's edge
+    constexpr float SKIRT_DEPTH = 2.0f * TERRAIN_RELIEF;
+    const float span = static_cast<float>(1 << coord.level); // chunks per side
+    const float cell = span / N;
+    const float x0 = coord.x * span, z0 = coord.z * span;
+
+    // Heights with a one-cell border, for central-difference normals
+    float heights[N + 3][N + 3];
+    noise::fillGrid2(TERRAIN_FRACTAL, x0 - cell, z0 - cell, cell, N + 3, N + 3, &heights[0][0]);
+    for (auto& row : heights) {
+        for (float& h : row) h *= TERRAIN_RELIEF;
+    }
+
+    const glm::vec3 color(1.0f);
+    Vertex* vertex = geometry.vertices;
+    for (uint32_t j = 0; j <= N; j++) {
+        for (uint32_t i = 0; i <= N; i++) {
+            const float x = x0 + i * cell, z = z0 + j * cell;
+            const glm::vec3 normal = glm::normalize(glm::vec3(heights[j + 1][i] - heights[j + 1][i + 2], 2.0f * cell * chunkSize,
+                                                              heights[j][i + 1] - heights[j + 2][i + 1]));
+            *vertex++ = {{x * chunkSize, heights[j + 1][i + 1], z * chunkSize}, color, {x * UV_PER_CHUNK, z * UV_PER_CHUNK}, normal};
+        }
+    }
+
+    uint32_t* index = geometry.indices;
+    for (uint32_t j = 0; j < N; j++) {
+        for (uint32_t i = 0; i < N; i++) {
+            const uint32_t a = j * (N + 1) + i, b = a + 1, d = a + N + 1, c = d + 1;
+            *index++ = a; *index++ = c; *index++ = b;
+            *index++ = a; *index++ = d; *index++ = c;
+        }
+    }
+
+    // Skirt: the border walked counter-clockwise from above, repeated lower down
+    const uint32_t gridVertices = (N + 1) * (N + 1);
+    uint32_t border[4 * N];
+    for (uint32_t k = 0; k < N; k++) {
+        border[k] = k;                              // -z edge
+        border[N + k] = k * (N + 1) + N;            // +x edge
+        border[2 * N + k] = N * (N + 1) + (N - k);  // +z edge
+        border[3 * N + k] = (N - k) * (N + 1);      // -x edge
+    }
+    for (uint32_t k = 0; k < 4 * N; k++) {
+        Vertex skirt = geometry.vertices[border[k]];
+        skirt.position.y -= SKIRT_DEPTH;
+        *vertex++ = skirt;
+
+        const uint32_t p = border[k], q = border[(k + 1) % (4 * N)];
+        const uint32_t ps = gridVertices + k, qs = gridVertices + (k + 1) % (4 * N);
+        *index++ = p; *index++ = q; *index++ = qs;
+        *index++ = p; *index++ = qs; *index++ = ps;
+    }
+
+    geometry.vertexCount = static_cast<uint32_t>(vertex - geometry.vertices);
+    geometry.indexCount = static_cast<uint32_t>(index - geometry.indices);
+}
+
+ChunkManager::ChunkManager(JobSystem* jobs) : m_jobs(jobs) {}
+
+ChunkManager::~ChunkManager() {
+    // Generation jobs reference this manager and the cache until they finish
+    waitForJobs();
+}
+
+void ChunkManager::waitForJobs() {
+    while (m_inFlight.load() > 0) std::this_thread::yield();
+}
+
+int ChunkManager::topLevel() const {
+    int level = 0;
+    while ((1 << level) < loadRadius && level < 20) level++;
+    return level;
+}
+
+void ChunkManager::update(const glm::vec3& playerPos) {
+    ChunkCoord center{static_cast<int>(std::floor(playerPos.x / chunkSize)),
+                      static_cast<int>(std::floor(playerPos.z / chunkSize))};
+    const bool rebuild = m_radius < 0 || loadRadius != m_radius || lodRatio != m_ratio;
+    if (rebuild || !(center == m_center)) {
+        m_center = center;
+        m_radius = loadRadius;
+        m_ratio = lodRatio;
+        select(center, rebuild);
+    }
+    if (!m_cache && !cacheDirectory.empty()) m_cache = std::make_unique<ChunkCache>(cacheDirectory, chunkSize, m_jobs);
+
+    dispatch();
+    integrate();
+    retire();
+    if (m_cache) m_cache->flush(m_requested.empty() ? 1 : cacheBatch);
+}
+
+std::vector<ChunkManager::Level> ChunkManager::levels(ChunkCoord center) const {
+    const int top = topLevel();
+    const Area view = Area::around(center, loadRadius);
+    std::vector<Level> result(top + 1);
+    Area reached = {view.x0 >> top, view.z0 >> top, view.x1 >> top, view.z1 >> top};
+    for (int level = top; level >= 0; level--) {
+        Level& l = result[level];
+        l.reached = reached;
+        if (level == 0 || reached.empty()) break;
+
+        // Distance to a tile only grows away from the player, so the tiles
+        // close enough to split form one run per axis
+        const int span = 1 << level;
+        const float reach = lodRatio * static_cast<float>(span);
+        auto near = [&](int t, int c) { return static_cast<float>(std::max({t * span - c, c - ((t + 1) * span - 1), 0})) < reach; };
+        l.split = reached;
+        while (l.split.x0 <= l.split.x1 && !near(l.split.x0, center.x)) l.split.x0++;
+        while (l.split.x1 >= l.split.x0 && !near(l.split.x1, center.x)) l.split.x1--;
+        while (l.split.z0 <= l.split.z1 && !near(l.split.z0, center.z)) l.split.z0++;
+        while (l.split.z1 >= l.split.z0 && !near(l.split.z1, center.z)) l.split.z1--;
+        if (l.split.empty()) break;
+
+        const int child = level - 1;
+        reached = {std::max(l.split.x0 * 2, view.x0 >> child), std::max(l.split.z0 * 2, view.z0 >> child),
+                   std::min(l.split.x1 * 2 + 1, view.x1 >> child), std::min(l.split.z1 * 2 + 1, view.z1 >> child)};
+    }
+    return result;
+}
+
+void ChunkManager::select(ChunkCoord center, bool rebuild) {
+    std::vector<Level> next = levels(center);
+    m_entering.clear();
+    m_leaving.clear();
+
+    if (rebuild) {
+        for (ChunkCoord t : m_selected) {
+            if (t.level >= static_cast<int>(next.size()) || !next[t.level].selects(t.x, t.z)) m_leaving.push_back(t);
+        }
+        for (int level = 0; level < static_cast<int>(next.size()); level++) {
+            const Level& l = next[level];
+            for (int z = l.reached.z0; z <= l.reached.z1; z++) {
+                for (int x = l.reached.x0; x <= l.reached.x1; x++) {
+                    if (l.selects(x, z) && !m_selected.count({x, z, level})) m_entering.push_back({x, z, level});
+                }
+            }
+        }
+    } else {
+        // Same settings, so the same levels: on each row of each level, the
+        // edges of the old and new rectangles cut it into runs that are
+        // either selected before and after or changed as a whole
+        for (int level = 0; level < static_cast<int>(next.size()); level++) {
+            const Level& was = m_levels[level];
+            const Level& is = next[level];
+            const Area* areas[4] = {&was.reached, &was.split, &is.reached, &is.split};
+            const int z0 = std::min(was.reached.empty() ? INT32_MAX : was.reached.z0, is.reached.empty() ? INT32_MAX : is.reached.z0);
+            const int z1 = std::max(was.reached.empty() ? INT32_MIN : was.reached.z1, is.reached.empty() ? INT32_MIN : is.reached.z1);
+            for (int z = z0; z <= z1; z++) {
+                int edges[8];
+                int edgeCount = 0;
+                for (const Area* a : areas) {
+                    if (a->empty() || z < a->z0 || z > a->z1) continue;
+                    edges[edgeCount++] = a->x0;
+                    edges[edgeCount++] = a->x1 + 1;
+                }
+                for (int i = 1; i < edgeCount; i++) {
+                    for (int j = i; j > 0 && edges[j - 1] > edges[j]; j--) std::swap(edges[j - 1], edges[j]);
+                }
+                for (int i = 0; i + 1 < edgeCount; i++) {
+                    const bool before = was.selects(edges[i], z), after = is.selects(edges[i], z);
+                    if (before == after) continue;
+                    auto& changed = after ? m_entering : m_leaving;
+                    for (int x = edges[i]; x < edges[i + 1]; x++) changed.push_back({x, z, level});
+                }
+            }
+        }
+    }
+    m_levels = std::move(next);
+
+    for (ChunkCoord t : m_leaving) {
+        m_selected.erase(t);
+        m_missing.erase(t);
+        if (m_chunks.count(t)) m_retiring.insert(t);
+    }
+    for (ChunkCoord t : m_entering) {
+        m_selected.insert(t);
+        if (m_chunks.count(t)) {
+            m_retiring.erase(t); // selected again before it went
+            continue;
+        }
+        m_missing.insert(t);
+        if (m_requested.insert(t).second) m_queued.push_back(t);
+    }
+
+    // Nearest tile centres first; coarse tiles are big, so measure to the centre rather than the edge
+    std::sort(m_queued.begin(), m_queued.end(), [&](ChunkCoord a, ChunkCoord b) {
+        auto distanceSq = [&](ChunkCoord t) {
+            const float span = static_cast<float>(1 << t.level);
+            const float dx = (t.x + 0.5f) * span - (center.x + 0.5f), dz = (t.z + 0.5f) * span - (center.z + 0.5f);
+            return dx * dx + dz * dz;
+        };
+        return distanceSq(a) > distanceSq(b);
+    });
+}
+
+bool ChunkManager::TileIndex::insert(ChunkCoord tile) {
+    if (!m_tiles.insert(tile).second) return false;
+    if (tile.level <= m_top) {
+        count(tile, 1);
+        return true;
+    }
+    // Count every tile again up to the new top
+    m_top = tile.level;
+    m_below.clear();
+    for (ChunkCoord t : m_tiles) count(t, 1);
+    return true;
+}
+
+bool ChunkManager::TileIndex::erase(ChunkCoord tile) {
+    if (!m_tiles.erase(tile)) return false;
+    count(tile, -1);
+    return true;
+}
+
+bool ChunkManager::TileIndex::overlaps(ChunkCoord tile) const {
+    for (ChunkCoord a = tile;; a = {a.x >> 1, a.z >> 1, a.level + 1}) {
+        if (m_tiles.count(a)) return true;
+        if (a.level >= m_top) break;
+    }
+    auto it = m_below.find(tile);
+    return it != m_below.end();
+}
+
+void ChunkManager::TileIndex::count(ChunkCoord tile, int delta) {
+    for (ChunkCoord a = tile; a.level < m_top;) {
+        a = {a.x >> 1, a.z >> 1, a.level + 1};
+        if (delta > 0) {
+            m_below[a]++;
+        } else {
+            auto it = m_below.find(a);
+            if (--it->second == 0) m_below.erase(it);
+        }
+    }
+}
+
+void ChunkManager::dispatch() {
+    while (!m_queued.empty() && m_inFlight.load() < maxInFlight) {
+        ChunkCoord coord = m_queued.back();
+        m_queued.pop_back();
+        if (!m_selected.count(coord)) {
+            m_requested.erase(coord); // the player moved on before it started
+            continue;
+        }
+
+        m_inFlight++;
+        auto generate = [this, coord, size = chunkSize, alloc = allocator, cache = m_cache.get()]() {
+            MYTH_PROFILE_ZONE("Load chunk");
+            Chunk chunk;
+            chunk.coord = coord;
+            if (!cache || !cache->read(coord, chunk, alloc)) {
+                chunk.generate(size, alloc);
+                // Copy it now: allocator memory may be consumed once integrated
+                if (cache) cache->store(chunk);
+            }
+            m_completed.push(std::move(chunk));
+            m_inFlight--;
+        };
+        if (m_jobs) m_jobs->schedule(generate);
+        else generate();
+    }
+}
+
+void ChunkManager::integrate() {
+    m_completed.consumeAll([this](Chunk&& chunk) { m_ready.push_back(std::move(chunk)); });
+
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                             std::chrono::duration<float, std::milli>(integrateBudgetMs));
+    bool first = true;
+    while (!m_ready.empty() && (first || Clock::now() < deadline)) {
+        first = false; // always make progress, however small the budget
+        Chunk chunk = std::move(m_ready.front());
+        m_ready.pop_front();
+        const ChunkCoord coord = chunk.coord;
+        m_requested.erase(coord);
+        if (!m_selected.count(coord)) {
+            drop(chunk);
+            continue;
+        }
+        m_chunks.emplace(coord, std::move(chunk));
+        m_missing.erase(coord);
+        if (m_retiring.overlaps(coord)) m_hidden.insert(coord);
+        else if (trackChanges) m_loadedChanges.push_back(coord);
+    }
+}
+
+void ChunkManager::retire() {
+    if (m_retiring.empty() && m_hidden.empty()) return;
+
+    // A retiring tile goes once no selected tile over or under it is missing
+    std::vector<ChunkCoord> covered;
+    for (ChunkCoord r : m_retiring.tiles()) {
+        if (!m_missing.overlaps(r)) covered.push_back(r);
+    }
+    for (ChunkCoord r : covered) {
+        m_retiring.erase(r);
+        auto it = m_chunks.find(r);
+        drop(it->second);
+        m_chunks.erase(it);
+        if (!m_hidden.erase(r) && trackChanges) m_unloadedChanges.push_back(r);
+    }
+
+    for (auto it = m_hidden.begin(); it != m_hidden.end();) {
+        if (m_retiring.overlaps(*it)) {
+            ++it;
+            continue;
+        }
+        if (trackChanges) m_loadedChanges.push_back(*it);
+        it = m_hidden.erase(it);
+    }
+}
+
+void ChunkManager::drop(Chunk& chunk) {
+    if (allocator && chunk.geometry.handle) allocator->release(chunk.geometry);
+    chunk.geometry = {};
+}
+
+void ChunkManager::releaseGeometry(ChunkCoord coord) {
+    auto it = m_chunks.find(coord);
+    if (it == m_chunks.end() || !it->second.geometry.handle) return;
+    drop(it->second);
+}
+
+size_t ChunkManager::tileBudget() const {
+    const int span = 1 << topLevel();
+    const int step = std::max(1, span / 8);
+    size_t most = 0;
+    for (int z = 0; z < span; z += step) {
+        for (int x = 0; x < span; x += step) {
+            size_t count = 0;
+            forEachSelected(ChunkCoord{x, z}, [&](ChunkCoord) { count++; });
+            most = std::max(most, count);
+        }
+    }
+    return 2 * most;
+}
+
+void ChunkManager::takeChanges(std::vector<ChunkCoord>& loaded, std::vector<ChunkCoord>& unloaded) {
+    loaded.swap(m_loadedChanges);
+    unloaded.swap(m_unloadedChanges);
+    m_loadedChanges.clear();
+    m_unloadedChanges.clear();
+}
+
+} // namespace myth
@@ -0,0 +1,269 @@
+﻿#pragma once
+
+#include "core/JobSystem.h"
+#include "core/MpscQueue.h"
+#include "engine/Vertex.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace myth {
+
+// A terrain tile: at `level` L it spans 2^L chunks on a side, and x and z
+// count in units of that span, so level 0 tiles are single chunks
+struct ChunkCoord {
+    int x, z;
+    int level = 0;
+    bool operator==(const ChunkCoord& o) const { return x == o.x && z == o.z && level == o.level; }
+};
+
+struct ChunkCoordHash {
+    size_t operator()(const ChunkCoord& c) const {
+        return std::hash<int>()(c.x) ^ (std::hash<int>()(c.z) << 16) ^ (std::hash<int>()(c.level) << 28);
+    }
+};
+
+// Deterministic value noise in [-1, 1] for an integer lattice point
+inline float chunkRandom(int x, int z, int seed = 0) {
+    int n = x + z * 57 + seed * 131;
+    n = (n << 13) ^ n;
+    return 1.0f - ((n * (n * n * 15731 + 789221) + 1376312589) & 0x7fffffff) / 1073741824.0f;
+}
+
+// Ground height never strays further than this from zero
+constexpr float TERRAIN_RELIEF = 0.3f;
+
+// Ground height at a point given in chunk units: gradient fBm from
+// noise::sample2, bit-identical to what tiles of any level generate there
+float terrainHeight(float x, float z);
+
+// Where a chunk's vertices and indices live once generated
+struct ChunkGeometry {
+    Vertex* vertices = nullptr;
+    uint32_t* indices = nullptr;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint64_t handle = 0; // allocator's id for the memory; 0 when the chunk owns it
+};
+
+// Supplies memory for chunk geometry so generation jobs write it straight
+// to where it is consumed, e.g. a renderer's mapped upload memory.
+// allocate() runs on generation jobs and must be thread-safe; returning
+// false makes the chunk fall back to memory of its own. release() runs on
+// the ChunkManager's thread when a chunk holding such memory is dropped.
+class ChunkAllocator {
+public:
+    virtual ~ChunkAllocator() = default;
+    virtual bool allocate(uint32_t maxVertices, uint32_t maxIndices, ChunkGeometry& out) = 0;
+    virtual void release(const ChunkGeometry& geometry) = 0;
+};
+
+// One terrain tile, generated on the CPU: a TILE_CELLS grid whatever its
+// level, plus a skirt hanging from its border to cover cracks against
+// neighbours of another level. Move-only: `geometry` may point into the
+// tile's own vectors.
+struct Chunk {
+    static constexpr uint32_t TILE_CELLS = 16;
+    // Upper bounds on generate()'s output, for sizing fixed GPU slots
+    static constexpr uint32_t MAX_VERTICES = (TILE_CELLS + 1) * (TILE_CELLS + 1) + 4 * TILE_CELLS;
+    static constexpr uint32_t MAX_INDICES = (TILE_CELLS * TILE_CELLS + 4 * TILE_CELLS) * 6;
+
+    ChunkCoord coord;
+    ChunkGeometry geometry;
+    std::vector<Vertex> ownVertices; // backing for `geometry` without allocator memory
+    std::vector<uint32_t> ownIndices;
+
+    Chunk() = default;
+    Chunk(Chunk&&) = default;
+    Chunk& operator=(Chunk&&) = default;
+    Chunk(const Chunk&) = delete;
+    Chunk& operator=(const Chunk&) = delete;
+
+    // Point `geometry` at room for MAX_VERTICES and MAX_INDICES, from
+    // `allocator` when it has some, else the tile's own vectors. No-op if
+    // it already has room, e.g. from a cache read that failed.
+    void reserve(ChunkAllocator* allocator);
+
+    // Fill `geometry`, in memory from `allocator` when it has room
+    void generate(float chunkSize, ChunkAllocator* allocator = nullptr);
+};
+
+class ChunkCache;
+
+// Covers the square within `loadRadius` chunks of the player with a
+// quadtree of tiles: full-resolution chunks close by, tiles twice as
+// coarse each time the distance doubles. A tile splits while the player is
+// within `lodRatio` tile spans of it, so on each level the split tiles form
+// a rectangle around the player. Nothing happens until the player's chunk
+// changes; then only the tiles between the old and new rectangles split or
+// merge, and the tiles entering and leaving the selection are queued or
+// retired. A setting change selects the whole tree again. A retiring tile
+// stays until every tile replacing it is resident, and those stay hidden
+// until it goes, so the ground never shows a hole or two levels at once.
+//
+// Loads are generated on the JobSystem, nearest first, with at most
+// `maxInFlight` outstanding; finished tiles come back through a lock-free
+// queue and update() integrates them for at most `integrateBudgetMs`.
+// Without a JobSystem, tiles are generated inline, `maxInFlight` per
+// update. Pure CPU data; with `trackChanges` set, takeChanges() reports
+// which tiles appeared and went so a renderer can mirror them, and an
+// `allocator` lets jobs generate straight into the renderer's upload memory.
+// With a `cacheDirectory`, generated tiles are kept in region files there
+// (see ChunkCache) and read back instead of generated when they return;
+// writes go out in batches of `cacheBatch` while streaming, and whatever
+// is left once loading settles.
+class ChunkManager {
+public:
+    explicit ChunkManager(JobSystem* jobs = nullptr);
+    ~ChunkManager();
+
+    float chunkSize = 10.0f;
+    int loadRadius = 48;
+    float lodRatio = 2.0f;
+    int maxInFlight = 8;
+    float integrateBudgetMs = 1.0f;
+    bool trackChanges = false;
+    ChunkAllocator* allocator = nullptr; // set before the first update; must outlive generation jobs
+    std::string cacheDirectory;          // set before the first update; empty for no disk cache
+    size_t cacheBatch = 32;
+
+    void update(const glm::vec3& playerPos);
+
+    // Block until generation jobs in flight have finished
+    void waitForJobs();
+
+    bool isDirty() const { return !m_loadedChanges.empty() || !m_unloadedChanges.empty(); }
+
+    // Tiles shown and removed since the last call. A coordinate can be in
+    // both lists if it left and came back; apply `unloaded` first, and look
+    // loaded ones up with find() as they may have gone again since.
+    void takeChanges(std::vector<ChunkCoord>& loaded, std::vector<ChunkCoord>& unloaded);
+
+    const Chunk* find(ChunkCoord coord) const {
+        auto it = m_chunks.find(coord);
+        return it != m_chunks.end() ? &it->second : nullptr;
+    }
+
+    // The tile's geometry has been consumed, e.g. its upload recorded: hand
+    // allocator memory back and clear the tile's geometry so nothing reads
+    // the memory once it is reused. Geometry the tile owns is kept.
+    void releaseGeometry(ChunkCoord coord);
+
+    // Estimate of the most tiles resident at once, for sizing GPU storage:
+    // the largest selection over a span of player positions, twice over for
+    // retiring tiles and their replacements
+    size_t tileBudget() const;
+
+    size_t chunkCount() const { return m_chunks.size(); }
+    // Tiles selected but not yet integrated, queued or generating
+    size_t pendingCount() const { return m_requested.size(); }
+    // Null until the first update with a cacheDirectory
+    ChunkCache* cache() const { return m_cache.get(); }
+
+private:
+    // Inclusive rectangle of chunk coordinates, or of tile coordinates on one level
+    struct Area {
+        int x0 = 0, z0 = 0, x1 = -1, z1 = -1;
+
+        static Area around(ChunkCoord c, int radius) { return {c.x - radius, c.z - radius, c.x + radius, c.z + radius}; }
+        static Area of(ChunkCoord t) {
+            return {t.x << t.level, t.z << t.level, ((t.x + 1) << t.level) - 1, ((t.z + 1) << t.level) - 1};
+        }
+        bool empty() const { return x0 > x1 || z0 > z1; }
+        bool contains(int x, int z) const { return x0 <= x && x <= x1 && z0 <= z && z <= z1; }
+        bool intersects(const Area& o) const { return x0 <= o.x1 && o.x0 <= x1 && z0 <= o.z1 && o.z0 <= z1; }
+    };
+
+    // The refined tree on one level, in that level's tile coordinates: the
+    // tiles the tree reaches (children of split tiles one level up, within
+    // view) and those of them split further. The rest are selected.
+    struct Level {
+        Area reached;
+        Area split;
+        bool selects(int x, int z) const { return reached.contains(x, z) && !split.contains(x, z); }
+    };
+
+    // A set of tiles that also counts, for every tile above them, how many
+    // lie underneath, so overlap with the set costs a walk up the tree
+    // rather than a scan of it
+    class TileIndex {
+    public:
+        bool insert(ChunkCoord tile);
+        bool erase(ChunkCoord tile);
+        // Whether `tile` is in the set, below a tile in it or above one
+        bool overlaps(ChunkCoord tile) const;
+        bool empty() const { return m_tiles.empty(); }
+        const std::unordered_set<ChunkCoord, ChunkCoordHash>& tiles() const { return m_tiles; }
+
+    private:
+        void count(ChunkCoord tile, int delta);
+
+        std::unordered_set<ChunkCoord, ChunkCoordHash> m_tiles;
+        std::unordered_map<ChunkCoord, uint32_t, ChunkCoordHash> m_below;
+        int m_top = 0; // highest level inserted; ancestors are counted up to it
+    };
+
+    int topLevel() const;
+    // func(tile) for every tile of the refined tree around chunk `center`
+    template<typename Func>
+    void forEachSelected(ChunkCoord center, Func&& func) const;
+    std::vector<Level> levels(ChunkCoord center) const;
+    void select(ChunkCoord center, bool rebuild);
+
+    void dispatch();
+    void integrate();
+    void retire();
+    void drop(Chunk& chunk);
+
+    JobSystem* m_jobs;
+    std::unique_ptr<ChunkCache> m_cache;
+    std::unordered_map<ChunkCoord, Chunk, ChunkCoordHash> m_chunks;
+    std::unordered_set<ChunkCoord, ChunkCoordHash> m_selected;
+    std::vector<Level> m_levels;         // the tree m_selected was taken from, by level
+    TileIndex m_missing;                 // selected but not resident
+    TileIndex m_retiring;                // resident but no longer selected
+    std::unordered_set<ChunkCoord, ChunkCoordHash> m_hidden; // resident, waiting on a retiring tile
+    std::vector<ChunkCoord> m_entering;  // scratch for select()
+    std::vector<ChunkCoord> m_leaving;
+    std::vector<ChunkCoord> m_queued;    // loads not yet dispatched, farthest first
+    std::unordered_set<ChunkCoord, ChunkCoordHash> m_requested; // queued, generating or awaiting integration
+    MpscQueue<Chunk> m_completed;        // pushed by generation jobs
+    std::deque<Chunk> m_ready;           // completed, waiting for integration budget
+    std::atomic<int> m_inFlight{0};
+    ChunkCoord m_center = {0, 0};
+    int m_radius = -1; // radius the selection was built for; -1 before the first update
+    float m_ratio = 0.0f;
+    std::vector<ChunkCoord> m_loadedChanges;
+    std::vector<ChunkCoord> m_unloadedChanges;
+};
+
+template<typename Func>
+void ChunkManager::forEachSelected(ChunkCoord center, Func&& func) const {
+    const Area view = Area::around(center, loadRadius);
+    auto refine = [&](auto& self, ChunkCoord tile) -> void {
+        const Area a = Area::of(tile);
+        if (!a.intersects(view)) return;
+        const int dx = std::max({a.x0 - center.x, center.x - a.x1, 0});
+        const int dz = std::max({a.z0 - center.z, center.z - a.z1, 0});
+        if (tile.level == 0 || std::max(dx, dz) >= lodRatio * static_cast<float>(1 << tile.level)) {
+            func(tile);
+            return;
+        }
+        for (int i = 0; i < 4; i++) self(self, ChunkCoord{tile.x * 2 + (i & 1), tile.z * 2 + (i >> 1), tile.level - 1});
+    };
+
+    const int top = topLevel();
+    for (int z = view.z0 >> top; z <= view.z1 >> top; z++) {
+        for (int x = view.x0 >> top; x <= view.x1 >> top; x++) refine(refine, ChunkCoord{x, z, top});
+    }
+}
+
+} // namespace myth
@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include "engine/ecs/Systems.h"
+#include <cstdint>
+#include <mutex>
+
+namespace myth {
+
+// Source of player intent for the simulation, one command per fixed step.
+// The windowed client feeds it from the keyboard; headless runs script it.
+class PlayerCommandStream {
+public:
+    virtual ~PlayerCommandStream() = default;
+    virtual ecs::PlayerCommand next(uint64_t tick) = 0;
+};
+
+// Holds the most recent command submitted by another thread. Movement keeps
+// applying until replaced; a jump is latched until one step consumes it, so a
+// tap between two steps is not lost.
+class LatchedCommandStream : public PlayerCommandStream {
+public:
+    void submit(const ecs::PlayerCommand& command) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bool jump = m_command.jump || command.jump;
+        m_command = command;
+        m_command.jump = jump;
+    }
+
+    ecs::PlayerCommand next(uint64_t) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ecs::PlayerCommand command = m_command;
+        m_command.jump = false;
+        return command;
+    }
+
+private:
+    std::mutex m_mutex;
+    ecs::PlayerCommand m_command;
+};
+
+// Deterministic wandering for soak tests and profiling: a new heading every
+// `holdTicks` steps, with occasional sprints and jumps. The same seed always
+// produces the same command for the same tick.
+class ScriptedCommandStream : public PlayerCommandStream {
+public:
+    explicit ScriptedCommandStream(uint32_t seed = 1, uint32_t holdTicks = 120)
+        : m_seed(seed), m_holdTicks(holdTicks ? holdTicks : 1) {}
+
+    ecs::PlayerCommand next(uint64_t tick) override {
+        uint64_t segment = tick / m_holdTicks;
+        uint32_t h = hash(static_cast<uint32_t>(segment) ^ hash(m_seed));
+        ecs::PlayerCommand command;
+        command.forward = static_cast<float>(h & 0xff) / 127.5f - 1.0f;
+        command.right = static_cast<float>((h >> 8) & 0xff) / 127.5f - 1.0f;
+        command.sprint = ((h >> 16) & 0x3) == 0;
+        command.jump = tick % m_holdTicks == 0 && ((h >> 18) & 0x3) == 0;
+        return command;
+    }
+
+private:
+    static uint32_t hash(uint32_t x) {
+        x ^= x >> 16; x *= 0x7feb352dU;
+        x ^= x >> 15; x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    uint32_t m_seed;
+    uint32_t m_holdTicks;
+};
+
+} // namespace myth
@@ -0,0 +1,184 @@
+﻿#include "GameWorld.h"
+#include "engine/Logger.h"
+#include "engine/Profiler.h"
+#include "engine/ecs/Serialization.h"
+#include "engine/ecs/Systems.h"
+
+namespace myth {
+
+using namespace myth::ecs;
+
+void GameWorld::populate() {
+    Entity player = world.createPlayer(glm::vec3(0, 0, 0));
+    world.createCamera(player);
+    for (int x = -50; x <= 50; x += 25) {
+        for (int z = -50; z <= 50; z += 25) {
+            if (x == 0 && z == 0) continue;
+            float h = 1.0f + chunkRandom(x, z, 99) * 1.5f;
+            world.createLandmark(glm::vec3(static_cast<float>(x), h / 2, static_cast<float>(z)),
+                                 glm::vec3(1.5f, h, 1.5f), chunkRandom(x, z, 100) * 360.0f);
+        }
+    }
+    chunks.update(playerPosition());
+    syncSystems();
+}
+
+void GameWorld::syncSystems() {
+    m_matrices.update(world, m_jobs);
+    collision.update(world, m_jobs);
+    spatial.update(world);
+}
+
+void GameWorld::step(float dt, PlayerCommandStream& commands) {
+    MYTH_PROFILE_ZONE("GameWorld::step");
+    PlayerCommand command = commands.next(m_tick);
+    m_playTime += dt;
+    updatePlayerInput(world, command, world.cameraControllers.view().tryGet(world.cameraEntity));
+    updateMovement(world, dt);
+    m_motion.update(world, dt, m_jobs);
+    collision.resolveCharacters(world);
+    if (world.playerEntity != NULL_ENTITY) {
+        glm::vec3 pos = playerPosition();
+        {
+            MYTH_PROFILE_ZONE("Region update");
+            regions.update(pos, dt);
+        }
+        MYTH_PROFILE_ZONE("Chunk streaming");
+        chunks.update(pos);
+    }
+    {
+        MYTH_PROFILE_ZONE("Matrices and collision");
+        m_matrices.update(world, m_jobs);
+        collision.update(world, m_jobs);
+    }
+    MYTH_PROFILE_ZONE("Spatial index");
+    spatial.update(world);
+    m_tick++;
+}
+
+glm::vec3 GameWorld::playerPosition() const {
+    const auto* t = world.transforms.view().tryGet(world.playerEntity);
+    return t ? t->position : glm::vec3(0.0f);
+}
+
+SaveData GameWorld::saveMeta() const {
+    SaveData data;
+    data.playTime = m_playTime;
+    if (world.playerEntity != NULL_ENTITY) {
+        const auto& t = world.transforms.view().get(world.playerEntity);
+        data.playerPosition = t.position;
+        data.playerYaw = t.rotation.y;
+    }
+    if (world.cameraEntity != NULL_ENTITY) {
+        if (const auto* cam = world.cameraControllers.view().tryGet(world.cameraEntity)) {
+            data.cameraYaw = cam->yaw;
+            data.cameraPitch = cam->pitch;
+            data.cameraDistance = cam->distance;
+        }
+    }
+    return data;
+}
+
+SaveData GameWorld::save() const {
+    SaveData data = saveMeta();
+    data.regions.reserve(regions.trackedRegionCount());
+    for (const auto& [coord, rd] : regions.trackedRegions()) {
+        data.regions.push_back({coord.x, coord.z, static_cast<int>(rd.state), rd.realityPressure});
+    }
+    serializeWorld(world, data.world);
+    return data;
+}
+
+SaveData GameWorld::saveChanges() {
+    SaveData data = saveMeta();
+    data.regions.reserve(regions.dirtyRegions().size());
+    for (const RegionCoord& coord : regions.dirtyRegions()) {
+        const RegionData& rd = *regions.getRegion(coord);
+        data.regions.push_back({coord.x, coord.z, static_cast<int>(rd.state), rd.realityPressure});
+    }
+    regions.clearDirty();
+    if (worldChangedSinceSave()) serializeWorld(world, data.world);
+    markWorldSaved();
+    return data;
+}
+
+void GameWorld::load(const SaveData& data) {
+    restoreWorld({reinterpret_cast<const uint8_t*>(data.world.data()), data.world.size()});
+    restore(data.meta(), data.regions);
+    regions.clearDirty();
+    markWorldSaved();
+    chunks.update(playerPosition());
+}
+
+void GameWorld::load(const SaveView& save) {
+    restoreWorld(save.world());
+    restore(save.meta(), save.regions());
+    save.forEachDelta([this](const SaveMeta& meta, std::span<const RegionSave> regionSaves) { restore(meta, regionSaves); });
+    regions.clearDirty();
+    markWorldSaved();
+    chunks.update(playerPosition());
+}
+
+void GameWorld::markWorldSaved() {
+    // Changes stamped with the current version may come after this; counting
+    // them as newer costs at most one needless snapshot
+    m_savedVersion = world.version - 1;
+    m_savedEntities = world.entities.count();
+    m_savedComponents = 0;
+    world.eachStorage([this](const auto& components) { m_savedComponents += components.size(); });
+}
+
+bool GameWorld::worldChangedSinceSave() {
+    size_t componentCount = 0;
+    bool changed = false;
+    world.eachStorage([&](const auto& components) {
+        componentCount += components.size();
+        if (!changed) components.changedSince(m_savedVersion, [&](Entity, const auto&) { changed = true; });
+    });
+    return changed || componentCount != m_savedComponents || world.entities.count() != m_savedEntities;
+}
+
+void GameWorld::restoreWorld(std::span<const uint8_t> snapshot) {
+    if (snapshot.empty()) return;
+    if (!deserializeWorld(world, snapshot)) {
+        Logger::warn("Save has an unreadable world snapshot; keeping the current entities");
+        return;
+    }
+    // Their caches are keyed by the old entities
+    m_motion = {};
+    m_matrices = {};
+    collision = {};
+    spatial = {};
+    syncSystems();
+}
+
+void GameWorld::restore(const SaveMeta& data, std::span<const RegionSave> regionSaves) {
+    m_playTime = data.playTime;
+    if (world.playerEntity != NULL_ENTITY) {
+        auto& t = world.transforms.get(world.playerEntity);
+        t.position = data.playerPosition;
+        t.rotation.y = data.playerYaw;
+        if (auto* c = world.playerControllers.tryGet(world.playerEntity)) c->targetYaw = data.playerYaw;
+        if (auto* v = world.velocities.tryGet(world.playerEntity)) v->linear = glm::vec3(0);
+    }
+    if (world.cameraEntity != NULL_ENTITY) {
+        if (auto* cam = world.cameraControllers.tryGet(world.cameraEntity)) {
+            cam->yaw = data.cameraYaw;
+            cam->pitch = data.cameraPitch;
+            cam->distance = data.cameraDistance;
+        }
+    }
+    size_t unknown = 0;
+    for (const auto& rs : regionSaves) {
+        if (rs.state < static_cast<int>(RegionState::Stable) || rs.state > static_cast<int>(RegionState::Mythic)) {
+            unknown++;
+            continue;
+        }
+        auto& region = regions.getOrCreateRegion({rs.x, rs.z});
+        region.state = static_cast<RegionState>(rs.state);
+        region.realityPressure = rs.pressure;
+    }
+    if (unknown > 0) Logger::warnf("Save has {} regions in an unknown state; left out", unknown);
+}
+
+} // namespace myth
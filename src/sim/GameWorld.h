@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include "CommandStream.h"
+#include "core/JobSystem.h"
+#include "engine/RegionState.h"
+#include "engine/SaveLoad.h"
+#include "engine/ecs/World.h"
+#include "engine/ecs/MotionSystem.h"
+#include "engine/ecs/CollisionSystem.h"
+#include "engine/ecs/SpatialIndex.h"
+#include "engine/ecs/TransformSystem.h"
+#include "engine/world/ChunkManager.h"
+
+namespace myth {
+
+// Everything that advances with game time: the ECS world and its systems,
+// region pressure, terrain streaming, collision and the spatial index. Has
+// no window or GPU dependency, so the client, the headless runner and
+// benchmarks all tick the same code. Not thread-safe; the caller serialises
+// step() with any other access.
+class GameWorld {
+public:
+    explicit GameWorld(JobSystem* jobs = nullptr) : chunks(jobs), m_jobs(jobs) {}
+
+    ecs::World world;
+    RegionStateMachine regions;
+    ChunkManager chunks;
+    ecs::SpatialIndex spatial;
+    ecs::CollisionSystem collision;
+
+    // Spawn the player, its camera and the landmark grid. Renderables are
+    // tagged with a MeshId; whoever draws them fills in the index ranges.
+    void populate();
+
+    // One fixed simulation step driven by the next command in `commands`
+    void step(float dt, PlayerCommandStream& commands);
+
+    // Regions and the whole ECS world, for SaveManager::save
+    SaveData save() const;
+    // Player and camera, plus only the regions changed since the last
+    // saveChanges() or load(), for SaveManager::saveDelta; the ECS world
+    // too if any of it changed since then. Those changes are no longer
+    // tracked, so if the write fails the next save must be full
+    // (BackgroundSaver::needsFullSave())
+    SaveData saveChanges();
+    void load(const SaveData& data);
+    // Straight from the mapped files, base then deltas; nothing is copied
+    // but the regions into the state machine and any compressed snapshot
+    void load(const SaveView& save);
+
+    float playTime() const { return m_playTime; }
+    uint64_t tick() const { return m_tick; }
+    glm::vec3 playerPosition() const;
+
+private:
+    SaveData saveMeta() const;
+    // Replace the ECS world with a snapshot and start its systems afresh;
+    // an empty snapshot leaves the world as populated
+    void restoreWorld(std::span<const uint8_t> snapshot);
+    void syncSystems();
+    void restore(const SaveMeta& meta, std::span<const RegionSave> regionSaves);
+    // Where the ECS world stood at the last saveChanges() or load()
+    void markWorldSaved();
+    bool worldChangedSinceSave();
+
+    JobSystem* m_jobs;
+    ecs::MotionSystem m_motion;
+    ecs::WorldMatrixSystem m_matrices;
+    float m_playTime = 0.0f;
+    uint64_t m_tick = 0;
+    // Stamps above m_savedVersion are changes since; counts catch removals
+    uint32_t m_savedVersion = 0;
+    size_t m_savedEntities = 0;
+    size_t m_savedComponents = 0;
+};
+
+} // namespace myth